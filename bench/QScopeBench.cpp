@@ -0,0 +1,971 @@
+/*
+ *  QScopeBench - Benchmarks and self-checks of the QScope engine
+ *
+ *  Written in 2026 for QScope (original program by Christian Bauer)
+ */
+
+#include <AppKit.h>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "ScopeEngine.h"
+#include "Replay.h"
+#include "Generator.h"
+#include "TraceServer.h"
+
+
+// Constants
+const char APP_SIGNATURE[] = "application/x-vnd.cebix-QScopeBench";
+
+const float GEN_BENCH_RATE = 192000;	// Format for generator benchmark
+const int GEN_BENCH_CHANNELS = 8;
+
+const float DIST_BENCH_RATE = 192000;	// Format for distortion analyzer benchmark
+
+const float ACQ_BENCH_SECONDS = 4;		// Input for acquisition mode benchmark
+const double ACQ_BENCH_NOISE = 100;		// Noise rms in LSB
+const int ACQ_BENCH_PERIODS = 4;		// Sine periods per sweep
+const int ACQ_BENCH_BUFFER = 1024;		// Frames per buffer
+const bigtime_t acq_bench_time_divs[] = {200, 1000, 5000, 20000, 50000};
+const int NUM_ACQ_BENCH_TIME_DIVS = sizeof(acq_bench_time_divs) / sizeof(acq_bench_time_divs[0]);
+
+const int BUF_BENCH_FRAMES = 65536;		// Input for buffer size benchmark (about 1.5s)
+const int BUF_BENCH_MAX_BUFFER = 16384;	// Every buffer size up to this one is checked
+const int BUF_BENCH_RANDOM = 8;			// Random buffer sequences per setting
+const int BUF_BENCH_COLUMNS = 1 << 21;	// Columns kept of each run (the input is shortened if they don't fit)
+const int buf_bench_sizes[] = {1, 2, 3, 7, 64, 1000, 4096, 16384};
+const int NUM_BUF_BENCH_SIZES = sizeof(buf_bench_sizes) / sizeof(buf_bench_sizes[0]);
+const int buf_bench_switches[][2] = {{9, 11}, {11, 8}, {10, 15}};	// Time base changes in free run (time_div_table indices)
+const int NUM_BUF_BENCH_SWITCHES = sizeof(buf_bench_switches) / sizeof(buf_bench_switches[0]);
+
+const int BEAM_BENCH_WIDTH = 3840;		// Bitmap for beam benchmark (4K)
+const int BEAM_BENCH_HEIGHT = 2160;
+const int BEAM_BENCH_TRACES = 8;		// Stacked
+const int BEAM_BENCH_FRAMES = 200;
+
+
+// Application object
+class QScopeBench : public BApplication {
+public:
+	QScopeBench();
+	virtual void ArgvReceived(int32 argc, char **argv);
+	virtual void ReadyToRun(void);
+
+	int ExitStatus(void) {return exit_status;}
+
+private:
+	const char *capture_path;	// Capture to feed through the engine (--capture)
+	size_t buffer_size;			// Bytes per buffer of the capture (--buffer, in frames)
+	bool bench_generator;		// Time the generator (--generator)
+	int period;					// Frames per generator buffer (--period)
+	bool bench_distortion;		// Time the distortion analyzer (--distortion)
+	const char *client_address;	// Print traces received from this socket (--client)
+	bool bench_acquire;			// Measure acquisition modes (--acquire)
+	bool bench_buffers;			// Check and time all buffer sizes (--buffers)
+	bool bench_beam;			// Time the beam on a 4K bitmap (--beam)
+	int exit_status;			// Returned by main(), 1 if a check failed or nothing was run
+};
+
+
+/*
+ *  Create application object and start it
+ */
+
+int main(int argc, char **argv)
+{
+	QScopeBench *the_app = new QScopeBench();
+	the_app->Run();
+	int status = the_app->ExitStatus();
+	delete the_app;
+	return status;
+}
+
+
+/*
+ *  Application constructor
+ */
+
+QScopeBench::QScopeBench() : BApplication(APP_SIGNATURE)
+{
+	capture_path = NULL;
+	buffer_size = REPLAY_BUFFER_SIZE;
+	bench_generator = false;
+	period = SYNTH_PERIOD;
+	bench_distortion = false;
+	client_address = NULL;
+	bench_acquire = false;
+	bench_buffers = false;
+	bench_beam = false;
+	exit_status = 0;
+}
+
+
+/*
+ *  Parse command line
+ *    --capture file  Print throughput of capture for all trigger modes
+ *    --buffer n      Feed the capture in buffers of n frames
+ *    --generator     Print CPU load of the generator for 8 channels at 192kHz
+ *    --period n      Generator renders buffers of n frames
+ *    --distortion    Print time per analysis of the distortion analyzer for each FFT size
+ *    --client address   Connect to a QScope started with --server, print what it sends until it goes away
+ *    --acquire       Print effective bits and CPU load of each acquisition mode at several time bases
+ *    --buffers       Check that traces don't depend on the buffer size, print time per buffer for each size
+ *    --beam          Print time per frame of the beam for 8 traces on a 4K bitmap and check its coverage
+ */
+
+void QScopeBench::ArgvReceived(int32 argc, char **argv)
+{
+	for (int i=1; i<argc; i++) {
+		if (strcmp(argv[i], "--capture") == 0 && i+1 < argc)
+			capture_path = argv[++i];
+		else if (strcmp(argv[i], "--buffer") == 0 && i+1 < argc)
+			buffer_size = atoi(argv[++i]) * 4;
+		else if (strcmp(argv[i], "--generator") == 0)
+			bench_generator = true;
+		else if (strcmp(argv[i], "--period") == 0 && i+1 < argc)
+			period = atoi(argv[++i]);
+		else if (strcmp(argv[i], "--distortion") == 0)
+			bench_distortion = true;
+		else if (strcmp(argv[i], "--client") == 0 && i+1 < argc)
+			client_address = argv[++i];
+		else if (strcmp(argv[i], "--acquire") == 0)
+			bench_acquire = true;
+		else if (strcmp(argv[i], "--buffers") == 0)
+			bench_buffers = true;
+		else if (strcmp(argv[i], "--beam") == 0)
+			bench_beam = true;
+		else
+			fprintf(stderr, "Usage: %s [--capture file] [--generator] [--distortion] [--client address] [--acquire] [--buffers] [--beam] [--buffer frames] [--period frames]\n", argv[0]);
+	}
+}
+
+
+/*
+ *  Run the benchmarks asked for, then quit
+ */
+
+static void run_benchmark(const char *path, size_t buffer_size);
+static void run_generator_benchmark(int period);
+static void run_distortion_benchmark(void);
+static void run_client(const char *address);
+static void run_acquire_benchmark(void);
+static bool run_buffer_benchmark(void);
+static void run_beam_benchmark(void);
+
+void QScopeBench::ReadyToRun(void)
+{
+	if (capture_path == NULL && !bench_generator && !bench_distortion && client_address == NULL && !bench_acquire && !bench_buffers && !bench_beam) {
+		fprintf(stderr, "Nothing to run, see the README for the options\n");
+		exit_status = 1;
+	}
+	if (client_address != NULL)
+		run_client(client_address);
+	if (capture_path != NULL)
+		run_benchmark(capture_path, buffer_size);
+	if (bench_generator)
+		run_generator_benchmark(period);
+	if (bench_distortion)
+		run_distortion_benchmark();
+	if (bench_acquire)
+		run_acquire_benchmark();
+	if (bench_buffers && !run_buffer_benchmark())
+		exit_status = 1;
+	if (bench_beam)
+		run_beam_benchmark();
+	PostMessage(B_QUIT_REQUESTED);
+}
+
+
+/*
+ *  Feed capture through the subscriber as fast as possible for each trigger mode,
+ *  then as DAC and ADC stream at once (with consecutive timestamps) in dual mode
+ */
+
+// Two views of one acquisition that must deliver the same traces
+struct compare_bench {
+	QScopeSubscriber *sub;
+	TraceRing *ring[2];
+	int32 read_end[2];
+	int16 trace[2][SCOPE_WIDTH*2*NUM_CHANNELS];
+	bool identical;
+};
+
+static bool compare_bench_func(void *arg, char *buf, size_t count, void *header)
+{
+	compare_bench *b = (compare_bench *)arg;
+	QScopeSubscriber::stream_func(b->sub, buf, count, header);
+	bool got = b->ring[0]->GetTrace(b->trace[0], &b->read_end[0]);
+	if (b->ring[1]->GetTrace(b->trace[1], &b->read_end[1]) != got || b->ring[0]->Position() != b->ring[1]->Position()
+	 || (got && memcmp(b->trace[0], b->trace[1], sizeof(b->trace[0])) != 0))
+		b->identical = false;
+	return true;
+}
+
+static void set_trigger(ScopeView *view, int mode, bool right, bool neg, bool generic)
+{
+	view->SetTriggerMode(mode);
+	view->SetTriggerChannel(right);
+	view->SetTriggerSlope(neg);
+	view->SetGenericTrigger(generic);
+}
+
+struct dual_bench {
+	QScopeSubscriber *sub;
+	bigtime_t start_time;
+	int64 frames;
+};
+
+static bool dual_bench_func(void *arg, char *buf, size_t count, void *header)
+{
+	dual_bench *b = (dual_bench *)arg;
+	bigtime_t time = b->start_time + bigtime_t(b->frames * 1E6 / SAMPLE_RATE);
+	b->sub->Feed(SOURCE_DAC, (int16 *)buf, count, time);
+	b->sub->Feed(SOURCE_ADC, (int16 *)buf, count, time);
+	b->frames += count >> 2;
+	return true;
+}
+
+static void run_benchmark(const char *path, size_t buffer_size)
+{
+	// Trigger modes, then acquisition and sweep modes with level trigger
+	static const struct {
+		const char *name;
+		int trigger, acquire, sweep;
+	} modes[] = {
+		{"Off", TRIGGER_OFF, ACQUIRE_PEAK, SWEEP_NORMAL},
+		{"Level", TRIGGER_LEVEL, ACQUIRE_PEAK, SWEEP_NORMAL},
+		{"Peak", TRIGGER_PEAK, ACQUIRE_PEAK, SWEEP_NORMAL},
+		{"Sample", TRIGGER_LEVEL, ACQUIRE_SAMPLE, SWEEP_NORMAL},
+		{"HiRes", TRIGGER_LEVEL, ACQUIRE_HIRES, SWEEP_NORMAL},
+		{"Avg", TRIGGER_LEVEL, ACQUIRE_PEAK, SWEEP_AVERAGE},
+		{"ExpAvg", TRIGGER_LEVEL, ACQUIRE_PEAK, SWEEP_EXP_AVERAGE},
+		{"Env", TRIGGER_LEVEL, ACQUIRE_PEAK, SWEEP_ENVELOPE}
+	};
+
+	ReplayFile file;
+	if (file.Open(path) != B_NO_ERROR) {
+		fprintf(stderr, "Can't open %s as 16 bit stereo capture\n", path);
+		return;
+	}
+	if (file.SampleRate() != SAMPLE_RATE) {
+		fprintf(stderr, "%s was recorded at %g Hz, the scope runs at %g Hz\n", path, file.SampleRate(), SAMPLE_RATE);
+		return;
+	}
+	printf("%s: %ld bytes, %ld bytes per buffer\n", path, (long)file.Size(), (long)buffer_size);
+
+	// Traces are counted by the ring, the looper only receives the first notification
+	BLooper *looper = new BLooper("QScope Benchmark");
+	looper->Run();
+	AutoSetupLooper *auto_looper = new AutoSetupLooper(looper, SAMPLE_RATE);
+	TraceRing ring(SCOPE_WIDTH, NUM_CHANNELS);
+
+	for (int mode=0; mode<int(sizeof(modes) / sizeof(modes[0])); mode++) {
+		QScopeSubscriber *sub = new QScopeSubscriber(auto_looper, NULL);
+		ScopeView view(looper, &ring);
+		sub->AddView(&view);
+		sub->SetSource(SOURCE_FILE);
+		view.SetTriggerMode(modes[mode].trigger);
+		view.SetAcquireMode(modes[mode].acquire);
+		view.SetSweepMode(modes[mode].sweep, MAX_AVERAGE_SWEEPS);
+
+		// Repeat file for at least one second
+		int32 traces = ring.CountTraces();
+		double bytes = 0;
+		bigtime_t start = system_time(), elapsed;
+		do {
+			bytes += file.Run(QScopeSubscriber::stream_func, sub, buffer_size);
+			elapsed = system_time() - start;
+		} while (elapsed < 1000000);
+		traces = ring.CountTraces() - traces;
+
+		printf("%-6s %8.3f GB/s %10.1f traces/s\n", modes[mode].name, bytes / elapsed / 1E3, traces * 1E6 / elapsed);
+		sub->RemoveView(&view);
+		sub->Release();
+	}
+
+	// Specialized trigger search for every mode, channel and slope against the generic one. For the
+	// speed the level is out of reach, so level trigger only searches (and times out every 1/30s);
+	// the traces must be identical at level 0 at all triggered time bases
+	static const char *trigger_names[2] = {"Level", "Peak"};
+	static const char *channel_names[2] = {"left", "right"};
+	static const char *slope_names[2] = {"pos", "neg"};
+	for (int mode=TRIGGER_LEVEL; mode<=TRIGGER_PEAK; mode++)
+		for (int right=0; right<2; right++)
+			for (int neg=0; neg<2; neg++) {
+				double rate[2];
+				for (int generic=0; generic<2; generic++) {
+					QScopeSubscriber *sub = new QScopeSubscriber(auto_looper, NULL);
+					ScopeView view(looper, &ring);
+					set_trigger(&view, mode, right, neg, generic);
+					view.SetTriggerLevel(neg ? -32768 : 32767);
+					sub->AddView(&view);
+					sub->SetSource(SOURCE_FILE);
+					double bytes = 0;
+					bigtime_t start = system_time(), elapsed;
+					do {
+						bytes += file.Run(QScopeSubscriber::stream_func, sub, buffer_size);
+						elapsed = system_time() - start;
+					} while (elapsed < 500000);
+					rate[generic] = bytes / elapsed / 1E3;
+					sub->RemoveView(&view);
+					sub->Release();
+				}
+
+				compare_bench b;
+				b.identical = true;
+				for (int t=0; time_div_table[t].time<ROLL_TIME_DIV; t++) {
+					b.sub = new QScopeSubscriber(auto_looper, NULL);
+					ScopeView *views[2];
+					for (int generic=0; generic<2; generic++) {
+						b.ring[generic] = new TraceRing(SCOPE_WIDTH, NUM_CHANNELS);
+						b.read_end[generic] = 0;
+						views[generic] = new ScopeView(looper, b.ring[generic]);
+						views[generic]->SetTimePerDiv(time_div_table[t].time);
+						set_trigger(views[generic], mode, right, neg, generic);
+						b.sub->AddView(views[generic]);
+					}
+					b.sub->SetSource(SOURCE_FILE);
+					file.Run(compare_bench_func, &b, buffer_size);
+					for (int generic=0; generic<2; generic++) {
+						b.sub->RemoveView(views[generic]);
+						delete views[generic];
+						delete b.ring[generic];
+					}
+					b.sub->Release();
+				}
+
+				printf("%-5s %-5s %s %7.3f GB/s %7.3f GB/s generic  %s\n", trigger_names[mode - TRIGGER_LEVEL], channel_names[right], slope_names[neg],
+					rate[0], rate[1], b.identical ? "identical" : "DIFFERENT");
+			}
+
+	// Several views of one acquisition, with different time bases, traces of the first view are counted
+	for (int num_views=2; num_views<=MAX_VIEWS; num_views*=2) {
+		QScopeSubscriber *sub = new QScopeSubscriber(auto_looper, NULL);
+		TraceRing *rings[MAX_VIEWS];
+		ScopeView *views[MAX_VIEWS];
+		for (int i=0; i<num_views; i++) {
+			rings[i] = i ? new TraceRing(SCOPE_WIDTH, NUM_CHANNELS) : &ring;
+			views[i] = new ScopeView(looper, rings[i]);
+			views[i]->SetTimePerDiv(time_div_table[DEFAULT_TIME_DIV + i].time);
+			sub->AddView(views[i]);
+		}
+		sub->SetSource(SOURCE_FILE);
+
+		int32 traces = ring.CountTraces();
+		double bytes = 0;
+		bigtime_t start = system_time(), elapsed;
+		do {
+			bytes += file.Run(QScopeSubscriber::stream_func, sub, buffer_size);
+			elapsed = system_time() - start;
+		} while (elapsed < 1000000);
+		traces = ring.CountTraces() - traces;
+		printf("%d views %7.3f GB/s %10.1f traces/s\n", num_views, bytes / elapsed / 1E3, traces * 1E6 / elapsed);
+
+		for (int i=0; i<num_views; i++) {
+			sub->RemoveView(views[i]);
+			delete views[i];
+			if (i)
+				delete rings[i];
+		}
+		sub->Release();
+	}
+
+	// Both streams, bytes of both are counted
+	dual_bench b;
+	ScopeView dual_view(looper, &ring);
+	b.sub = new QScopeSubscriber(auto_looper, NULL);
+	b.sub->AddView(&dual_view);
+	b.sub->SetSource(SOURCE_DUAL);
+	b.start_time = system_time();
+	b.frames = 0;
+	int32 traces = ring.CountTraces();
+	double bytes = 0;
+	bigtime_t start = system_time(), elapsed;
+	do {
+		bytes += file.Run(dual_bench_func, &b, buffer_size);
+		elapsed = system_time() - start;
+	} while (elapsed < 1000000);
+	traces = ring.CountTraces() - traces;
+	double pairs = bytes / (buffer_size & ~3);
+	printf("%-6s %8.3f GB/s %10.1f traces/s %8.2f us per DAC+ADC buffer pair\n", "Dual", bytes * 2 / elapsed / 1E3, traces * 1E6 / elapsed, elapsed / pairs);
+	b.sub->RemoveView(&dual_view);
+	b.sub->Release();
+
+	auto_looper->Lock();
+	auto_looper->Quit();
+	looper->Lock();
+	looper->Quit();
+}
+
+
+/*
+ *  Render each waveform on all channels in buffers of the given period for
+ *  at least half a second, print share of one CPU needed for real time
+ */
+
+static void run_generator_benchmark(int period)
+{
+	SignalGenerator gen(GEN_BENCH_RATE, GEN_BENCH_CHANNELS);
+	int16 *buf = new int16[period * GEN_BENCH_CHANNELS];
+	memset(buf, 0, period * GEN_BENCH_CHANNELS * sizeof(int16));
+	printf("%d channels at %g Hz, %d frames per buffer\n", GEN_BENCH_CHANNELS, GEN_BENCH_RATE, period);
+
+	for (int wave=0; wave<NUM_WAVES; wave++) {
+		for (int c=0; c<GEN_BENCH_CHANNELS; c++)
+			gen.SetChannel(c, wave, 100.0 * (c + 1), 0.5);
+		gen.Reset();
+
+		double frames = 0;
+		bigtime_t start = system_time(), elapsed;
+		do {
+			for (int i=0; i<64; i++)
+				gen.Mix(buf, period);
+			frames += 64 * period;
+			elapsed = system_time() - start;
+		} while (elapsed < 500000);
+
+		double audio_time = frames / GEN_BENCH_RATE * 1E6;
+		printf("%-10s %8.3f%% of one CPU %8.2f ns per sample\n", SignalGenerator::WaveName(wave), elapsed * 100 / audio_time, elapsed * 1E3 / (frames * GEN_BENCH_CHANNELS));
+	}
+	delete[] buf;
+}
+
+
+/*
+ *  Analyse a known signal at 192kHz with each FFT size for at least half a
+ *  second: 997Hz at -1dBFS, 2nd harmonic -80dB, 3rd -90dB, noise -100dB
+ *  (THD 0.0105%, SNR 103.8dB in 20kHz). Prints time per analysis, share of
+ *  one CPU for the continuous analysis (8 per second) and the results.
+ */
+
+static void run_distortion_benchmark(void)
+{
+	const double amp = 32768 * pow(10, -1 / 20.0);
+	float *buf = new float[MAX_DIST_FFT];
+	printf("997Hz at %g Hz, expected THD 0.0105%%, SNR 103.8dB\n", DIST_BENCH_RATE);
+
+	for (int size=MIN_DIST_FFT; size<=MAX_DIST_FFT; size<<=1) {
+		uint32 seed = 1;
+		for (int i=0; i<size; i++) {
+			double t = 2 * M_PI * 997 * i / DIST_BENCH_RATE;
+			seed = seed * 1664525 + 1013904223;
+			double noise = int32(seed) / 2147483648.0 * sqrt(3.0) * 1E-5;	// Uniform, rms 1E-5
+			buf[i] = amp * (sin(t) + 1E-4 * sin(2 * t) + 3.16E-5 * sin(3 * t) + noise);
+		}
+
+		DistortionAnalyzer analyzer(DIST_BENCH_RATE, size);
+		distortion_result res;
+		int count = 0;
+		bigtime_t start = system_time(), elapsed;
+		do {
+			analyzer.Analyse(buf, &res);
+			count++;
+			elapsed = system_time() - start;
+		} while (elapsed < 500000);
+
+		double us = double(elapsed) / count;
+		printf("%6d %8.3f ms %7.2f%% of one CPU  THD %.4f%%  THD+N %.4f%%  SINAD %.1fdB  SNR %.1fdB  Floor %.0fdBFS\n",
+			size, us / 1000, us * 8 / 1E4, res.thd, res.thd_n, res.sinad, res.snr, res.floor);
+	}
+	delete[] buf;
+}
+
+
+/*
+ *  Print records received from a trace server (one line per trace with the range
+ *  of each channel), and the bytes per trace compared to uncoded sweeps
+ */
+
+static void run_client(const char *address)
+{
+	TraceClient client;
+	if (client.Connect(address) != B_NO_ERROR) {
+		fprintf(stderr, "Can't connect to %s\n", address);
+		return;
+	}
+
+	int64 traces = 0, bytes = 0;
+	int type;
+	while ((type = client.Read()) >= 0) {
+		switch (type) {
+			case TRACE_RECORD_HELLO:
+				printf("%d columns, %d channels\n", client.Width(), client.Channels());
+				break;
+
+			case TRACE_RECORD_KEY:
+			case TRACE_RECORD_DELTA: {
+				printf("%c %8lu %5d bytes", type, (unsigned long)client.Position(), client.RecordSize());
+				const int16 *p = client.Trace();
+				for (int c=0; c<client.Channels(); c++) {
+					int max = -32768, min = 32767;
+					for (int x=0; x<client.Width(); x++, p+=2) {
+						if (p[0] > max)
+							max = p[0];
+						if (p[1] < min)
+							min = p[1];
+					}
+					printf("  %6d..%-6d", min, max);
+				}
+				printf("\n");
+				traces++;
+				bytes += client.RecordSize();
+				break;
+			}
+
+			case TRACE_RECORD_RESULT:
+				printf("%s\n", client.Result());
+				break;
+		}
+		fflush(stdout);
+	}
+
+	if (traces)
+		printf("%ld traces, %.0f bytes per trace (%d uncoded)\n", (long)traces, double(bytes) / traces, TRACE_HEADER_SIZE + 4 + client.Width() * client.Channels() * 4);
+}
+
+
+/*
+ *  Feed a sine with noise through a view in each acquisition mode at several
+ *  time bases, print the CPU load of real time and the effective number of
+ *  bits of the left channel trace: a sine of the known frequency is fitted
+ *  to the middles of the columns by least squares, the rest is noise
+ */
+
+static double sine_fit_residual(const double *t, const double *y, int n, double omega)
+{
+	// Normal equations for y = a*sin(omega*t) + b*cos(omega*t) + c
+	double m[3][4];
+	memset(m, 0, sizeof(m));
+	for (int i=0; i<n; i++) {
+		double v[3] = {sin(omega * t[i]), cos(omega * t[i]), 1};
+		for (int r=0; r<3; r++) {
+			for (int c=0; c<3; c++)
+				m[r][c] += v[r] * v[c];
+			m[r][3] += v[r] * y[i];
+		}
+	}
+	for (int r=0; r<3; r++)
+		for (int k=r+1; k<3; k++) {
+			double f = m[k][r] / m[r][r];
+			for (int c=r; c<4; c++)
+				m[k][c] -= f * m[r][c];
+		}
+	double x[3];
+	for (int r=2; r>=0; r--) {
+		x[r] = m[r][3];
+		for (int c=r+1; c<3; c++)
+			x[r] -= m[r][c] * x[c];
+		x[r] /= m[r][r];
+	}
+
+	double sum = 0;
+	for (int i=0; i<n; i++) {
+		double e = y[i] - (x[0] * sin(omega * t[i]) + x[1] * cos(omega * t[i]) + x[2]);
+		sum += e * e;
+	}
+	return sqrt(sum / n);
+}
+
+static void run_acquire_benchmark(void)
+{
+	static const char *mode_names[NUM_ACQUIRE_MODES] = {"Peak", "Sample", "HiRes"};
+	const int frames = int(ACQ_BENCH_SECONDS * SAMPLE_RATE);
+
+	// Left: sine at half full scale with Gaussian noise, right: noise
+	int16 *noise = new int16[frames * 2];
+	int16 *input = new int16[frames * 2];
+	uint32 seed = 1;
+	for (int i=0; i<frames*2; i++) {
+		double u1, u2;
+		seed = seed * 1664525 + 1013904223;
+		u1 = (seed + 1.0) / 4294967296.0;
+		seed = seed * 1664525 + 1013904223;
+		u2 = seed / 4294967296.0;
+		noise[i] = int16(floor(ACQ_BENCH_NOISE * sqrt(-2 * log(u1)) * cos(2 * M_PI * u2) + 0.5));
+	}
+	printf("Sine at -6dB with %g LSB rms noise: %.2f effective bits per sample\n", ACQ_BENCH_NOISE, 16 - log(ACQ_BENCH_NOISE * sqrt(12.0)) / log(2.0));
+
+	BLooper *looper = new BLooper("QScope Benchmark");
+	looper->Run();
+	AutoSetupLooper *auto_looper = new AutoSetupLooper(looper, SAMPLE_RATE);
+	int16 trace[SCOPE_WIDTH*2*NUM_CHANNELS];
+	double t[SCOPE_WIDTH], y[SCOPE_WIDTH];
+
+	for (int d=0; d<NUM_ACQ_BENCH_TIME_DIVS; d++) {
+		bigtime_t time = acq_bench_time_divs[d];
+		double freq = ACQ_BENCH_PERIODS * 1E6 / (time * NUM_X_DIVS);
+		for (int i=0; i<frames; i++) {
+			input[i * 2] = int16(floor(16384 * sin(2 * M_PI * freq * i / SAMPLE_RATE) + 0.5)) + noise[i * 2];
+			input[i * 2 + 1] = noise[i * 2 + 1];
+		}
+
+		// Column boundaries (the first at the trigger) as the scope steps through the frames
+		double step = double(time) * SAMPLE_RATE * NUM_X_DIVS / (1E6 * SCOPE_WIDTH);
+
+		for (int mode=0; mode<NUM_ACQUIRE_MODES; mode++) {
+			QScopeSubscriber *sub = new QScopeSubscriber(auto_looper, NULL);
+			TraceRing ring(SCOPE_WIDTH, NUM_CHANNELS);
+			ScopeView view(looper, &ring);
+			view.SetTimePerDiv(time);
+			view.SetAcquireMode(mode);
+			sub->AddView(&view);
+			sub->SetSource(SOURCE_FILE);
+
+			bigtime_t elapsed = 0;
+			int num_traces = 0;
+			double residual = 0, band = 0;
+			int32 read_end = 0;
+			for (int pos=0; pos+ACQ_BENCH_BUFFER<=frames; pos+=ACQ_BENCH_BUFFER) {
+				bigtime_t start = system_time();
+				sub->Feed(SOURCE_FILE, input + pos * 2, ACQ_BENCH_BUFFER * 4, 0);
+				elapsed += system_time() - start;
+				if (!ring.GetTrace(trace, &read_end))
+					continue;
+
+				for (int x=0; x<SCOPE_WIDTH; x++) {
+					double begin = floor(x * step), end = floor((x + 1) * step);
+					t[x] = mode == ACQUIRE_SAMPLE || end == begin ? begin : (begin + end - 1) / 2;
+					y[x] = (trace[x * 2] + trace[x * 2 + 1]) / 2.0;
+					band += trace[x * 2] - trace[x * 2 + 1];
+				}
+				double rms = sine_fit_residual(t, y, SCOPE_WIDTH, 2 * M_PI * freq / SAMPLE_RATE);
+				residual += rms * rms;
+				num_traces++;
+			}
+			sub->RemoveView(&view);
+			sub->Release();
+
+			if (num_traces == 0)
+				continue;
+			residual = sqrt(residual / num_traces);
+			band /= num_traces * SCOPE_WIDTH;
+			printf("%-6s %5gms/div %6.2f frames/column %6.2f effective bits %8.1f LSB thick %7.3f%% CPU\n", mode_names[mode], time / 1000.0, step,
+				16 - log(residual * sqrt(12.0)) / log(2.0), band, elapsed * 100.0 / (frames / SAMPLE_RATE * 1E6));
+		}
+	}
+	delete[] input;
+	delete[] noise;
+
+	auto_looper->Lock();
+	auto_looper->Quit();
+	looper->Lock();
+	looper->Quit();
+}
+
+
+/*
+ *  Feed a test signal to one view in buffers of every size from 1 to 16384
+ *  frames and in random sequences of sizes, and check that columns and
+ *  sweeps are identical to those of the whole signal in one buffer (the view
+ *  carries hold-off, trigger search, column and math filter from one buffer
+ *  to the next). Prints the time per buffer at each size, split into a cost
+ *  per call and a cost per frame, then checks the other trigger, acquisition
+ *  and math settings at all time bases with a few sizes, and that a new time
+ *  base is taken over in free run, where a sweep ends and the next one starts
+ *  within one buffer. Returns false if any of the checks failed
+ */
+
+// View settings to check
+struct buf_bench_setup {
+	const char *name;
+	int trigger, acquire, math_op, math_filter;
+	bool right, neg, ac;
+};
+
+// Fixed buffer size, or (size 0) random up to BUF_BENCH_MAX_BUFFER with about as many of each power of two
+static int next_buffer_size(int size, uint32 *seed)
+{
+	if (size)
+		return size;
+	*seed = *seed * 1664525 + 1013904223;
+	int bits = (*seed >> 16) % 15;
+	*seed = *seed * 1664525 + 1013904223;
+	int n = (1 << bits) + ((*seed >> 8) & ((1 << bits) - 1));
+	return n < BUF_BENCH_MAX_BUFFER ? n : BUF_BENCH_MAX_BUFFER;
+}
+
+// Runs a new view over the input, copies its columns to dest (in the layout of
+// TraceRing::GetColumns()) and returns their number, or -1 if the ring can't hold
+// them. *elapsed is the time spent in the subscriber
+static int buf_bench_run(AutoSetupLooper *auto_looper, BLooper *looper, TraceRing *ring, const buf_bench_setup &setup, bigtime_t time,
+	const int16 *input, int frames, int size, uint32 seed, int16 *dest, int32 *traces, bigtime_t *elapsed)
+{
+	QScopeSubscriber *sub = new QScopeSubscriber(auto_looper, NULL);
+	ScopeView view(looper, ring);
+	view.SetTimePerDiv(time);
+	set_trigger(&view, setup.trigger, setup.right, setup.neg, false);
+	view.SetAcquireMode(setup.acquire);
+	view.SetMath(setup.math_op, setup.math_filter, math_cutoff_table[DEFAULT_MATH_CUTOFF]);
+	view.SetCoupling(false, setup.ac);
+	view.SetCoupling(true, setup.ac);
+	sub->AddView(&view);
+	sub->SetSource(SOURCE_FILE);
+
+	int32 from = ring->Position();
+	int32 first_trace = ring->CountTraces();
+	bigtime_t start = system_time();
+	for (int pos=0; pos<frames; ) {
+		int n = next_buffer_size(size, &seed);
+		if (n > frames - pos)
+			n = frames - pos;
+		sub->Feed(SOURCE_FILE, (int16 *)input + pos * 2, n * 4, 0);
+		pos += n;
+	}
+	*elapsed = system_time() - start;
+	*traces = ring->CountTraces() - first_trace;
+	sub->RemoveView(&view);
+	sub->Release();
+
+	int n = ring->Position() - from;
+	if (n > BUF_BENCH_COLUMNS - SCOPE_WIDTH)
+		return -1;
+	ring->GetColumns(dest, &from, n);
+	return n;
+}
+
+// Runs a new view in free run at time base from_time over the input, switches it to to_time
+// after half of it and returns the traces completed in the second half
+static int32 buf_bench_switch(AutoSetupLooper *auto_looper, BLooper *looper, TraceRing *ring, bigtime_t from_time, bigtime_t to_time,
+	const int16 *input, int frames, int size)
+{
+	QScopeSubscriber *sub = new QScopeSubscriber(auto_looper, NULL);
+	ScopeView view(looper, ring);
+	view.SetTimePerDiv(from_time);
+	set_trigger(&view, TRIGGER_OFF, false, false, false);
+	sub->AddView(&view);
+	sub->SetSource(SOURCE_FILE);
+
+	int half = frames / 2;
+	int32 first_trace = 0;
+	for (int pos=0; pos<frames; ) {
+		int n = size;
+		if (pos < half && n > half - pos)
+			n = half - pos;
+		if (n > frames - pos)
+			n = frames - pos;
+		if (pos == half) {
+			first_trace = ring->CountTraces();
+			view.SetTimePerDiv(to_time);
+		}
+		sub->Feed(SOURCE_FILE, (int16 *)input + pos * 2, n * 4, 0);
+		pos += n;
+	}
+	int32 traces = ring->CountTraces() - first_trace;
+	sub->RemoveView(&view);
+	sub->Release();
+	return traces;
+}
+
+static bool run_buffer_benchmark(void)
+{
+	static const buf_bench_setup setups[] = {
+		{"Level", TRIGGER_LEVEL, ACQUIRE_PEAK, MATH_OFF, MATH_FILTER_NONE, false, false, false},
+		{"Off", TRIGGER_OFF, ACQUIRE_PEAK, MATH_OFF, MATH_FILTER_NONE, false, false, false},
+		{"Peak", TRIGGER_PEAK, ACQUIRE_PEAK, MATH_OFF, MATH_FILTER_NONE, false, false, false},
+		{"Right-", TRIGGER_LEVEL, ACQUIRE_PEAK, MATH_OFF, MATH_FILTER_NONE, true, true, false},
+		{"Sample", TRIGGER_LEVEL, ACQUIRE_SAMPLE, MATH_OFF, MATH_FILTER_NONE, false, false, false},
+		{"HiRes", TRIGGER_LEVEL, ACQUIRE_HIRES, MATH_OFF, MATH_FILTER_NONE, false, false, false},
+		{"Filter", TRIGGER_LEVEL, ACQUIRE_HIRES, MATH_SUB, MATH_FILTER_LOWPASS, false, false, false},
+		{"AC", TRIGGER_LEVEL, ACQUIRE_PEAK, MATH_ADD, MATH_FILTER_NONE, false, false, true}
+	};
+
+	// Left: burst, so the trigger times out in the pauses, right: sweep
+	int16 *input = new int16[BUF_BENCH_FRAMES * 2];
+	SignalGenerator gen(SAMPLE_RATE, 2);
+	gen.SetChannel(0, WAVE_BURST, 500, 0.5);
+	gen.SetChannel(1, WAVE_SWEEP, 50, 0.5);
+	gen.Generate(input, BUF_BENCH_FRAMES);
+	printf("%d frames, 500Hz burst left, sweep from 50Hz right\n", BUF_BENCH_FRAMES);
+
+	BLooper *looper = new BLooper("QScope Benchmark");
+	looper->Run();
+	AutoSetupLooper *auto_looper = new AutoSetupLooper(looper, SAMPLE_RATE);
+	TraceRing ring(SCOPE_WIDTH, NUM_CHANNELS, BUF_BENCH_COLUMNS);
+	int16 *ref = new int16[BUF_BENCH_COLUMNS * 2 * NUM_CHANNELS];
+	int16 *cmp = new int16[BUF_BENCH_COLUMNS * 2 * NUM_CHANNELS];
+	int32 ref_traces, traces;
+	bigtime_t elapsed;
+
+	// Default view with every buffer size, the time of each run is fitted as a * buffers + c
+	const buf_bench_setup &level = setups[0];
+	bigtime_t time = time_div_table[DEFAULT_TIME_DIV].time;
+	int num_ref = buf_bench_run(auto_looper, looper, &ring, level, time, input, BUF_BENCH_FRAMES, BUF_BENCH_FRAMES, 0, ref, &ref_traces, &elapsed);
+	int first_different = 0;
+	double sx = 0, sy = 0, sxx = 0, sxy = 0;
+	for (int size=1; size<=BUF_BENCH_MAX_BUFFER; size++) {
+		int n = buf_bench_run(auto_looper, looper, &ring, level, time, input, BUF_BENCH_FRAMES, size, 0, cmp, &traces, &elapsed);
+		if (first_different == 0 && (n != num_ref || traces != ref_traces || memcmp(ref, cmp, n * 2 * NUM_CHANNELS * sizeof(int16)) != 0))
+			first_different = size;
+		double buffers = (BUF_BENCH_FRAMES + size - 1) / size;
+		sx += buffers;
+		sy += elapsed;
+		sxx += buffers * buffers;
+		sxy += buffers * elapsed;
+	}
+	printf("%-6s %s/div, %d traces, buffers of 1 to %d frames  %s\n", level.name, time_div_table[DEFAULT_TIME_DIV].label, ref_traces, BUF_BENCH_MAX_BUFFER,
+		first_different ? "DIFFERENT" : "identical");
+	bool passed = first_different == 0;
+	if (first_different)
+		printf("  first with %d frames per buffer\n", first_different);
+	double per_buffer = (BUF_BENCH_MAX_BUFFER * sxy - sx * sy) / (BUF_BENCH_MAX_BUFFER * sxx - sx * sx);
+	double per_frame = (sy - per_buffer * sx) / BUF_BENCH_MAX_BUFFER / BUF_BENCH_FRAMES;
+	printf("%.3f us per buffer + %.3f ns per frame, the cost per buffer is less than 10%% from %d frames per buffer on\n",
+		per_buffer, per_frame * 1E3, int(ceil(9 * per_buffer / per_frame)));
+
+	// Time per buffer, throughput and CPU load of real time for powers of two, at least 0.2s each
+	printf("frames  latency  us/buffer      GB/s     CPU\n");
+	for (int size=1; size<=BUF_BENCH_MAX_BUFFER; size*=2) {
+		bigtime_t total = 0;
+		double frames = 0;
+		do {
+			buf_bench_run(auto_looper, looper, &ring, level, time, input, BUF_BENCH_FRAMES, size, 0, cmp, &traces, &elapsed);
+			total += elapsed;
+			frames += BUF_BENCH_FRAMES;
+		} while (total < 200000);
+		printf("%6d %6.2fms %10.3f %9.3f %6.2f%%\n", size, size * 1E3 / SAMPLE_RATE, total * size / frames, frames * 4 / total / 1E3,
+			total * 100.0 / (frames / SAMPLE_RATE * 1E6));
+	}
+
+	// All settings at all time bases with some fixed and random sizes. The input is shortened where
+	// the ring can't hold the columns (free run and peak trigger below 10us/div start a sweep on every frame)
+	for (int s=0; s<int(sizeof(setups) / sizeof(setups[0])); s++) {
+		bool identical = true;
+		int min_frames = BUF_BENCH_FRAMES, runs = 0;
+		for (int t=0; t<NUM_TIME_DIVS && identical; t++) {
+			int frames = BUF_BENCH_FRAMES;
+			while ((num_ref = buf_bench_run(auto_looper, looper, &ring, setups[s], time_div_table[t].time, input, frames, frames, 0, ref, &ref_traces, &elapsed)) < 0)
+				frames /= 2;
+			if (frames < min_frames)
+				min_frames = frames;
+
+			for (int i=0; i<NUM_BUF_BENCH_SIZES+BUF_BENCH_RANDOM && identical; i++) {
+				int size = i < NUM_BUF_BENCH_SIZES ? buf_bench_sizes[i] : 0;
+				int n = buf_bench_run(auto_looper, looper, &ring, setups[s], time_div_table[t].time, input, frames, size, i, cmp, &traces, &elapsed);
+				runs++;
+				if (n != num_ref || traces != ref_traces || memcmp(ref, cmp, n * 2 * NUM_CHANNELS * sizeof(int16)) != 0) {
+					identical = false;
+					if (size)
+						printf("  %s/div, %d frames per buffer: ", time_div_table[t].label, size);
+					else
+						printf("  %s/div, random buffers (seed %d): ", time_div_table[t].label, i);
+					printf("%d columns and %d traces, %d and %d in one buffer\n", n, traces, num_ref, ref_traces);
+				}
+			}
+		}
+		printf("%-6s all time bases, %d to %d frames, %d runs  %s\n", setups[s].name, min_frames, BUF_BENCH_FRAMES, runs, identical ? "identical" : "DIFFERENT");
+		passed = passed && identical;
+	}
+
+	// Time base changed in free run: after the sweep under way, the second half must have as many
+	// traces as a view started there with the new time base (none in roll mode), give or take one
+	const buf_bench_setup &off = setups[1];
+	int half = BUF_BENCH_FRAMES / 2;
+	for (int w=0; w<NUM_BUF_BENCH_SWITCHES; w++) {
+		const time_div_step &from = time_div_table[buf_bench_switches[w][0]];
+		const time_div_step &to = time_div_table[buf_bench_switches[w][1]];
+		buf_bench_run(auto_looper, looper, &ring, off, to.time, input + half * 2, BUF_BENCH_FRAMES - half, BUF_BENCH_FRAMES - half, 0, ref, &ref_traces, &elapsed);
+		bool picked_up = true;
+		for (int i=0; i<NUM_BUF_BENCH_SIZES; i++) {
+			traces = buf_bench_switch(auto_looper, looper, &ring, from.time, to.time, input, BUF_BENCH_FRAMES, buf_bench_sizes[i]);
+			if (traces < ref_traces - 1 || traces > ref_traces + 1) {
+				picked_up = false;
+				printf("  %d frames per buffer: %d traces after the change, %d with %s/div\n", buf_bench_sizes[i], traces, ref_traces, to.label);
+			}
+		}
+		printf("Off    %s/div to %s/div during the input, %d sizes  %s\n", from.label, to.label, NUM_BUF_BENCH_SIZES, picked_up ? "picked up" : "MISSED");
+		passed = passed && picked_up;
+	}
+	delete[] cmp;
+	delete[] ref;
+	delete[] input;
+
+	auto_looper->Lock();
+	auto_looper->Quit();
+	looper->Lock();
+	looper->Quit();
+	return passed;
+}
+
+
+/*
+ *  Draw the beam of 8 traces stacked on a 4K bitmap, a sine with short spans
+ *  and the same sine with noise (spans of about 1/8 of the trace height), at
+ *  each beam width, and print the time per frame. Then check the coverage:
+ *  a flat trace at every 1/16 pixel position must add up to the same level
+ *  in each column, whatever rows it falls on
+ */
+
+static void run_beam_benchmark(void)
+{
+	static const char *signal_names[2] = {"Sine", "Noisy"};
+	const int trace_height = BEAM_BENCH_HEIGHT / BEAM_BENCH_TRACES;
+
+	// Shades that add the level to the color index, so the bitmap shows the coverage
+	static uint8 shades[BEAM_LEVELS][256];
+	for (int l=0; l<BEAM_LEVELS; l++)
+		for (int c=0; c<256; c++)
+			shades[l][c] = c + l < 255 ? c + l : 255;
+
+	uint8 *bits = new uint8[BEAM_BENCH_WIDTH * BEAM_BENCH_HEIGHT];
+	int16 *cols = new int16[BEAM_BENCH_WIDTH * 2 * BEAM_BENCH_TRACES];
+	BeamRaster beam;
+	beam.SetShades(shades);
+	beam.SetBitmap(bits, BEAM_BENCH_WIDTH, BEAM_BENCH_HEIGHT);
+
+	for (int signal=0; signal<2; signal++) {
+		uint32 seed = 1;
+		for (int t=0; t<BEAM_BENCH_TRACES; t++)
+			for (int x=0; x<BEAM_BENCH_WIDTH; x++) {
+				int v = int(16000 * sin(2 * M_PI * (3.0 * x / BEAM_BENCH_WIDTH + t / 8.0)));
+				int spread = 64;
+				if (signal) {
+					seed = seed * 1664525 + 1013904223;
+					spread = 2048 + (seed >> 20);
+				}
+				cols[(t * BEAM_BENCH_WIDTH + x) * 2] = v + spread;
+				cols[(t * BEAM_BENCH_WIDTH + x) * 2 + 1] = v - spread;
+			}
+
+		for (int w=0; w<NUM_BEAM_WIDTHS; w++) {
+			beam.SetWidth(beam_width_table[w]);
+			bigtime_t elapsed = 0;
+			for (int f=0; f<BEAM_BENCH_FRAMES; f++) {
+				memset(bits, 0, BEAM_BENCH_WIDTH * BEAM_BENCH_HEIGHT);
+				bigtime_t start = system_time();
+				for (int t=0; t<BEAM_BENCH_TRACES; t++) {
+					int16 *p = cols + t * BEAM_BENCH_WIDTH * 2;
+					beam_map m;
+					set_beam_map(&m, t * trace_height + trace_height / 2, trace_height, 1, 0);
+					for (int x=1; x<BEAM_BENCH_WIDTH; x++, p+=2)
+						draw_beam(&beam, x, p[0], p[1], p[2], p[3], m);
+					beam.Flush();
+				}
+				elapsed += system_time() - start;
+			}
+			printf("%-6s %3g pixels %6.3f ms per frame (%dx%d, %d traces)\n", signal_names[signal], beam_width_table[w] / float(BEAM_SUBPIXEL), elapsed / 1000.0 / BEAM_BENCH_FRAMES,
+				BEAM_BENCH_WIDTH, BEAM_BENCH_HEIGHT, BEAM_BENCH_TRACES);
+		}
+	}
+
+	// Sum of levels in a column for a flat trace at each subpixel position
+	for (int w=0; w<NUM_BEAM_WIDTHS; w++) {
+		beam.SetWidth(beam_width_table[w]);
+		int min = 0x7fffffff, max = 0;
+		for (int y=0; y<BEAM_SUBPIXEL; y+=BEAM_SUBPIXEL/16) {
+			memset(bits, 0, BEAM_BENCH_WIDTH * 8);
+			beam.Column(0, 4 * BEAM_SUBPIXEL + y, 4 * BEAM_SUBPIXEL + y);
+			beam.Flush();
+			int sum = 0;
+			for (int i=0; i<8; i++)
+				sum += bits[i * BEAM_BENCH_WIDTH];
+			if (sum < min)
+				min = sum;
+			if (sum > max)
+				max = sum;
+		}
+		printf("Coverage %3g pixels %d to %d levels (%d for the full width)\n", beam_width_table[w] / float(BEAM_SUBPIXEL), min, max, beam_width_table[w] * (BEAM_LEVELS - 1) / BEAM_SUBPIXEL);
+	}
+	delete[] cols;
+	delete[] bits;
+}
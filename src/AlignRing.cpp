@@ -0,0 +1,189 @@
+/*
+ *  AlignRing.cpp - Pairs two audio streams frame by frame using buffer timestamps
+ *
+ *  Written in 2026 for QScope (original program by Christian Bauer)
+ */
+
+#include <OS.h>
+#include <SupportDefs.h>
+#include <string.h>
+
+#include "AlignRing.h"
+
+
+// Timestamp jitter (in frames) that is ignored for a continuously running stream
+const int32 SYNC_TOLERANCE = 32;
+
+
+/*
+ *  Ring constructor
+ */
+
+AlignRing::AlignRing(int frames, float rate)
+{
+	ring_frames = 1;
+	while (ring_frames < frames)
+		ring_frames <<= 1;
+	ring_buf = new int16[ring_frames * 2];
+	sample_rate = rate;
+	memset(ring_buf, 0, ring_frames * 2 * sizeof(int16));
+	generation = 0;
+	state[0].generation = state[1].generation = -1;
+	write_generation[0] = write_generation[1] = -1;
+	write_pos[0] = write_pos[1] = 0;
+	silence_pos[0] = silence_pos[1] = 0;
+	silence_generation = -1;
+	read_generation = -1;
+	Reset();
+}
+
+
+/*
+ *  Ring destructor
+ */
+
+AlignRing::~AlignRing()
+{
+	delete[] ring_buf;
+}
+
+
+/*
+ *  Start over, frame index 0 is now (any thread). Producers and consumer notice
+ *  this with their next call, each producer then clears its own half of the ring
+ */
+
+void AlignRing::Reset(void)
+{
+	int32 gen = atomic_get(&generation) + 1;
+	base_time[gen & 3] = system_time();
+	atomic_set(&generation, gen);
+}
+
+
+/*
+ *  Store left channel of a stereo buffer recorded/played at the given time (producer)
+ */
+
+void AlignRing::Put(int stream, const int16 *buf, int frames, bigtime_t time)
+{
+	stream_state &s = state[stream];
+	int mask = ring_frames - 1;
+	int16 *p = ring_buf + stream;
+	int32 gen = atomic_get(&generation);
+	if (s.generation != gen) {
+		s.generation = gen;
+		s.base_time = base_time[gen & 3];
+		s.synced = false;
+
+		// The consumer ignores this stream until its half is cleared
+		for (int i=0; i<ring_frames; i++)
+			p[i << 1] = 0;
+		atomic_set(&write_pos[stream], 0);
+		atomic_set(&write_generation[stream], gen);
+	}
+
+	// Frames the consumer has filled with silence are dropped like those from before the reset
+	int32 first = atomic_get(&silence_generation) == gen ? atomic_get(&silence_pos[stream]) : 0;
+
+	// Buffers of a running stream follow each other without gaps, the timestamp
+	// only decides where the stream starts and where it continues after a dropout
+	int32 pos = int32((time - s.base_time) * (sample_rate / 1E6) + 0.5);
+	if (!s.synced || pos > s.next_pos + SYNC_TOLERANCE || pos < s.next_pos - SYNC_TOLERANCE) {
+
+		// Silence the frames skipped by a dropout, they still hold data from one ring ago
+		if (s.synced && pos > s.next_pos) {
+			int32 from = s.next_pos < first ? first : s.next_pos;
+			if (from < pos - ring_frames)
+				from = pos - ring_frames;
+			for (int32 i=from; i<pos; i++)
+				p[(i & mask) << 1] = 0;
+		}
+		s.synced = true;
+	} else
+		pos = s.next_pos;
+	s.next_pos = pos + frames;
+
+	if (pos < first) {
+		int32 skip = first - pos;
+		if (skip > frames)
+			skip = frames;
+		buf += skip * 2;
+		frames -= skip;
+		pos += skip;
+	}
+
+	// Store frames, only into this stream's half of the ring
+	for (int i=0; i<frames; i++, pos++)
+		p[(pos & mask) << 1] = buf[i << 1];
+	if (pos > atomic_get(&write_pos[stream]))
+		atomic_set(&write_pos[stream], pos);
+}
+
+
+/*
+ *  Get pointer to the oldest frames written by both streams (consumer),
+ *  returns number of frames up to the end of the ring
+ */
+
+int AlignRing::Get(int16 **data)
+{
+	int32 gen = atomic_get(&generation);
+	if (read_generation != gen) {
+		read_generation = gen;
+		read_pos = 0;
+		atomic_set(&silence_pos[0], 0);
+		atomic_set(&silence_pos[1], 0);
+		atomic_set(&silence_generation, gen);
+	}
+
+	// A stream that hasn't started over yet has written nothing
+	int32 w[2];
+	w[0] = atomic_get(&write_generation[0]) == gen ? atomic_get(&write_pos[0]) : 0;
+	w[1] = atomic_get(&write_generation[1]) == gen ? atomic_get(&write_pos[1]) : 0;
+	int lag = w[0] < w[1] ? 0 : 1;
+	int32 lo = w[lag];
+	int32 hi = w[lag ^ 1];
+	int32 half = ring_frames >> 1;
+
+	// Don't wait for a stream that lags more than half the ring, fill its half
+	// with silence up to where the other one is and make its producer skip these
+	// frames. If the producer was just about to store them anyway, each frame
+	// ends up as either silence or its own sample, never as one from elsewhere.
+	if (hi - lo > half) {
+		lo = hi - half;
+		int32 from = w[lag];
+		int32 silenced = atomic_get(&silence_pos[lag]);
+		if (from < silenced)
+			from = silenced;
+		if (from < lo - half)
+			from = lo - half;
+		int16 *p = ring_buf + lag;
+		int mask = ring_frames - 1;
+		for (int32 i=from; i<lo; i++)
+			p[(i & mask) << 1] = 0;
+		if (lo > silenced)
+			atomic_set(&silence_pos[lag], lo);
+	}
+	if (read_pos < lo - half)
+		read_pos = lo - half;
+
+	int n = lo - read_pos;
+	if (n <= 0)
+		return 0;
+	int start = read_pos & (ring_frames - 1);
+	if (n > ring_frames - start)
+		n = ring_frames - start;
+	*data = ring_buf + (start << 1);
+	return n;
+}
+
+
+/*
+ *  Release frames returned by Get() (consumer)
+ */
+
+void AlignRing::Consume(int frames)
+{
+	read_pos += frames;
+}
@@ -0,0 +1,63 @@
+/*
+ *  AlignRing.h - Pairs two audio streams frame by frame using buffer timestamps
+ *
+ *  Written in 2026 for QScope (original program by Christian Bauer)
+ */
+
+#ifndef __ALIGN_RING_H__
+#define __ALIGN_RING_H__
+
+#include <SupportDefs.h>
+
+
+/*
+ *  Each of two streams (each with its own producer thread) writes the left
+ *  channel of its buffers into one half of an interleaved stereo ring, at
+ *  the frame index given by the buffer's timestamp. Frames both streams have
+ *  written form an ordinary 16 bit stereo buffer that the consumer reads in
+ *  place. A stream that stops delivering is replaced by silence (written by
+ *  the consumer) after half the ring size, so the other one keeps running.
+ *  Each half of the ring is only ever written by its own producer and, for
+ *  frames that producer has given up on, the consumer. Reset() may be called
+ *  from any thread while the streams run, they start over when they see it.
+ */
+
+class AlignRing {
+public:
+	AlignRing(int frames, float rate);
+	~AlignRing();
+
+	void Reset(void);
+
+	// Producer side (one thread per stream, stream = 0 or 1)
+	void Put(int stream, const int16 *buf, int frames, bigtime_t time);
+
+	// Consumer side
+	int Get(int16 **data);
+	void Consume(int frames);
+
+private:
+	struct stream_state {
+		int32 generation;	// Reset() seen by this stream
+		bigtime_t base_time;	// Time of frame index 0 in this generation
+		bool synced;		// next_pos valid
+		int32 next_pos;		// Frame index following the last buffer
+	};
+
+	int16 *ring_buf;		// Interleaved frames, stream 0 left, stream 1 right
+	int ring_frames;		// Power of 2
+	float sample_rate;
+
+	bigtime_t base_time[4];	// Time of frame index 0, indexed by generation & 3
+	int32 generation;		// Incremented by Reset()
+	int32 write_generation[2];	// Generation each stream writes in
+	int32 write_pos[2];		// Frame index up to which each stream has written (in write_generation)
+	stream_state state[2];	// Owned by the producers
+	int32 silence_pos[2];	// Frame index up to which the consumer has silenced each stream
+	int32 silence_generation;	// Generation silence_pos belongs to
+
+	int32 read_pos;			// Owned by the consumer
+	int32 read_generation;
+};
+
+#endif
@@ -0,0 +1,30 @@
+/*
+ *  AudioSource.h - Interface of the inputs the scope can be fed from
+ *
+ *  Written in 2026 for QScope (original program by Christian Bauer)
+ */
+
+#ifndef __AUDIO_SOURCE_H__
+#define __AUDIO_SOURCE_H__
+
+#include <SupportDefs.h>
+
+#include "OldSubscriber.h"
+
+
+/*
+ *  A source calls the stream function from its own thread with buffers of
+ *  16 bit stereo frames, exactly like a BSubscriber of the audio streams:
+ *  count is in bytes, header points to an audio_buffer_header whose time is
+ *  the time of the first frame (or is NULL if the source has no clock).
+ */
+
+class AudioSource {
+public:
+	virtual ~AudioSource() {}
+
+	virtual status_t Start(enter_stream_hook func, void *arg) = 0;
+	virtual void Stop(void) = 0;
+};
+
+#endif
@@ -0,0 +1,185 @@
+/*
+ *  AutoSetup.cpp - Automatic time base and trigger setup
+ *
+ *  Written in 2026 for QScope (original program by Christian Bauer)
+ */
+
+#include <AppKit.h>
+#include <string.h>
+
+#include "AutoSetup.h"
+#include "FFT.h"
+
+
+// Length of the analysed block in seconds (determines lowest detectable frequency)
+const float CAPTURE_TIME = 0.1;
+
+// Minimum peak-to-peak amplitude to be considered a signal
+const int MIN_AMPLITUDE = 64;
+
+
+/*
+ *  Auto setup looper constructor
+ */
+
+AutoSetupLooper::AutoSetupLooper(BLooper *target, float sample_rate) : BLooper("QScope Auto Setup", B_LOW_PRIORITY)
+{
+	the_target = target;
+	rate = sample_rate;
+
+	state = CAPTURE_IDLE;
+	capture_frames = int(CAPTURE_TIME * rate);
+	capture_counter = 0;
+	capture_buf = new int16[capture_frames * 2];
+
+	// Zero-padding to twice the length gives the linear (not circular) autocorrelation
+	the_fft = new FFT(FFTSizeFor(capture_frames * 2));
+	re = new float[the_fft->Size()];
+	im = new float[the_fft->Size()];
+	Run();
+}
+
+
+/*
+ *  Auto setup looper destructor
+ */
+
+AutoSetupLooper::~AutoSetupLooper()
+{
+	delete[] capture_buf;
+	delete[] re;
+	delete[] im;
+	delete the_fft;
+}
+
+
+/*
+ *  Start capture (called by window), returns false if already busy
+ */
+
+bool AutoSetupLooper::Start(void)
+{
+	if (state != CAPTURE_IDLE)
+		return false;
+	capture_counter = 0;
+	atomic_set(&state, CAPTURE_RUNNING);
+	return true;
+}
+
+
+/*
+ *  Copy samples into capture buffer (called by audio thread)
+ */
+
+void AutoSetupLooper::Capture(int16 *buf, int count)
+{
+	if (atomic_get(&state) != CAPTURE_RUNNING)
+		return;
+
+	int n = capture_frames - capture_counter;
+	if (n > count)
+		n = count;
+	memcpy(capture_buf + capture_counter * 2, buf, n * 4);
+	capture_counter += n;
+
+	// Buffer full? Then hand it over to our own thread
+	if (capture_counter == capture_frames) {
+		atomic_set(&state, CAPTURE_DONE);
+		PostMessage(MSG_AUTO_CAPTURED);
+	}
+}
+
+
+/*
+ *  Handle messages
+ */
+
+void AutoSetupLooper::MessageReceived(BMessage *msg)
+{
+	switch (msg->what) {
+		case MSG_AUTO_CAPTURED:
+			analyse();
+			atomic_set(&state, CAPTURE_IDLE);
+			break;
+
+		default:
+			BLooper::MessageReceived(msg);
+	}
+}
+
+
+/*
+ *  Find amplitude and period of captured signal and report to target
+ */
+
+void AutoSetupLooper::analyse(void)
+{
+	int i, n = capture_frames;
+	int16 *buf = capture_buf;
+
+	// Find channel with largest amplitude
+	int16 min[2] = {32767, 32767}, max[2] = {-32768, -32768};
+	for (i=0; i<n*2; i+=2) {
+		if (buf[i] < min[0]) min[0] = buf[i];
+		if (buf[i] > max[0]) max[0] = buf[i];
+		if (buf[i+1] < min[1]) min[1] = buf[i+1];
+		if (buf[i+1] > max[1]) max[1] = buf[i+1];
+	}
+	int ch = (max[1] - min[1]) > (max[0] - min[0]);
+	int level = (max[ch] + min[ch]) / 2;
+
+	BMessage reply(MSG_AUTO_RESULT);
+	reply.AddBool("right", ch);
+	reply.AddInt32("level", level);
+
+	if (max[ch] - min[ch] < MIN_AMPLITUDE) {
+		the_target->PostMessage(&reply);
+		return;
+	}
+
+	// Autocorrelation via power spectrum
+	int size = the_fft->Size();
+	for (i=0; i<n; i++)
+		re[i] = buf[i * 2 + ch] - level;
+	memset(re + n, 0, (size - n) * sizeof(float));
+	memset(im, 0, size * sizeof(float));
+	the_fft->Forward(re, im);
+	for (i=0; i<size; i++) {
+		re[i] = re[i] * re[i] + im[i] * im[i];
+		im[i] = 0;
+	}
+	the_fft->Inverse(re, im);
+
+	// Compensate for overlap shrinking with lag, require two periods in block
+	int max_lag = n / 2;
+	for (i=1; i<max_lag; i++)
+		re[i] *= float(n) / float(n - i);
+
+	// Skip main lobe around lag 0
+	for (i=1; i<max_lag; i++)
+		if (re[i] < 0)
+			break;
+	int first = i;
+
+	// Period is the first peak close to the highest one
+	float highest = 0;
+	for (i=first; i<max_lag; i++)
+		if (re[i] > highest)
+			highest = re[i];
+	if (highest < re[0] * 0.3) {
+		the_target->PostMessage(&reply);
+		return;
+	}
+	for (i=first+1; i<max_lag-1; i++)
+		if (re[i] >= highest * 0.9 && re[i] >= re[i-1] && re[i] >= re[i+1])
+			break;
+
+	// Parabolic interpolation for sub-sample lag
+	float lag = i;
+	float denom = re[i-1] - 2 * re[i] + re[i+1];
+	if (denom != 0)
+		lag += 0.5 * (re[i-1] - re[i+1]) / denom;
+
+	reply.AddFloat("period", lag / rate);
+	the_target->PostMessage(&reply);
+}
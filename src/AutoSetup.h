@@ -0,0 +1,52 @@
+/*
+ *  AutoSetup.h - Automatic time base and trigger setup
+ *
+ *  Written in 2026 for QScope (original program by Christian Bauer)
+ */
+
+#ifndef __AUTO_SETUP_H__
+#define __AUTO_SETUP_H__
+
+#include <AppKit.h>
+
+class FFT;
+
+
+// Messages
+const uint32 MSG_AUTO_CAPTURED = 'acap';	// Capture buffer full (to AutoSetupLooper)
+const uint32 MSG_AUTO_RESULT = 'ares';		// Analysis result (to target)
+
+
+// Looper that captures a short block of audio and analyses it
+class AutoSetupLooper : public BLooper {
+public:
+	AutoSetupLooper(BLooper *target, float sample_rate);
+	virtual ~AutoSetupLooper();
+	virtual void MessageReceived(BMessage *msg);
+
+	bool Start(void);
+	void Capture(int16 *buf, int count);
+	bool Capturing(void) {return state == CAPTURE_RUNNING;}
+
+private:
+	enum {	// Capture states
+		CAPTURE_IDLE,
+		CAPTURE_RUNNING,
+		CAPTURE_DONE
+	};
+
+	void analyse(void);
+
+	BLooper *the_target;
+	float rate;
+
+	int32 state;			// Capture state (CAPTURE_...), shared with audio thread
+	int16 *capture_buf;		// Captured stereo sample frames
+	int capture_frames;		// Number of frames to capture
+	int capture_counter;	// Number of frames captured so far
+
+	FFT *the_fft;			// For autocorrelation
+	float *re, *im;
+};
+
+#endif
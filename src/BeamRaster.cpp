@@ -0,0 +1,269 @@
+/*
+ *  BeamRaster.cpp - Antialiased beam for 8 bit bitmaps
+ *
+ *  Written in 2026 for QScope (original program by Christian Bauer)
+ */
+
+#include <SupportDefs.h>
+#include <string.h>
+
+#include "BeamRaster.h"
+
+
+const int BEAM_WORDS = BEAM_BATCH / 8;	// Words per row of a batch
+const int BEAM_MIN_ROWS = 8;			// Fully covered pixels a column needs to be collected
+
+
+/*
+ *  Beam constructor
+ */
+
+BeamRaster::BeamRaster()
+{
+	shade = NULL;
+	half_width = BEAM_SUBPIXEL / 2;
+	bits = NULL;
+	xmod = 0;
+	limit = 0;
+	dim_scale = 0;
+	batch_x = 0;
+	batch_used = 0;
+
+	// Byte i of the word set for bit i of the index
+	for (int b=0; b<256; b++) {
+		uint8 m[8];
+		for (int i=0; i<8; i++)
+			m[i] = b & (1U << i) ? 0xff : 0;
+		memcpy(&byte_mask[b], m, sizeof(m));
+	}
+	row_toggle = NULL;
+	toggle_rows = 0;
+}
+
+
+/*
+ *  Beam destructor
+ */
+
+BeamRaster::~BeamRaster()
+{
+	delete[] row_toggle;
+}
+
+
+/*
+ *  Set bitmap to draw into
+ */
+
+void BeamRaster::SetBitmap(uint8 *b, int bytes_per_row, int height)
+{
+	bits = b;
+	xmod = bytes_per_row;
+	limit = height * BEAM_SUBPIXEL;
+
+	// Full height dims by 128 of 255
+	dim_scale = (128 << 16) / limit;
+
+	if (height + 1 > toggle_rows) {
+		delete[] row_toggle;
+		toggle_rows = height + 1;
+		row_toggle = new uint32[toggle_rows];
+		memset(row_toggle, 0, toggle_rows * sizeof(uint32));
+	}
+}
+
+
+/*
+ *  Draw one column: partly covered first and last pixel, full ones in between
+ */
+
+inline void BeamRaster::draw_column(int x, const span &s)
+{
+	// Level = coverage (0..256) * intensity (0..255) >> 12
+	int32 top = s.top, bottom = s.bottom, intensity = s.intensity;
+	int y = top >> 8;
+	int last = (bottom - 1) >> 8;
+	uint8 *p = bits + xmod * y + x;
+	if (y == last) {
+		*p = shade[((bottom - top) * intensity) >> 12][*p];
+		return;
+	}
+	*p = shade[(((y + 1) * BEAM_SUBPIXEL - top) * intensity) >> 12][*p];
+	p += xmod;
+
+	const uint8 *t = shade[intensity >> 4];
+	int xmod = this->xmod;	// Local variables are faster
+	for (int n=last-y-1; n>0; n--, p+=xmod)
+		*p = t[*p];
+
+	*p = shade[((bottom - last * BEAM_SUBPIXEL) * intensity) >> 12][*p];
+}
+
+
+/*
+ *  Add one column: drawn at once if it has no fully covered pixels,
+ *  otherwise collected and drawn with the other columns of its batch
+ */
+
+void BeamRaster::Column(int x, int32 top, int32 bottom)
+{
+	int32 length = bottom - top;
+	if (length > limit)
+		length = limit;
+
+	span s;
+	s.intensity = 255 - ((length * dim_scale) >> 16);
+	s.top = top - half_width;
+	s.bottom = bottom + half_width;
+	if (s.top < 0)
+		s.top = 0;
+	if (s.bottom > limit)
+		s.bottom = limit;
+	if (s.top >= s.bottom)
+		return;
+
+	// Columns with few fully covered pixels gain nothing from the batch;
+	// one of another trace at the same x must be drawn first
+	uint32 slot = x - batch_x;
+	bool collected = slot < uint32(BEAM_BATCH) && (batch_used & (1U << slot));
+	if (((s.bottom - 1) >> 8) - (s.top >> 8) - 1 < BEAM_MIN_ROWS) {
+		if (collected)
+			Flush();
+		draw_column(x, s);
+		return;
+	}
+
+	if (batch_used && (slot >= uint32(BEAM_BATCH) || collected))
+		Flush();
+	if (batch_used == 0) {
+		batch_x = x & ~(BEAM_BATCH - 1);
+		slot = x - batch_x;
+	}
+	batch[slot] = s;
+	batch_used |= 1U << slot;
+}
+
+
+/*
+ *  Draw columns collected so far
+ */
+
+void BeamRaster::Flush(void)
+{
+	if ((batch_used & (batch_used - 1)) && batch_x + BEAM_BATCH <= xmod)	// More than one, and the words must not leave the row
+		draw_batch();
+	else
+		for (int i=0; i<BEAM_BATCH; i++)
+			if (batch_used & (1U << i))
+				draw_column(batch_x + i, batch[i]);
+	batch_used = 0;
+}
+
+
+/*
+ *  Draw the columns collected: fully covered pixels by rows of the batch,
+ *  then the edge pixels one by one (so the rows are still all one color
+ *  where they cross the background or a grid line, and take the shades of
+ *  that color for the whole batch at once). Columns that share few rows (a
+ *  steep trace) are drawn one by one
+ */
+
+void BeamRaster::draw_batch(void)
+{
+	// Rows y+1..last-1 of each column are fully covered
+	int first = limit, end = 0;		// Rows with fully covered pixels
+	int covered = 0;				// Fully covered pixels
+	int words = 0;					// Words with columns
+	for (int i=0; i<BEAM_BATCH; i++) {
+		if (!(batch_used & (1U << i)))
+			continue;
+		int y = batch[i].top >> 8;
+		int last = (batch[i].bottom - 1) >> 8;
+		covered += last - y - 1;
+		if (y + 1 < first)
+			first = y + 1;
+		if (last > end)
+			end = last;
+	}
+	for (int w=0; w<BEAM_WORDS; w++)
+		if ((batch_used >> (w * 8)) & 0xff)
+			words++;
+	if (covered < 2 * words * (end - first)) {
+		for (int i=0; i<BEAM_BATCH; i++)
+			if (batch_used & (1U << i))
+				draw_column(batch_x + i, batch[i]);
+		return;
+	}
+
+	const uint8 *level[BEAM_BATCH];	// Shades of the fully covered pixels, NULL for columns not collected
+	for (int i=0; i<BEAM_BATCH; i++) {
+		level[i] = NULL;
+		if (!(batch_used & (1U << i)))
+			continue;
+		level[i] = shade[batch[i].intensity >> 4];
+		row_toggle[(batch[i].top >> 8) + 1] ^= 1U << i;
+		row_toggle[(batch[i].bottom - 1) >> 8] ^= 1U << i;
+	}
+
+	// Last single-color word and its shades, starting with color 0
+	uint64 solid[BEAM_WORDS], fill[BEAM_WORDS];
+	for (int w=0; w<BEAM_WORDS; w++) {
+		uint8 f[8];
+		for (int i=0; i<8; i++)
+			f[i] = level[w * 8 + i] != NULL ? level[w * 8 + i][0] : 0;
+		memcpy(&fill[w], f, sizeof(f));
+		solid[w] = 0;
+	}
+
+	uint32 columns = 0;
+	uint32 *toggle = row_toggle;	// Local variables are faster
+	int xmod = this->xmod;
+	uint8 *row = bits + xmod * first + batch_x;
+	for (int y=first; y<=end; y++, row+=xmod) {
+		columns ^= toggle[y];
+		toggle[y] = 0;
+		for (int w=0; w<BEAM_WORDS; w++) {
+			uint64 mask = byte_mask[(columns >> (w * 8)) & 0xff];
+			if (mask == 0)
+				continue;
+
+			uint8 *p = row + w * 8;
+			uint64 v;
+			memcpy(&v, p, sizeof(v));
+			if (v != solid[w]) {
+				uint8 c = p[0];
+				const uint8 **l = level + w * 8;
+				if (v != c * 0x0101010101010101ULL) {
+
+					// Several colors, shade the covered pixels one by one
+					uint8 m[8];
+					memcpy(m, &mask, sizeof(m));
+					for (int i=0; i<8; i++)
+						if (m[i])
+							p[i] = l[i][p[i]];
+					continue;
+				}
+				uint8 f[8];
+				for (int i=0; i<8; i++)
+					f[i] = l[i] != NULL ? l[i][c] : c;
+				memcpy(&fill[w], f, sizeof(f));
+				solid[w] = v;
+			}
+			v = (v & ~mask) | (fill[w] & mask);
+			memcpy(p, &v, sizeof(v));
+		}
+	}
+
+	// Partly covered first and last pixel of each column
+	for (int i=0; i<BEAM_BATCH; i++) {
+		if (!(batch_used & (1U << i)))
+			continue;
+		int32 top = batch[i].top, bottom = batch[i].bottom, intensity = batch[i].intensity;
+		int y = top >> 8;
+		int last = (bottom - 1) >> 8;
+		uint8 *p = bits + xmod * y + batch_x + i;
+		*p = shade[(((y + 1) * BEAM_SUBPIXEL - top) * intensity) >> 12][*p];
+		p = bits + xmod * last + batch_x + i;
+		*p = shade[((bottom - last * BEAM_SUBPIXEL) * intensity) >> 12][*p];
+	}
+}
@@ -0,0 +1,73 @@
+/*
+ *  BeamRaster.h - Antialiased beam for 8 bit bitmaps
+ *
+ *  Written in 2026 for QScope (original program by Christian Bauer)
+ */
+
+#ifndef __BEAM_RASTER_H__
+#define __BEAM_RASTER_H__
+
+#include <SupportDefs.h>
+
+
+const int BEAM_LEVELS = 16;			// Shades from the background (0) to the full beam
+const int32 BEAM_SUBPIXEL = 256;	// Vertical positions are in 1/256 pixels
+const int BEAM_BATCH = 32;			// Columns drawn together, four 64 bit words per row
+
+
+/*
+ *  Draws the beam of a trace column by column into an 8 bit bitmap. Each
+ *  column is a vertical span (from the column's maximum to its minimum,
+ *  stretched to reach the previous column, so the columns join up) of the
+ *  beam width, with subpixel position. The first and last pixel of the span
+ *  are covered in part and get the beam in proportion, the ones in between
+ *  entirely. Long spans (a fast beam) are drawn dimmer, down to half for
+ *  the full height. The beam is blended over what is in the bitmap through
+ *  tables of 256 color indices, one per level, so grid lines and other
+ *  traces shine through; level 0 must leave the color unchanged.
+ *
+ *  Columns with many fully covered pixels (a thick, noisy trace) are
+ *  collected in groups of up to BEAM_BATCH, aligned to BEAM_BATCH, and the
+ *  fully covered pixels of the group shaded a row at a time, eight pixels
+ *  (one word) at once with a single table lookup per color found in the
+ *  word. Every pixel still gets exactly the shade it would get column by
+ *  column. Flush() draws the columns still collected; call it before the
+ *  bitmap is shown or changed.
+ */
+
+class BeamRaster {
+public:
+	BeamRaster();
+	~BeamRaster();
+
+	void SetShades(const uint8 (*shades)[256]) {shade = shades;}	// BEAM_LEVELS tables
+	void SetWidth(int32 width) {half_width = width >> 1;}			// In 1/256 pixels
+	void SetBitmap(uint8 *bits, int bytes_per_row, int height);
+	void Column(int x, int32 top, int32 bottom);	// Span from top to bottom (1/256 pixels, top <= bottom)
+	void Flush(void);
+
+private:
+	struct span {
+		int32 top, bottom;	// With the beam width, in 1/256 pixels
+		int32 intensity;	// 0..255
+	};
+
+	void draw_column(int x, const span &s);
+	void draw_batch(void);
+
+	const uint8 (*shade)[256];
+	int32 half_width;
+	uint8 *bits;
+	int xmod;
+	int32 limit;		// Bottom edge of the bitmap
+	int32 dim_scale;	// Dimming per 1/256 pixel of span length, << 16
+
+	int batch_x;		// First column of the batch, a multiple of BEAM_BATCH
+	uint32 batch_used;	// Columns collected (bit mask)
+	span batch[BEAM_BATCH];
+	uint64 byte_mask[256];	// Row word with the bytes of the columns of a bit mask set
+	uint32 *row_toggle;	// Per row, columns of the batch whose interior starts or ends there (bit mask)
+	int toggle_rows;
+};
+
+#endif
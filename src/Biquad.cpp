@@ -0,0 +1,43 @@
+/*
+ *  Biquad.cpp - Second order IIR filter sections
+ *
+ *  Written in 2026 for QScope (original program by Christian Bauer)
+ */
+
+#include <math.h>
+
+#include "Biquad.h"
+
+
+/*
+ *  Compute coefficients (bilinear transform of analog prototype) and clear state
+ */
+
+void BiquadDesign(biquad *f, int type, float freq, float rate, float q)
+{
+	double w = 2.0 * M_PI * freq / rate;
+	double alpha = sin(w) / (2.0 * q);
+	double c = cos(w);
+	double a0 = 1.0 + alpha;
+
+	switch (type) {
+		case BIQUAD_LOWPASS:
+			f->b0 = (1.0 - c) / 2.0 / a0;
+			f->b1 = (1.0 - c) / a0;
+			f->b2 = f->b0;
+			break;
+		case BIQUAD_HIGHPASS:
+			f->b0 = (1.0 + c) / 2.0 / a0;
+			f->b1 = -(1.0 + c) / a0;
+			f->b2 = f->b0;
+			break;
+		case BIQUAD_BANDPASS:	// 0dB peak gain
+			f->b0 = alpha / a0;
+			f->b1 = 0.0;
+			f->b2 = -f->b0;
+			break;
+	}
+	f->a1 = -2.0 * c / a0;
+	f->a2 = (1.0 - alpha) / a0;
+	f->z1 = f->z2 = 0.0;
+}
@@ -0,0 +1,33 @@
+/*
+ *  Biquad.h - Second order IIR filter sections
+ *
+ *  Written in 2026 for QScope (original program by Christian Bauer)
+ */
+
+#ifndef __BIQUAD_H__
+#define __BIQUAD_H__
+
+
+enum {	// Filter types
+	BIQUAD_LOWPASS,
+	BIQUAD_HIGHPASS,
+	BIQUAD_BANDPASS
+};
+
+struct biquad {
+	float b0, b1, b2, a1, a2;	// Coefficients, a0 normalized to 1
+	float z1, z2;				// State (transposed direct form II)
+};
+
+extern void BiquadDesign(biquad *f, int type, float freq, float rate, float q);
+
+// Filter one sample
+inline float BiquadStep(biquad &f, float x)
+{
+	float y = f.b0 * x + f.z1;
+	f.z1 = f.b1 * x - f.a1 * y + f.z2;
+	f.z2 = f.b2 * x - f.a2 * y;
+	return y;
+}
+
+#endif
@@ -0,0 +1,250 @@
+/*
+ *  Bode.cpp - Frequency response measurement
+ *
+ *  Written in 2026 for QScope (original program by Christian Bauer)
+ */
+
+#include <AppKit.h>
+#include <math.h>
+#include <string.h>
+
+#include "Bode.h"
+#include "Generator.h"
+#include "FFT.h"
+
+
+// Stimulus: 1/24 octave from 20Hz to 20kHz, one period of this length
+const int BODE_PERIOD = 65536;
+const float BODE_LOW = 20.0;
+const float BODE_HIGH = 20000.0;
+const float BODE_PER_OCTAVE = 24.0;
+const float BODE_LEVEL = 16384.0;		// Peak, -6dB
+
+// Time from the start of the stimulus to the start of the capture, covers
+// the loopback latency and lets the device under test settle
+const float SETTLE_TIME = 0.6;
+
+// Right input is taken as reference if its tones are at least this much
+// of the played level on average
+const float MIN_REFERENCE = 0.1;
+
+
+/*
+ *  Bode looper constructor
+ */
+
+BodeLooper::BodeLooper(BLooper *target, float sample_rate) : BLooper("QScope Bode", B_LOW_PRIORITY)
+{
+	the_target = target;
+	rate = sample_rate;
+	state = BODE_OFF;
+
+	period = BODE_PERIOD;
+	bins = new int[MAX_MULTITONE_TONES];
+	phases = new float[MAX_MULTITONE_TONES];
+	num_tones = MultitoneBins(bins, MAX_MULTITONE_TONES, period, rate, BODE_LOW, BODE_HIGH, BODE_PER_OCTAVE);
+	stimulus = new float[period];
+	tone_level = BODE_LEVEL * MakeMultitone(stimulus, period, bins, num_tones, phases);
+	for (int i=0; i<period; i++)
+		stimulus[i] *= BODE_LEVEL;
+
+	capture_buf = new int16[period * 2];
+	the_fft = new FFT(period);
+	re = new float[period];
+	im = new float[period];
+	Run();
+}
+
+
+/*
+ *  Bode looper destructor
+ */
+
+BodeLooper::~BodeLooper()
+{
+	delete[] stimulus;
+	delete[] bins;
+	delete[] phases;
+	delete[] capture_buf;
+	delete[] re;
+	delete[] im;
+	delete the_fft;
+}
+
+
+/*
+ *  Start/stop measurement (called by window)
+ */
+
+void BodeLooper::Start(void)
+{
+	atomic_set(&state, BODE_ARMED);
+}
+
+void BodeLooper::Stop(void)
+{
+	atomic_set(&state, BODE_OFF);
+}
+
+
+/*
+ *  Mix stimulus into DAC buffer until the capture is complete (called by DAC thread)
+ */
+
+void BodeLooper::Play(int16 *buf, int count, bigtime_t time)
+{
+	int32 s = atomic_get(&state);
+	if (s == BODE_ARMED) {
+		play_pos = 0;
+		play_frames = 0;
+		play_offset_sum = 0;
+		play_buffers = 0;
+		stimulus_time = time;
+		capture_counter = 0;
+		capture_offset_sum = 0;
+		capture_buffers = 0;
+		s = atomic_test_and_set(&state, BODE_RUNNING, BODE_ARMED) == BODE_ARMED ? BODE_RUNNING : s;
+	}
+	if (s != BODE_RUNNING)
+		return;
+
+	// Average start time of stimulus over the first half of the settling time
+	// (the DAC thread is done with it long before the capture is complete)
+	if (time < stimulus_time + bigtime_t(SETTLE_TIME * 0.5E6)) {
+		play_offset_sum += (time - stimulus_time) - play_frames * (1E6 / rate);
+		play_buffers++;
+	}
+	play_frames += count;
+
+	const float *p = stimulus;
+	int pos = play_pos;
+	for (int i=0; i<count; i++, buf+=2) {
+		int32 l = buf[0] + int32(p[pos]);
+		int32 r = buf[1] + int32(p[pos]);
+		buf[0] = l > 32767 ? 32767 : (l < -32768 ? -32768 : l);
+		buf[1] = r > 32767 ? 32767 : (r < -32768 ? -32768 : r);
+		if (++pos == period)
+			pos = 0;
+	}
+	play_pos = pos;
+}
+
+
+/*
+ *  Copy ADC buffer into capture buffer, from SETTLE_TIME after the
+ *  stimulus started (called by ADC thread)
+ */
+
+void BodeLooper::Record(const int16 *buf, int count, bigtime_t time)
+{
+	if (atomic_get(&state) != BODE_RUNNING)
+		return;
+
+	int first = 0;
+	if (capture_counter == 0) {
+		bigtime_t start = stimulus_time + bigtime_t(SETTLE_TIME * 1E6);
+		first = int(ceil((start - time) * (rate / 1E6)));
+		if (first >= count)
+			return;
+		if (first < 0)
+			first = 0;
+	}
+
+	// Average time of first captured frame over all captured buffers
+	capture_offset_sum += (time - stimulus_time) + (first - capture_counter) * (1E6 / rate);
+	capture_buffers++;
+
+	int n = period - capture_counter;
+	if (n > count - first)
+		n = count - first;
+	memcpy(capture_buf + capture_counter * 2, buf + first * 2, n * 4);
+	capture_counter += n;
+
+	// Buffer full? Then hand it over to our own thread
+	if (capture_counter == period && atomic_test_and_set(&state, BODE_ANALYSING, BODE_RUNNING) == BODE_RUNNING)
+		PostMessage(MSG_BODE_CAPTURED);
+}
+
+
+/*
+ *  Handle messages
+ */
+
+void BodeLooper::MessageReceived(BMessage *msg)
+{
+	switch (msg->what) {
+		case MSG_BODE_CAPTURED:
+			if (atomic_get(&state) != BODE_ANALYSING)
+				break;
+			analyse();
+			atomic_test_and_set(&state, BODE_OFF, BODE_ANALYSING);
+			break;
+
+		default:
+			BLooper::MessageReceived(msg);
+	}
+}
+
+
+/*
+ *  Demodulate all tones and report response to target
+ */
+
+void BodeLooper::analyse(void)
+{
+	int i, n = period;
+
+	// Both channels with one complex FFT: left as real, right as imaginary part
+	for (i=0; i<n; i++) {
+		re[i] = capture_buf[i * 2];
+		im[i] = capture_buf[i * 2 + 1];
+	}
+	the_fft->Forward(re, im);
+
+	// Stimulus position of first captured frame, in frames
+	double pos = (capture_offset_sum / capture_buffers - play_offset_sum / play_buffers) * rate / 1E6;
+
+	// Left and right spectrum at every tone, and the played tone as it
+	// would appear in the capture if the loopback was perfect
+	float *l_re = new float[num_tones * 6];
+	float *l_im = l_re + num_tones, *r_re = l_im + num_tones, *r_im = r_re + num_tones;
+	float *s_re = r_im + num_tones, *s_im = s_re + num_tones;
+	double ref_sum = 0;
+	for (int t=0; t<num_tones; t++) {
+		int k = bins[t];
+		float zr = re[k], zi = im[k], cr = re[n - k], ci = -im[n - k];	// Z[k] and conj(Z[N-k])
+		l_re[t] = 0.5 * (zr + cr);
+		l_im[t] = 0.5 * (zi + ci);
+		r_re[t] = 0.5 * (zi - ci);
+		r_im[t] = -0.5 * (zr - cr);
+		double phi = phases[t] + 2 * M_PI * fmod(k * pos, n) / n;
+		s_re[t] = 0.5 * n * tone_level * cos(phi);
+		s_im[t] = 0.5 * n * tone_level * sin(phi);
+		ref_sum += sqrt(r_re[t] * r_re[t] + r_im[t] * r_im[t]) / (0.5 * n * tone_level);
+	}
+	bool reference = num_tones > 0 && ref_sum / num_tones >= MIN_REFERENCE;
+
+	// Response is left divided by reference
+	float *freq = new float[num_tones * 3];
+	float *gain = freq + num_tones, *phase = gain + num_tones;
+	for (int t=0; t<num_tones; t++) {
+		float ar = reference ? r_re[t] : s_re[t];
+		float ai = reference ? r_im[t] : s_im[t];
+		float d = ar * ar + ai * ai;
+		float hr = (l_re[t] * ar + l_im[t] * ai) / d;
+		float hi = (l_im[t] * ar - l_re[t] * ai) / d;
+		float mag = sqrt(hr * hr + hi * hi);
+		freq[t] = bins[t] * rate / n;
+		gain[t] = mag > 1E-6 ? 20 * log10(mag) : -120.0;
+		phase[t] = atan2(hi, hr) * 180 / M_PI;
+	}
+
+	BMessage reply(MSG_BODE_RESULT);
+	reply.AddBool("reference", reference);
+	reply.AddData("freq", B_RAW_TYPE, freq, num_tones * sizeof(float));
+	reply.AddData("gain", B_RAW_TYPE, gain, num_tones * sizeof(float));
+	reply.AddData("phase", B_RAW_TYPE, phase, num_tones * sizeof(float));
+	delete[] freq;
+	delete[] l_re;
+	the_target->PostMessage(&reply);
+}
@@ -0,0 +1,83 @@
+/*
+ *  Bode.h - Frequency response measurement
+ *
+ *  Written in 2026 for QScope (original program by Christian Bauer)
+ */
+
+#ifndef __BODE_H__
+#define __BODE_H__
+
+#include <AppKit.h>
+
+class FFT;
+
+
+// Messages
+const uint32 MSG_BODE_CAPTURED = 'bcap';	// Capture buffer full (to BodeLooper)
+const uint32 MSG_BODE_RESULT = 'bres';		// Measurement result (to target)
+
+
+/*
+ *  Plays a periodic multitone with 1/24 octave spacing from 20Hz to 20kHz
+ *  on the DAC and, once the system has settled, records one period of the
+ *  ADC. All tones lie on FFT bins of the period, so a single FFT measures
+ *  gain and phase of every tone at once. If the right ADC input is looped
+ *  back from the DAC it is used as reference, which cancels the converters;
+ *  otherwise the played signal is the reference, aligned by the time stamps
+ *  of the stream buffers (averaged, as they jitter).
+ *  The result message holds "freq" (Hz), "gain" (dB) and "phase" (degrees)
+ *  as float arrays of one entry per tone, and "reference" (true if the
+ *  right input was used).
+ */
+
+class BodeLooper : public BLooper {
+public:
+	BodeLooper(BLooper *target, float sample_rate);
+	virtual ~BodeLooper();
+	virtual void MessageReceived(BMessage *msg);
+
+	void Start(void);
+	void Stop(void);
+	bool Running(void) {return atomic_get(&state) != BODE_OFF;}
+
+	// Called by audio threads
+	void Play(int16 *buf, int count, bigtime_t time);
+	void Record(const int16 *buf, int count, bigtime_t time);
+
+private:
+	enum {	// Measurement states
+		BODE_OFF,
+		BODE_ARMED,			// Waiting for first DAC buffer
+		BODE_RUNNING,		// Stimulus playing, capturing
+		BODE_ANALYSING		// Capture complete
+	};
+
+	void analyse(void);
+
+	BLooper *the_target;
+	float rate;
+
+	int32 state;				// Measurement state (BODE_...), shared with audio threads
+
+	float *stimulus;			// One period of the multitone
+	int period;					// Frames per period (FFT size)
+	int num_tones;
+	int *bins;					// FFT bin of each tone
+	float *phases;				// Start phase of each tone
+	float tone_level;			// Amplitude of each tone in the stimulus
+	int play_pos;				// Next stimulus frame to play (DAC thread)
+	int64 play_frames;			// Frames played so far
+	bigtime_t stimulus_time;	// Time stamp of first stimulus buffer
+	double play_offset_sum;		// Sum of estimated stimulus start times relative to stimulus_time
+	int play_buffers;			// Number of buffers summed
+
+	int16 *capture_buf;			// Captured left/right channels (ADC thread)
+	int capture_counter;		// Number of frames captured so far
+	double capture_offset_sum;	// Sum of estimated times of first captured frame relative to stimulus_time
+	int capture_buffers;		// Number of buffers summed
+
+	FFT *the_fft;
+	float *re, *im;
+};
+
+#endif
@@ -0,0 +1,150 @@
+/*
+ *  CallbackSource.cpp - Source driven by a periodic real-time callback thread
+ *
+ *  Written in 2026 for QScope (original program by Christian Bauer)
+ */
+
+#include <pthread.h>
+#include <sched.h>
+#include <errno.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+
+#include "CallbackSource.h"
+
+
+// Monotonic time in microseconds
+static int64_t monotonic_time(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return int64_t(ts.tv_sec) * 1000000 + ts.tv_nsec / 1000;
+}
+
+
+/*
+ *  Callback source constructor
+ */
+
+CallbackSource::CallbackSource(float rate, int period)
+{
+	sample_rate = rate;
+	period_frames = period;
+	buffer = NULL;
+	running = false;
+	overruns = 0;
+}
+
+
+/*
+ *  Callback source destructor (subclasses must call Stop() in their destructor)
+ */
+
+CallbackSource::~CallbackSource()
+{
+	Stop();
+	delete[] buffer;
+}
+
+
+/*
+ *  Set frames per callback
+ */
+
+void CallbackSource::SetPeriod(int frames)
+{
+	if (frames < 1)
+		frames = 1;
+	period_frames = frames;
+}
+
+
+/*
+ *  Start callback thread, with real-time scheduling if the system allows it
+ */
+
+int CallbackSource::Start(callback_hook func, void *arg)
+{
+	Stop();
+	delete[] buffer;
+	buffer = new int16_t[period_frames * 2];
+	hook = func;
+	hook_arg = arg;
+	quit = false;
+	overruns = 0;
+
+	pthread_attr_t attr;
+	pthread_attr_init(&attr);
+	struct sched_param param;
+	param.sched_priority = sched_get_priority_max(SCHED_FIFO);
+	pthread_attr_setinheritsched(&attr, PTHREAD_EXPLICIT_SCHED);
+	pthread_attr_setschedpolicy(&attr, SCHED_FIFO);
+	pthread_attr_setschedparam(&attr, &param);
+	int err = pthread_create(&the_thread, &attr, thread_entry, this);
+	if (err != 0)	// Not permitted, run with normal priority
+		err = pthread_create(&the_thread, NULL, thread_entry, this);
+	pthread_attr_destroy(&attr);
+	if (err != 0)
+		return err;
+	running = true;
+	return 0;
+}
+
+
+/*
+ *  Stop callback thread
+ */
+
+void CallbackSource::Stop(void)
+{
+	if (running) {
+		__atomic_store_n(&quit, true, __ATOMIC_RELAXED);
+		pthread_join(the_thread, NULL);
+		running = false;
+	}
+}
+
+
+/*
+ *  Callback thread
+ */
+
+void *CallbackSource::thread_entry(void *arg)
+{
+	((CallbackSource *)arg)->thread_func();
+	return NULL;
+}
+
+void CallbackSource::thread_func(void)
+{
+	callback_header header;
+	header.buffer_number = 0;
+
+	int64_t start = monotonic_time();
+	int64_t frames = 0;
+	while (!__atomic_load_n(&quit, __ATOMIC_RELAXED)) {
+
+		// Buffer is due when its last frame would have been recorded
+		int64_t due = start + int64_t((frames + period_frames) * 1E6 / sample_rate);
+		struct timespec ts;
+		ts.tv_sec = due / 1000000;
+		ts.tv_nsec = (due % 1000000) * 1000;
+		while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR && !__atomic_load_n(&quit, __ATOMIC_RELAXED))
+			;
+
+		// More than one period late? Then skip, like a sound card overrun
+		int64_t late = monotonic_time() - due;
+		int64_t skip = int64_t(late * sample_rate / 1E6) / period_frames;
+		if (skip > 0) {
+			frames += skip * period_frames;
+			__atomic_fetch_add(&overruns, 1, __ATOMIC_RELAXED);
+		}
+
+		header.time = start + int64_t(frames * 1E6 / sample_rate);
+		Fill(buffer, period_frames);
+		hook(hook_arg, buffer, period_frames, &header);
+		header.buffer_number++;
+		frames += period_frames;
+	}
+}
@@ -0,0 +1,64 @@
+/*
+ *  CallbackSource.h - Source driven by a periodic real-time callback thread
+ *
+ *  Written in 2026 for QScope (original program by Christian Bauer)
+ */
+
+#ifndef __CALLBACK_SOURCE_H__
+#define __CALLBACK_SOURCE_H__
+
+#include <pthread.h>
+#include <stdint.h>
+
+
+// Passed with every buffer
+struct callback_header {
+	int32_t buffer_number;	// Sequence number of this buffer
+	int64_t time;			// CLOCK_MONOTONIC time of the first frame in microseconds
+};
+
+// Called with every buffer of 16 bit stereo frames
+typedef void (*callback_hook)(void *arg, int16_t *buf, int frames, const callback_header *header);
+
+
+/*
+ *  Wakes up once per period on the monotonic clock, like the period
+ *  interrupt of a sound card, lets the subclass fill a buffer and hands it
+ *  to the callback function. Only POSIX threads and clocks are used, no
+ *  Be headers, so it builds and runs the same on Linux as here. SynthSource
+ *  makes it an AudioSource.
+ */
+
+class CallbackSource {
+public:
+	CallbackSource(float rate, int period);
+	virtual ~CallbackSource();
+
+	int Start(callback_hook func, void *arg);	// 0 or error number
+	void Stop(void);
+
+	void SetPeriod(int frames);		// Takes effect with next Start()
+	int Period(void) {return period_frames;}
+	float SampleRate(void) {return sample_rate;}
+	int32_t CountOverruns(void) {return __atomic_load_n(&overruns, __ATOMIC_RELAXED);}
+
+protected:
+	virtual void Fill(int16_t *buf, int frames) = 0;	// Called by callback thread
+
+private:
+	static void *thread_entry(void *arg);
+	void thread_func(void);
+
+	float sample_rate;
+	int period_frames;		// Frames per callback
+	int16_t *buffer;
+
+	pthread_t the_thread;
+	bool running;
+	bool quit;				// Set by Stop(), read by the thread
+	callback_hook hook;		// Callback function and its argument
+	void *hook_arg;
+	int32_t overruns;		// Periods dropped because the callback was late
+};
+
+#endif
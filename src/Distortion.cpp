@@ -0,0 +1,427 @@
+/*
+ *  Distortion.cpp - THD, THD+N, SINAD, SNR and noise floor analyzer
+ *
+ *  Written in 2026 for QScope (original program by Christian Bauer)
+ */
+
+#include <AppKit.h>
+#include <math.h>
+#include <string.h>
+
+#include "Distortion.h"
+#include "FFT.h"
+
+
+// 7-term Blackman-Harris window, sidelobes below -180dB so the fundamental
+// doesn't leak into the noise, and the half width of its main lobe in bins
+const int WINDOW_TERMS = 7;
+const double window_coeffs[WINDOW_TERMS] = {
+	0.27105140069342, -0.43329793923448, 0.21812299954311, -0.06592544638803,
+	0.01081174209837, -0.00077658482522, 0.00001388721735
+};
+const int LOBE = 8;
+
+// Highest harmonic counted for THD
+const int MAX_HARMONIC = 10;
+
+// Analysed band
+const float BAND_LOW = 20.0;
+const float bandwidth_high[NUM_DIST_BANDWIDTHS] = {20000.0, 80000.0, 1E9};
+
+// Fundamental below this level (dBFS) counts as no signal
+const float MIN_LEVEL = -100.0;
+
+// Ring for the looper, and analyses per second
+const int RING_SIZE = MAX_DIST_FFT * 2;
+const int UPDATES_PER_SEC = 8;
+const int DEFAULT_DIST_FFT = 16384;
+
+
+/*
+ *  Analyzer constructor
+ */
+
+DistortionAnalyzer::DistortionAnalyzer(float sample_rate, int n)
+{
+	rate = sample_rate;
+	size = 0;
+	bandwidth = DIST_BW_20K;
+	weighting = DIST_WEIGHT_NONE;
+	the_fft = NULL;
+	window = weight = re = im = power = NULL;
+	used = NULL;
+	SetSize(n);
+}
+
+
+/*
+ *  Analyzer destructor
+ */
+
+DistortionAnalyzer::~DistortionAnalyzer()
+{
+	SetSize(0);
+}
+
+
+/*
+ *  Set number of frames per analysis (power of two, 0 frees everything)
+ */
+
+void DistortionAnalyzer::SetSize(int n)
+{
+	if (n == size)
+		return;
+
+	delete the_fft;
+	delete[] window;
+	delete[] weight;
+	delete[] re;
+	delete[] im;
+	delete[] power;
+	delete[] used;
+	the_fft = NULL;
+	window = weight = re = im = power = NULL;
+	used = NULL;
+	size = n;
+	if (size == 0)
+		return;
+
+	window = new float[size];
+	window_power = 0;
+	for (int i=0; i<size; i++) {
+		double x = 2 * M_PI * i / size, w = 0;
+		for (int j=0; j<WINDOW_TERMS; j++)
+			w += window_coeffs[j] * cos(j * x);
+		window[i] = w;
+		window_power += w * w;
+	}
+
+	the_fft = new FFT(size);
+	re = new float[size];
+	im = new float[size];
+	power = new float[size / 2 + 1];
+	weight = new float[size / 2 + 1];
+	used = new uint8[size / 2 + 1];
+	make_weights();
+}
+
+
+/*
+ *  Compute band limits and power weighting of every bin
+ */
+
+void DistortionAnalyzer::make_weights(void)
+{
+	if (size == 0)
+		return;
+
+	int half = size / 2;
+	low_bin = int(ceil(BAND_LOW * size / rate));
+	if (low_bin < LOBE)
+		low_bin = LOBE;		// Keep DC out
+	high_bin = int(bandwidth_high[bandwidth] * size / rate);
+	if (high_bin > half - 1)
+		high_bin = half - 1;
+
+	for (int k=0; k<=half; k++) {
+		if (k < low_bin || k > high_bin) {
+			weight[k] = 0;
+			continue;
+		}
+		if (weighting == DIST_WEIGHT_A) {	// IEC 61672, 0dB at 1kHz
+			double f2 = double(k) * rate / size;
+			f2 *= f2;
+			double ra = 12194.0 * 12194.0 * f2 * f2 / ((f2 + 20.6 * 20.6) * sqrt((f2 + 107.7 * 107.7) * (f2 + 737.9 * 737.9)) * (f2 + 12194.0 * 12194.0));
+			ra *= 1.2589;	// +2dB
+			weight[k] = ra * ra;
+		} else
+			weight[k] = 1.0;
+	}
+}
+
+
+/*
+ *  Sum weighted power of main lobe around bin, limited to the band, and
+ *  mark its bins as used
+ */
+
+double DistortionAnalyzer::lobe_power(int center, int low, int high)
+{
+	double sum = 0;
+	int from = center - LOBE < low ? low : center - LOBE;
+	int to = center + LOBE > high ? high : center + LOBE;
+	for (int k=from; k<=to; k++)
+		if (!used[k]) {
+			sum += power[k] * weight[k];
+			used[k] = 1;
+		}
+	return sum;
+}
+
+
+/*
+ *  Find median of n values (reorders them)
+ */
+
+static float median(float *a, int n)
+{
+	int k = n / 2, lo = 0, hi = n - 1;
+	while (lo < hi) {
+		float pivot = a[k];
+		int i = lo, j = hi;
+		do {
+			while (a[i] < pivot) i++;
+			while (pivot < a[j]) j--;
+			if (i <= j) {
+				float t = a[i]; a[i] = a[j]; a[j] = t;
+				i++; j--;
+			}
+		} while (i <= j);
+		if (j < k) lo = i;
+		if (k < i) hi = j;
+	}
+	return a[k];
+}
+
+
+/*
+ *  Analyse block of size samples
+ */
+
+void DistortionAnalyzer::Analyse(const float *samples, distortion_result *res)
+{
+	int i, k, half = size / 2;
+	memset(res, 0, sizeof(distortion_result));
+
+	for (i=0; i<size; i++) {
+		re[i] = samples[i] * window[i];
+		im[i] = 0;
+	}
+	the_fft->Forward(re, im);
+	for (k=0; k<=half; k++) {
+		power[k] = re[k] * re[k] + im[k] * im[k];
+		used[k] = 0;
+	}
+
+	// One-sided power of a full scale sine
+	double full_scale = 32768.0 * 32768.0 / 4 * size * window_power;
+
+	// Fundamental: largest peak in band, frequency interpolated on the log spectrum
+	int peak = low_bin;
+	for (k=low_bin; k<=high_bin; k++)
+		if (power[k] > power[peak])
+			peak = k;
+	double s = 0;
+	for (k=peak-LOBE; k<=peak+LOBE; k++)
+		if (k >= 0 && k <= half) {
+			s += power[k];
+			used[k] = 1;
+		}
+	res->level = s > 0 ? 10 * log10(s / full_scale) : -200;
+	if (res->level < MIN_LEVEL)
+		return;
+	double delta = 0;
+	if (peak > 0 && peak < half && power[peak-1] > 0 && power[peak+1] > 0) {
+		double a = log(power[peak-1]), b = log(power[peak]), c = log(power[peak+1]);
+		if (a - 2 * b + c != 0)
+			delta = 0.5 * (a - c) / (a - 2 * b + c);
+	}
+	double f0 = peak + delta;
+	res->freq = f0 * rate / size;
+
+	// Harmonics
+	double h = 0;
+	for (int n=2; n<=MAX_HARMONIC; n++) {
+		int c = int(n * f0 + 0.5);
+		if (c > high_bin)
+			break;
+		h += lobe_power(c, low_bin, high_bin);
+	}
+
+	// Noise is the rest of the band; floor is the median of the noise bins
+	double noise = 0;
+	int num_noise = 0;
+	for (k=low_bin; k<=high_bin; k++)
+		if (!used[k]) {
+			noise += power[k] * weight[k];
+			re[num_noise++] = power[k];
+		}
+	res->floor = num_noise > 0 ? 10 * log10(median(re, num_noise) / full_scale + 1E-30) : -200;
+
+	res->valid = true;
+	res->thd = 100 * sqrt(h / s);
+	res->thd_n = 100 * sqrt((h + noise) / s);
+	res->sinad = h + noise > 0 ? 10 * log10((s + h + noise) / (h + noise)) : 200;
+	res->snr = noise > 0 ? 10 * log10(s / noise) : 200;
+}
+
+
+/*
+ *  Distortion looper constructor
+ */
+
+DistortionLooper::DistortionLooper(BLooper *target, float sample_rate) : BLooper("QScope Distortion", B_LOW_PRIORITY)
+{
+	the_target = target;
+	rate = sample_rate;
+	analyzer = new DistortionAnalyzer(rate, DEFAULT_DIST_FFT);
+
+	state = DIST_OFF;
+	channel = false;
+	restart = 0;
+	block_size = DEFAULT_DIST_FFT;
+	hop = int(rate / UPDATES_PER_SEC);
+	if (hop > block_size)
+		hop = block_size;
+
+	ring = new float[RING_SIZE];
+	write_pos = 0;
+	filled = 0;
+	since_post = 0;
+	block = new float[MAX_DIST_FFT];
+	Run();
+}
+
+
+/*
+ *  Distortion looper destructor
+ */
+
+DistortionLooper::~DistortionLooper()
+{
+	delete analyzer;
+	delete[] ring;
+	delete[] block;
+}
+
+
+/*
+ *  Start/stop continuous analysis (called by window)
+ */
+
+void DistortionLooper::Start(void)
+{
+	atomic_set(&restart, 1);
+	atomic_test_and_set(&state, DIST_IDLE, DIST_OFF);
+}
+
+void DistortionLooper::Stop(void)
+{
+	atomic_set(&state, DIST_OFF);
+}
+
+
+/*
+ *  Change analysis parameters (called by window, applied by looper thread)
+ */
+
+void DistortionLooper::Setup(int size, int bandwidth, int weighting)
+{
+	BMessage msg(MSG_DIST_SETUP);
+	msg.AddInt32("size", size);
+	msg.AddInt32("bandwidth", bandwidth);
+	msg.AddInt32("weighting", weighting);
+	PostMessage(&msg);
+}
+
+
+/*
+ *  Append channel to ring and request analysis when a hop of new frames
+ *  has arrived and the last analysis is done (called by audio thread)
+ */
+
+void DistortionLooper::Capture(const int16 *buf, int count)
+{
+	if (atomic_get(&state) == DIST_OFF)
+		return;
+	if (atomic_get_and_set(&restart, 0)) {
+		filled = 0;
+		since_post = 0;
+	}
+
+	const int16 *p = buf + (atomic_get(&channel) ? 1 : 0);
+	uint32 pos = write_pos;
+	for (int i=0; i<count; i++, pos++)
+		ring[pos & (RING_SIZE - 1)] = p[i * 2];
+	atomic_set(&write_pos, pos);
+
+	filled += count;
+	if (filled > RING_SIZE)
+		filled = RING_SIZE;
+	since_post += count;
+	if (filled >= atomic_get(&block_size) && since_post >= atomic_get(&hop) && atomic_test_and_set(&state, DIST_BUSY, DIST_IDLE) == DIST_IDLE) {
+		since_post = 0;
+		PostMessage(MSG_DIST_CAPTURED);
+	}
+}
+
+
+/*
+ *  Handle messages
+ */
+
+void DistortionLooper::MessageReceived(BMessage *msg)
+{
+	switch (msg->what) {
+		case MSG_DIST_CAPTURED:
+			if (atomic_get(&state) != DIST_BUSY)
+				break;
+			analyse();
+			atomic_test_and_set(&state, DIST_IDLE, DIST_BUSY);
+			break;
+
+		case MSG_DIST_SETUP: {
+			int32 size, bandwidth, weighting;
+			if (msg->FindInt32("size", &size) != B_NO_ERROR || msg->FindInt32("bandwidth", &bandwidth) != B_NO_ERROR || msg->FindInt32("weighting", &weighting) != B_NO_ERROR)
+				break;
+			if (size < MIN_DIST_FFT || size > MAX_DIST_FFT)
+				break;
+			analyzer->SetSize(size);
+			analyzer->SetBandwidth(bandwidth);
+			analyzer->SetWeighting(weighting);
+			atomic_set(&block_size, size);
+			int32 h = int(rate / UPDATES_PER_SEC);
+			atomic_set(&hop, h > size ? size : h);
+			break;
+		}
+
+		default:
+			BLooper::MessageReceived(msg);
+	}
+}
+
+
+/*
+ *  Analyse newest block and report to target
+ */
+
+void DistortionLooper::analyse(void)
+{
+	int n = block_size;
+	bigtime_t start = system_time();
+
+	// Copy newest block; give up if the audio thread overwrote it meanwhile
+	uint32 end = atomic_get(&write_pos);
+	for (int i=0; i<n; i++)
+		block[i] = ring[(end - n + i) & (RING_SIZE - 1)];
+	if (uint32(atomic_get(&write_pos)) - end > uint32(RING_SIZE - n))
+		return;
+
+	distortion_result res;
+	analyzer->Analyse(block, &res);
+
+	BMessage reply(MSG_DIST_RESULT);
+	reply.AddBool("valid", res.valid);
+	reply.AddFloat("level", res.level);
+	if (res.valid) {
+		reply.AddFloat("freq", res.freq);
+		reply.AddFloat("thd", res.thd);
+		reply.AddFloat("thd_n", res.thd_n);
+		reply.AddFloat("sinad", res.sinad);
+		reply.AddFloat("snr", res.snr);
+		reply.AddFloat("floor", res.floor);
+	}
+	reply.AddInt64("time", system_time() - start);
+	the_target->PostMessage(&reply);
+}
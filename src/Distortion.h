@@ -0,0 +1,138 @@
+/*
+ *  Distortion.h - THD, THD+N, SINAD, SNR and noise floor analyzer
+ *
+ *  Written in 2026 for QScope (original program by Christian Bauer)
+ */
+
+#ifndef __DISTORTION_H__
+#define __DISTORTION_H__
+
+#include <AppKit.h>
+
+class FFT;
+
+
+// Messages
+const uint32 MSG_DIST_CAPTURED = 'dcap';	// Enough new frames for another analysis (to DistortionLooper)
+const uint32 MSG_DIST_SETUP = 'dset';		// New settings (to DistortionLooper)
+const uint32 MSG_DIST_RESULT = 'dres';		// Analysis result (to target)
+
+enum {	// Bandwidths, in order of the menu
+	DIST_BW_20K,		// 20Hz..20kHz
+	DIST_BW_80K,		// 20Hz..80kHz
+	DIST_BW_FULL,		// 20Hz..Nyquist
+	NUM_DIST_BANDWIDTHS
+};
+
+enum {	// Weightings, in order of the menu
+	DIST_WEIGHT_NONE,
+	DIST_WEIGHT_A,
+	NUM_DIST_WEIGHTINGS
+};
+
+const int MIN_DIST_FFT = 4096;		// Range of analysis sizes
+const int MAX_DIST_FFT = 65536;
+
+
+// Result of one analysis
+struct distortion_result {
+	bool valid;			// False if no fundamental found
+	float freq;			// Fundamental frequency (Hz)
+	float level;		// Fundamental level (dBFS)
+	float thd;			// Harmonics 2..10 relative to fundamental (%)
+	float thd_n;		// Everything but the fundamental relative to fundamental (%)
+	float sinad;		// Total relative to everything but the fundamental (dB)
+	float snr;			// Fundamental relative to noise without harmonics (dB)
+	float floor;		// Median noise power per FFT bin (dBFS)
+};
+
+
+/*
+ *  Analyses one block: 7-term Blackman-Harris window and FFT, fundamental found
+ *  as the largest peak in the band, then the band power is split into
+ *  fundamental, harmonics and the rest by summing the bins of each main
+ *  lobe ("notching" in the spectrum). Weighting applies to everything but
+ *  the fundamental.
+ */
+
+class DistortionAnalyzer {
+public:
+	DistortionAnalyzer(float rate, int size);
+	~DistortionAnalyzer();
+
+	void SetSize(int size);
+	int Size(void) {return size;}
+	void SetBandwidth(int bw) {bandwidth = bw; make_weights();}
+	void SetWeighting(int w) {weighting = w; make_weights();}
+
+	void Analyse(const float *samples, distortion_result *res);
+
+private:
+	void make_weights(void);
+	double lobe_power(int center, int low, int high);
+
+	float rate;
+	int size;
+	int bandwidth;			// DIST_BW_...
+	int weighting;			// DIST_WEIGHT_...
+	int low_bin, high_bin;	// Analysed band
+
+	FFT *the_fft;
+	float *window;
+	float window_power;		// Sum of squared window values
+	float *weight;			// Power weighting of each bin
+	float *re, *im;
+	float *power;			// Power spectrum
+	uint8 *used;			// Bin belongs to fundamental or a harmonic
+};
+
+
+/*
+ *  Collects the incoming stream in a ring and analyses the newest block on
+ *  its own thread several times per second; results are sent to the target
+ *  as MSG_DIST_RESULT with the fields of distortion_result.
+ */
+
+class DistortionLooper : public BLooper {
+public:
+	DistortionLooper(BLooper *target, float sample_rate);
+	virtual ~DistortionLooper();
+	virtual void MessageReceived(BMessage *msg);
+
+	void Start(void);
+	void Stop(void);
+	bool Running(void) {return atomic_get(&state) != DIST_OFF;}
+	void SetChannel(bool right) {atomic_set(&channel, right);}
+	void Setup(int size, int bandwidth, int weighting);
+
+	// Called by audio thread
+	void Capture(const int16 *buf, int count);
+
+private:
+	enum {	// Analyzer states
+		DIST_OFF,
+		DIST_IDLE,		// Waiting for enough new frames
+		DIST_BUSY		// Analysis requested or running
+	};
+
+	void analyse(void);
+
+	BLooper *the_target;
+	float rate;
+	DistortionAnalyzer *analyzer;
+
+	int32 state;		// Analyzer state (DIST_...), shared with audio thread
+	int32 channel;		// Analyse right channel
+	int32 restart;		// Discard ring contents with next buffer
+	int32 block_size;	// Frames per analysis
+	int32 hop;			// Frames between analyses
+
+	float *ring;		// Last 2*MAX_DIST_FFT frames of analysed channel
+	int32 write_pos;	// Total number of frames written to ring
+	int filled;			// Valid frames in ring (audio thread)
+	int since_post;		// Frames since last analysis request (audio thread)
+
+	float *block;		// Copy of ring for analysis
+};
+
+#endif
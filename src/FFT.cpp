@@ -0,0 +1,128 @@
+/*
+ *  FFT.cpp - Radix-2 complex FFT
+ *
+ *  Written in 2026 for QScope (original program by Christian Bauer)
+ */
+
+#include <math.h>
+
+#include "FFT.h"
+
+
+/*
+ *  Smallest power of two >= points
+ */
+
+int FFTSizeFor(int points)
+{
+	int n = 1;
+	while (n < points)
+		n <<= 1;
+	return n;
+}
+
+
+/*
+ *  FFT constructor, precompute tables
+ */
+
+FFT::FFT(int n)
+{
+	size = n;
+
+	int bits = 0;
+	while ((1 << bits) < size)
+		bits++;
+
+	bit_rev = new int[size];
+	for (int i=0; i<size; i++) {
+		int r = 0;
+		for (int b=0; b<bits; b++)
+			if (i & (1 << b))
+				r |= 1 << (bits - 1 - b);
+		bit_rev[i] = r;
+	}
+
+	cos_table = new float[size / 2 + 1];
+	sin_table = new float[size / 2 + 1];
+	for (int i=0; i<=size/2; i++) {
+		cos_table[i] = cos(2.0 * M_PI * i / size);
+		sin_table[i] = sin(2.0 * M_PI * i / size);
+	}
+}
+
+
+/*
+ *  FFT destructor
+ */
+
+FFT::~FFT()
+{
+	delete[] bit_rev;
+	delete[] cos_table;
+	delete[] sin_table;
+}
+
+
+/*
+ *  Forward transform (in place, unnormalized)
+ */
+
+void FFT::Forward(float *re, float *im)
+{
+	transform(re, im, -1.0);
+}
+
+
+/*
+ *  Inverse transform (in place, scaled by 1/size)
+ */
+
+void FFT::Inverse(float *re, float *im)
+{
+	transform(re, im, 1.0);
+	float scale = 1.0 / size;
+	for (int i=0; i<size; i++) {
+		re[i] *= scale;
+		im[i] *= scale;
+	}
+}
+
+
+/*
+ *  Iterative decimation-in-time butterfly
+ */
+
+void FFT::transform(float *re, float *im, float sign)
+{
+	int i, j;
+
+	// Reorder input
+	for (i=0; i<size; i++) {
+		j = bit_rev[i];
+		if (j > i) {
+			float t = re[i]; re[i] = re[j]; re[j] = t;
+			t = im[i]; im[i] = im[j]; im[j] = t;
+		}
+	}
+
+	// Butterflies
+	for (int len=2; len<=size; len<<=1) {
+		int half = len >> 1;
+		int step = size / len;
+		for (i=0; i<size; i+=len) {
+			for (j=0; j<half; j++) {
+				float wr = cos_table[j * step];
+				float wi = sign * sin_table[j * step];
+				float *ar = re + i + j, *ai = im + i + j;
+				float *br = ar + half, *bi = ai + half;
+				float tr = *br * wr - *bi * wi;
+				float ti = *br * wi + *bi * wr;
+				*br = *ar - tr;
+				*bi = *ai - ti;
+				*ar += tr;
+				*ai += ti;
+			}
+		}
+	}
+}
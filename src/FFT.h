@@ -0,0 +1,33 @@
+/*
+ *  FFT.h - Radix-2 complex FFT
+ *
+ *  Written in 2026 for QScope (original program by Christian Bauer)
+ */
+
+#ifndef __FFT_H__
+#define __FFT_H__
+
+#include <SupportDefs.h>
+
+
+class FFT {
+public:
+	FFT(int size);
+	~FFT();
+
+	int Size(void) {return size;}
+	void Forward(float *re, float *im);
+	void Inverse(float *re, float *im);
+
+private:
+	void transform(float *re, float *im, float sign);
+
+	int size;			// Number of points (power of two)
+	int *bit_rev;		// Bit-reversal permutation table
+	float *cos_table;	// Twiddle factors (size/2 entries each)
+	float *sin_table;
+};
+
+extern int FFTSizeFor(int points);
+
+#endif
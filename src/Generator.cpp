@@ -0,0 +1,384 @@
+/*
+ *  Generator.cpp - Band-limited multi-channel test signal generator
+ *
+ *  Written in 2026 for QScope (original program by Christian Bauer)
+ */
+
+#include <SupportDefs.h>
+#include <math.h>
+#include <string.h>
+
+#include "Generator.h"
+
+
+// Wavetables: TABLE_SIZE points plus one guard point for interpolation
+const int TABLE_BITS = 12;
+const int TABLE_SIZE = 1 << TABLE_BITS;
+const int NUM_LEVELS = TABLE_BITS - 1;	// Level n holds 2^n harmonics
+
+// Sweep and burst parameters
+const float SWEEP_END = 20000.0;
+const float SWEEP_TIME = 1.0;
+const int SWEEP_BLOCK = 32;		// Frames between sweep frequency updates
+const int BURST_CYCLES = 10;
+
+// Multitone: 1/3 octave tones from 20Hz to 20kHz in a table of this length
+const int MULTITONE_LEN = 65536;
+const float MULTITONE_LOW = 20.0;
+const float MULTITONE_HIGH = 20000.0;
+
+const uint32 NOISE_SEED = 0x12345678;
+const int32 SETTINGS_NEW = 4;
+
+static const char *wave_names[NUM_WAVES] = {"Sine", "Square", "Triangle", "Sweep", "Multitone", "Noise", "Burst"};
+
+static float sine_table[TABLE_SIZE + 1];
+static float square_table[NUM_LEVELS][TABLE_SIZE + 1];
+static float triangle_table[NUM_LEVELS][TABLE_SIZE + 1];
+static bool tables_built = false;
+
+
+/*
+ *  Build wavetables, square and triangle by additive synthesis for each
+ *  harmonic count (only done once, by the first constructor)
+ */
+
+void SignalGenerator::build_tables(void)
+{
+	if (tables_built)
+		return;
+
+	for (int i=0; i<=TABLE_SIZE; i++)
+		sine_table[i] = sin(2 * M_PI * i / TABLE_SIZE);
+
+	for (int l=0; l<NUM_LEVELS; l++) {
+		int harmonics = 1 << l;
+		float sq_max = 0, tri_max = 0;
+		for (int i=0; i<TABLE_SIZE; i++) {
+			double sq = 0, tri = 0;
+			for (int h=1; h<=harmonics; h+=2) {
+				int p = (h * i) & (TABLE_SIZE - 1);
+				sq += sine_table[p] / h;
+				tri += ((h >> 1) & 1 ? -1.0 : 1.0) * sine_table[p] / (h * h);
+			}
+			square_table[l][i] = sq;
+			triangle_table[l][i] = tri;
+			if (fabs(sq) > sq_max) sq_max = fabs(sq);
+			if (fabs(tri) > tri_max) tri_max = fabs(tri);
+		}
+
+		// Normalize to full scale (square overshoots because of Gibbs phenomenon)
+		for (int i=0; i<TABLE_SIZE; i++) {
+			square_table[l][i] /= sq_max;
+			triangle_table[l][i] /= tri_max;
+		}
+		square_table[l][TABLE_SIZE] = square_table[l][0];
+		triangle_table[l][TABLE_SIZE] = triangle_table[l][0];
+	}
+	tables_built = true;
+}
+
+
+/*
+ *  Choose bins for a multitone of len points (a power of two), logarithmically
+ *  spaced between low and high. Every tone gets a whole number of cycles in
+ *  the table so it loops seamlessly; tones closer than one bin are merged.
+ */
+
+int MultitoneBins(int *bins, int max_tones, int len, float rate, float low, float high, float per_octave)
+{
+	int num = 0;
+	for (double f=low; f<=high*1.01 && f<rate/2 && num<max_tones; f*=pow(2.0, 1.0/per_octave)) {
+		int k = int(f * len / rate + 0.5);
+		if (k > 0 && (num == 0 || k != bins[num-1]))
+			bins[num++] = k;
+	}
+	return num;
+}
+
+
+/*
+ *  Build multitone from cosines at the given bins, with Schroeder phases
+ *  (pi*t^2/num for tone t, stored in phases if not NULL) for a low crest
+ *  factor. The table is normalized to a peak of 1, the amplitude every tone
+ *  ends up with is returned.
+ */
+
+float MakeMultitone(float *table, int len, const int *bins, int num, float *phases)
+{
+	float *cos_table = new float[len];
+	for (int i=0; i<len; i++) {
+		table[i] = 0;
+		cos_table[i] = cos(2 * M_PI * i / len);
+	}
+	for (int t=0; t<num; t++) {
+		uint32 pos = uint32(0.5 * t * t / num * len) & (len - 1);
+		if (phases != NULL)
+			phases[t] = 2 * M_PI * pos / len;
+		for (int i=0; i<len; i++, pos+=bins[t])
+			table[i] += cos_table[pos & (len - 1)];
+	}
+	delete[] cos_table;
+
+	float peak = 0;
+	for (int i=0; i<len; i++)
+		if (fabs(table[i]) > peak)
+			peak = fabs(table[i]);
+	if (peak == 0)
+		return 0;
+	for (int i=0; i<len; i++)
+		table[i] /= peak;
+	return 1.0 / peak;
+}
+
+
+/*
+ *  Generator constructor
+ */
+
+SignalGenerator::SignalGenerator(float rate, int channels)
+{
+	build_tables();
+	sample_rate = rate;
+	num_channels = channels > MAX_GEN_CHANNELS ? MAX_GEN_CHANNELS : channels;
+
+	// 1/3 octave multitone
+	int bins[MAX_MULTITONE_TONES];
+	multitone_len = MULTITONE_LEN;
+	multitone = new float[multitone_len + 1];
+	MakeMultitone(multitone, multitone_len, bins, MultitoneBins(bins, MAX_MULTITONE_TONES, multitone_len, rate, MULTITONE_LOW, MULTITONE_HIGH, 3));
+	multitone[multitone_len] = multitone[0];
+
+	write_slot = 0;
+	ready_slot = 1;
+	read_slot = 2;
+	memset(cur, 0, sizeof(cur));
+	for (int c=0; c<MAX_GEN_CHANNELS; c++)
+		SetChannel(c, WAVE_SINE, 1000.0, 0.0);
+	update_settings();
+	Reset();
+}
+
+
+/*
+ *  Generator destructor
+ */
+
+SignalGenerator::~SignalGenerator()
+{
+	delete[] multitone;
+}
+
+
+/*
+ *  Set parameters of one channel (window side)
+ */
+
+void SignalGenerator::SetChannel(int ch, int wave, float freq, float level, float phase)
+{
+	if (ch < 0 || ch >= MAX_GEN_CHANNELS)
+		return;
+	new_settings[ch].wave = wave;
+	new_settings[ch].freq = freq;
+	new_settings[ch].level = level;
+	new_settings[ch].phase = phase;
+
+	memcpy(settings_slot[write_slot], new_settings, sizeof(new_settings));
+	write_slot = atomic_get_and_set(&ready_slot, write_slot | SETTINGS_NEW) & 3;
+}
+
+
+/*
+ *  Get name of waveform
+ */
+
+const char *SignalGenerator::WaveName(int wave)
+{
+	return wave_names[wave];
+}
+
+
+/*
+ *  Start all channels from the beginning (audio side, or while not running)
+ */
+
+void SignalGenerator::Reset(void)
+{
+	for (int c=0; c<MAX_GEN_CHANNELS; c++) {
+		state[c].started = false;
+		state[c].seed = NOISE_SEED + c * 0x9e3779b9;
+		state[c].counter = 0;
+	}
+}
+
+
+/*
+ *  Take over new settings (audio side)
+ */
+
+void SignalGenerator::update_settings(void)
+{
+	if (!(atomic_get(&ready_slot) & SETTINGS_NEW))
+		return;
+	read_slot = atomic_get_and_set(&ready_slot, read_slot) & 3;
+	const channel_settings *s = settings_slot[read_slot];
+	for (int c=0; c<MAX_GEN_CHANNELS; c++) {
+		if (s[c].wave != cur[c].wave || s[c].freq != cur[c].freq) {
+			state[c].counter = 0;	// Restart sweep/burst/multitone
+			state[c].sweep_step = s[c].freq / sample_rate * 4294967296.0;
+		}
+		state[c].step = uint32(s[c].freq / sample_rate * 4294967296.0);
+	}
+	memcpy(cur, s, sizeof(cur));
+}
+
+
+/*
+ *  Select band-limited table for frequency
+ */
+
+const float *SignalGenerator::table_for(int wave, float freq)
+{
+	if (wave == WAVE_SINE || wave == WAVE_SWEEP || wave == WAVE_BURST)
+		return sine_table;
+	int harmonics = freq > 0 ? int(sample_rate / 2 / freq) : 1;
+	int l = 0;
+	while (l < NUM_LEVELS-1 && (2 << l) <= harmonics)
+		l++;
+	return wave == WAVE_SQUARE ? square_table[l] : triangle_table[l];
+}
+
+
+/*
+ *  Render all channels into interleaved buffer
+ */
+
+void SignalGenerator::Generate(int16 *buf, int frames)
+{
+	update_settings();
+	render<false>(buf, frames);
+}
+
+void SignalGenerator::Mix(int16 *buf, int frames)
+{
+	update_settings();
+	render<true>(buf, frames);
+}
+
+template <bool MIX> void SignalGenerator::render(int16 *buf, int frames)
+{
+	for (int c=0; c<num_channels; c++)
+		render_channel<MIX>(c, buf + c, frames);
+}
+
+static inline int16 out_sample(int16 old, float y, bool mix)
+{
+	int32 v = int32(y) + (mix ? old : 0);
+	return v > 32767 ? 32767 : (v < -32768 ? -32768 : v);
+}
+
+// Linear interpolation in wavetable at phase accumulator value
+static inline float lookup(const float *t, uint32 phase)
+{
+	uint32 i = phase >> (32 - TABLE_BITS);
+	float frac = float(phase & ((1 << (32 - TABLE_BITS)) - 1)) * (1.0 / (1 << (32 - TABLE_BITS)));
+	return t[i] + frac * (t[i + 1] - t[i]);
+}
+
+template <bool MIX> void SignalGenerator::render_channel(int ch, int16 *buf, int frames)
+{
+	const channel_settings &s = cur[ch];
+	channel_state &st = state[ch];
+	int stride = num_channels;
+	float amp = s.level * 32767.0;
+
+	if (!st.started) {
+		st.started = true;
+		st.phase = uint32(s.phase * 4294967296.0);
+		st.counter = 0;
+		st.sweep_step = s.freq / sample_rate * 4294967296.0;
+	}
+
+	if (amp == 0) {
+		if (!MIX)
+			for (int i=0; i<frames; i++)
+				buf[i * stride] = 0;
+		return;
+	}
+
+	switch (s.wave) {
+		case WAVE_SINE:
+		case WAVE_SQUARE:
+		case WAVE_TRIANGLE: {
+			const float *t = table_for(s.wave, s.freq);
+			uint32 phase = st.phase, step = st.step;
+			for (int i=0; i<frames; i++, phase+=step)
+				buf[i * stride] = out_sample(buf[i * stride], amp * lookup(t, phase), MIX);
+			st.phase = phase;
+			break;
+		}
+
+		case WAVE_SWEEP: {
+			int sweep_frames = int(SWEEP_TIME * sample_rate);
+			double ratio = pow(SWEEP_END / s.freq, double(SWEEP_BLOCK) / sweep_frames);
+			uint32 phase = st.phase;
+			for (int i=0; i<frames; ) {
+				int n = SWEEP_BLOCK - st.counter % SWEEP_BLOCK;
+				if (n > frames - i)
+					n = frames - i;
+				uint32 step = uint32(st.sweep_step);
+				for (int j=0; j<n; j++, i++, phase+=step)
+					buf[i * stride] = out_sample(buf[i * stride], amp * lookup(sine_table, phase), MIX);
+				st.counter += n;
+				if (st.counter >= sweep_frames) {
+					st.counter = 0;
+					st.sweep_step = s.freq / sample_rate * 4294967296.0;
+				} else if (st.counter % SWEEP_BLOCK == 0)
+					st.sweep_step *= ratio;
+			}
+			st.phase = phase;
+			break;
+		}
+
+		case WAVE_MULTITONE: {
+			const float *t = multitone;
+			int pos = st.counter;
+			for (int i=0; i<frames; i++) {
+				buf[i * stride] = out_sample(buf[i * stride], amp * t[pos], MIX);
+				if (++pos == multitone_len)
+					pos = 0;
+			}
+			st.counter = pos;
+			break;
+		}
+
+		case WAVE_NOISE: {
+			uint32 seed = st.seed;
+			for (int i=0; i<frames; i++) {
+				seed = seed * 1664525 + 1013904223;
+				buf[i * stride] = out_sample(buf[i * stride], amp * (int32(seed) * (1.0 / 2147483648.0)), MIX);
+			}
+			st.seed = seed;
+			break;
+		}
+
+		case WAVE_BURST: {
+			int burst_len = int(BURST_CYCLES * 4 * sample_rate / s.freq);
+			int burst_on = burst_len / 4;
+			uint32 phase = st.phase, step = st.step;
+			int counter = st.counter;
+			for (int i=0; i<frames; i++) {
+				float y = counter < burst_on ? lookup(sine_table, phase) : 0;
+				buf[i * stride] = out_sample(buf[i * stride], amp * y, MIX);
+				phase += step;
+				if (++counter >= burst_len) {	// Every burst starts at the start phase
+					counter = 0;
+					phase = uint32(s.phase * 4294967296.0);
+				}
+			}
+			st.phase = phase;
+			st.counter = counter;
+			break;
+		}
+	}
+}
@@ -0,0 +1,95 @@
+/*
+ *  Generator.h - Band-limited multi-channel test signal generator
+ *
+ *  Written in 2026 for QScope (original program by Christian Bauer)
+ */
+
+#ifndef __GENERATOR_H__
+#define __GENERATOR_H__
+
+#include <SupportDefs.h>
+
+
+enum {	// Waveforms, in order of the menu
+	WAVE_SINE,
+	WAVE_SQUARE,
+	WAVE_TRIANGLE,
+	WAVE_SWEEP,			// Logarithmic sine sweep from the channel frequency to 20kHz in 1s
+	WAVE_MULTITONE,		// 1/3 octave tones 20Hz..20kHz (channel frequency not used)
+	WAVE_NOISE,
+	WAVE_BURST,			// Sine, 10 cycles on and 30 off
+	NUM_WAVES
+};
+
+const int MAX_GEN_CHANNELS = 8;
+const int MAX_MULTITONE_TONES = 256;
+
+
+/*
+ *  Each channel has its own waveform, frequency, level and start phase.
+ *  Periodic waveforms are read from wavetables with a 32 bit phase
+ *  accumulator; square and triangle use the table with as many harmonics
+ *  as fit below half the sample rate, so they don't alias.
+ *  Settings are handed to the audio thread like the scope settings (a
+ *  triple buffer) and take effect with the next buffer, without a phase
+ *  jump.
+ */
+
+class SignalGenerator {
+public:
+	SignalGenerator(float rate, int channels);
+	~SignalGenerator();
+
+	// Window side
+	void SetChannel(int ch, int wave, float freq, float level, float phase = 0);
+	static const char *WaveName(int wave);
+
+	// Audio side
+	void Reset(void);
+	void Generate(int16 *buf, int frames);	// Replace buffer contents
+	void Mix(int16 *buf, int frames);		// Add to buffer contents
+
+private:
+	struct channel_settings {
+		int wave;
+		float freq;			// Hz
+		float level;		// 0..1 of full scale
+		float phase;		// Start phase in cycles
+	};
+
+	struct channel_state {
+		uint32 phase;		// Phase accumulator (2^32 = one cycle)
+		uint32 step;		// Phase increment per frame
+		uint32 seed;		// Noise generator state
+		int counter;		// Frame counter for sweep/burst
+		double sweep_step;	// Current sweep phase increment (fractional)
+		bool started;
+	};
+
+	template <bool MIX> void render(int16 *buf, int frames);
+	template <bool MIX> void render_channel(int ch, int16 *buf, int frames);
+	void update_settings(void);
+
+	static void build_tables(void);
+	const float *table_for(int wave, float freq);
+
+	float sample_rate;
+	int num_channels;
+
+	channel_settings new_settings[MAX_GEN_CHANNELS];	// Window side
+	channel_settings settings_slot[3][MAX_GEN_CHANNELS];
+	int write_slot;
+	int32 ready_slot;
+	int read_slot;
+	channel_settings cur[MAX_GEN_CHANNELS];				// Audio side
+	channel_state state[MAX_GEN_CHANNELS];
+
+	float *multitone;		// One period of the multitone signal
+	int multitone_len;
+};
+
+// Multitone construction, shared with the frequency response measurement
+extern int MultitoneBins(int *bins, int max_tones, int len, float rate, float low, float high, float per_octave);
+extern float MakeMultitone(float *table, int len, const int *bins, int num, float *phases = NULL);
+
+#endif
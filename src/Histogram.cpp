@@ -0,0 +1,99 @@
+/*
+ *  Histogram.cpp - Lock-free histogram of time intervals
+ *
+ *  Written in 2026 for QScope (original program by Christian Bauer)
+ */
+
+#include <SupportDefs.h>
+#include <string.h>
+
+#include "Histogram.h"
+
+
+/*
+ *  Histogram constructor
+ */
+
+Histogram::Histogram()
+{
+	memset(buckets, 0, sizeof(buckets));
+	count = 0;
+	max = 0;
+}
+
+
+/*
+ *  Bucket of interval t: 0 below 1µs, then four per octave, the last one from 2^HIST_OCTAVES µs on
+ */
+
+int Histogram::bucket(bigtime_t t)
+{
+	if (t < 1)
+		return 0;
+	int octave = 0;
+	while (octave < HIST_OCTAVES && (t >> (octave + 1)) != 0)
+		octave++;
+	if (octave == HIST_OCTAVES)
+		return NUM_HIST_BUCKETS - 1;
+	return 1 + (octave << 2) + int(((t << 2) >> octave) & 3);
+}
+
+double Histogram::BucketStart(int i)
+{
+	if (i == 0)
+		return 0;
+	i--;
+	return double(4 + (i & 3)) * double(1 << (i >> 2)) / 4;
+}
+
+
+/*
+ *  Count interval (any thread)
+ */
+
+void Histogram::Add(bigtime_t t)
+{
+	atomic_add(&buckets[bucket(t)], 1);
+	atomic_add(&count, 1);
+
+	int32 m = t < 0x7fffffff ? int32(t) : 0x7fffffff;
+	int32 old = atomic_get(&max);
+	while (m > old) {
+		int32 prev = atomic_test_and_set(&max, m, old);
+		if (prev == old)
+			break;
+		old = prev;
+	}
+}
+
+
+/*
+ *  Move counts to copy and start over
+ */
+
+void Histogram::Take(Histogram *copy)
+{
+	for (int i=0; i<NUM_HIST_BUCKETS; i++)
+		copy->buckets[i] = atomic_get_and_set(&buckets[i], 0);
+	copy->count = atomic_get_and_set(&count, 0);
+	copy->max = atomic_get_and_set(&max, 0);
+}
+
+
+/*
+ *  Interval that p (0..1) of the counts don't exceed, to the resolution of the buckets
+ */
+
+double Histogram::Percentile(double p)
+{
+	double target = p * count;
+	int32 sum = 0;
+	for (int i=0; i<NUM_HIST_BUCKETS-1; i++) {
+		sum += buckets[i];
+		if (sum > 0 && sum >= target) {
+			double end = BucketStart(i + 1);
+			return end < max ? end : max;
+		}
+	}
+	return max;
+}
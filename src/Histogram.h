@@ -0,0 +1,47 @@
+/*
+ *  Histogram.h - Lock-free histogram of time intervals
+ *
+ *  Written in 2026 for QScope (original program by Christian Bauer)
+ */
+
+#ifndef __HISTOGRAM_H__
+#define __HISTOGRAM_H__
+
+#include <SupportDefs.h>
+
+
+const int HIST_OCTAVES = 24;	// 1µs to 16s
+const int NUM_HIST_BUCKETS = HIST_OCTAVES * 4 + 2;	// Four per octave, one below and one above
+
+
+/*
+ *  Counts intervals in microseconds in buckets of a quarter octave. Add()
+ *  may be called from any thread at any time, it only increments counters
+ *  (nothing is locked or allocated). Take() moves the counts to another
+ *  histogram, which is then read at leisure; an interval added meanwhile
+ *  is counted in either of both.
+ */
+
+class Histogram {
+public:
+	Histogram();
+
+	void Add(bigtime_t t);
+	void Take(Histogram *copy);
+
+	// Reading (not while Add() is called)
+	int32 Count(void) {return count;}
+	int32 BucketCount(int i) {return buckets[i];}
+	bigtime_t Max(void) {return max;}
+	double Percentile(double p);		// Upper end of the bucket below which p of the counts are (at most Max())
+	static double BucketStart(int i);	// Lower end of bucket i in microseconds
+
+private:
+	static int bucket(bigtime_t t);
+
+	int32 buckets[NUM_HIST_BUCKETS];
+	int32 count;	// Sum of all buckets
+	int32 max;		// Longest interval
+};
+
+#endif
@@ -0,0 +1,285 @@
+/*
+ *  Latency.cpp - Loopback latency measurement
+ *
+ *  Written in 2026 for QScope (original program by Christian Bauer)
+ */
+
+#include <AppKit.h>
+#include <math.h>
+#include <string.h>
+
+#include "Latency.h"
+#include "FFT.h"
+
+
+// Chirp length in seconds and frequency range
+const float CHIRP_TIME = 0.25;
+const float CHIRP_LOW = 200.0;
+const float CHIRP_HIGH_FACTOR = 0.4;	// Upper frequency as fraction of sample rate
+const float CHIRP_FADE = 0.005;			// Fade in/out time in seconds
+const float CHIRP_LEVEL = 3276.0;		// -20dB
+
+// Longest latency that can be measured, in seconds
+const float MAX_LATENCY = 0.5;
+
+// Time between measurements
+const bigtime_t MEASURE_INTERVAL = 2000000;
+
+// Minimum normalized correlation for a valid result
+const float MIN_CORRELATION = 0.3;
+
+// Sub-sample interpolation: grid points per sample, and sinc half-width
+const int INTERP_STEPS = 32;
+const int INTERP_TAPS = 16;
+
+
+/*
+ *  Latency looper constructor
+ */
+
+LatencyLooper::LatencyLooper(BLooper *target, float sample_rate) : BLooper("QScope Latency", B_LOW_PRIORITY)
+{
+	int i;
+
+	the_target = target;
+	rate = sample_rate;
+	state = LATENCY_OFF;
+
+	// Linear chirp with faded edges, its autocorrelation has a narrow main lobe
+	// without sidelobes far away, so the peak can be interpolated well
+	chirp_frames = int(CHIRP_TIME * rate);
+	chirp = new float[chirp_frames];
+	float f0 = CHIRP_LOW / rate, f1 = CHIRP_HIGH_FACTOR;
+	int fade = int(CHIRP_FADE * rate);
+	for (i=0; i<chirp_frames; i++) {
+		float t = float(i) / chirp_frames;
+		float phase = 2 * M_PI * chirp_frames * (f0 * t + 0.5 * (f1 - f0) * t * t);
+		float w = 1.0;
+		if (i < fade)
+			w = 0.5 - 0.5 * cos(M_PI * i / fade);
+		else if (i >= chirp_frames - fade)
+			w = 0.5 - 0.5 * cos(M_PI * (chirp_frames - 1 - i) / fade);
+		chirp[i] = CHIRP_LEVEL * w * sin(phase);
+	}
+
+	capture_frames = chirp_frames + int(MAX_LATENCY * rate);
+	capture_buf = new int16[capture_frames];
+
+	// Zero-padding gives the linear (not circular) correlation
+	the_fft = new FFT(FFTSizeFor(capture_frames + chirp_frames));
+	int size = the_fft->Size();
+	re = new float[size];
+	im = new float[size];
+	chirp_re = new float[size];
+	chirp_im = new float[size];
+	memcpy(chirp_re, chirp, chirp_frames * sizeof(float));
+	memset(chirp_re + chirp_frames, 0, (size - chirp_frames) * sizeof(float));
+	memset(chirp_im, 0, size * sizeof(float));
+	the_fft->Forward(chirp_re, chirp_im);
+	Run();
+}
+
+
+/*
+ *  Latency looper destructor
+ */
+
+LatencyLooper::~LatencyLooper()
+{
+	delete[] chirp;
+	delete[] capture_buf;
+	delete[] re;
+	delete[] im;
+	delete[] chirp_re;
+	delete[] chirp_im;
+	delete the_fft;
+}
+
+
+/*
+ *  Start/stop periodic measurement (called by window)
+ */
+
+void LatencyLooper::Start(void)
+{
+	start_time = next_time = system_time();
+	atomic_set(&state, LATENCY_ARMED);
+}
+
+void LatencyLooper::Stop(void)
+{
+	atomic_set(&state, LATENCY_OFF);
+}
+
+
+/*
+ *  Mix chirp into DAC buffer (called by DAC thread)
+ */
+
+void LatencyLooper::Play(int16 *buf, int count, bigtime_t time)
+{
+	int32 s = atomic_get(&state);
+	if (s == LATENCY_ARMED && time >= next_time) {
+		play_pos = 0;
+		chirp_time = time;
+		capture_counter = 0;
+		s = atomic_test_and_set(&state, LATENCY_RUNNING, LATENCY_ARMED) == LATENCY_ARMED ? LATENCY_RUNNING : s;
+	}
+	if (s != LATENCY_RUNNING || play_pos >= chirp_frames)
+		return;
+
+	int n = chirp_frames - play_pos;
+	if (n > count)
+		n = count;
+	const float *c = chirp + play_pos;
+	for (int i=0; i<n; i++, buf+=2) {
+		int32 l = buf[0] + int32(c[i]);
+		int32 r = buf[1] + int32(c[i]);
+		buf[0] = l > 32767 ? 32767 : (l < -32768 ? -32768 : l);
+		buf[1] = r > 32767 ? 32767 : (r < -32768 ? -32768 : r);
+	}
+	play_pos += n;
+}
+
+
+/*
+ *  Copy left channel of ADC buffer into capture buffer, from the
+ *  time the chirp starts (called by ADC thread)
+ */
+
+void LatencyLooper::Record(const int16 *buf, int count, bigtime_t time)
+{
+	if (atomic_get(&state) != LATENCY_RUNNING)
+		return;
+
+	int first = 0;
+	if (capture_counter == 0) {
+		first = int(ceil((chirp_time - time) * (rate / 1E6)));
+		if (first >= count)
+			return;
+		if (first < 0)
+			first = 0;
+		capture_offset = (time - chirp_time) + first * (1E6 / rate);
+	}
+
+	int n = capture_frames - capture_counter;
+	if (n > count - first)
+		n = count - first;
+	buf += first * 2;
+	int16 *p = capture_buf + capture_counter;
+	for (int i=0; i<n; i++)
+		p[i] = buf[i * 2];
+	capture_counter += n;
+
+	// Buffer full? Then hand it over to our own thread
+	if (capture_counter == capture_frames && atomic_test_and_set(&state, LATENCY_ANALYSING, LATENCY_RUNNING) == LATENCY_RUNNING)
+		PostMessage(MSG_LATENCY_CAPTURED);
+}
+
+
+/*
+ *  Handle messages
+ */
+
+void LatencyLooper::MessageReceived(BMessage *msg)
+{
+	switch (msg->what) {
+		case MSG_LATENCY_CAPTURED:
+			if (atomic_get(&state) != LATENCY_ANALYSING)
+				break;
+			analyse();
+			next_time = system_time() + MEASURE_INTERVAL;
+			atomic_test_and_set(&state, LATENCY_ARMED, LATENCY_ANALYSING);
+			break;
+
+		default:
+			BLooper::MessageReceived(msg);
+	}
+}
+
+
+/*
+ *  Find delay of chirp in capture and report to target
+ */
+
+void LatencyLooper::analyse(void)
+{
+	int i, size = the_fft->Size();
+	int n = capture_frames;
+
+	// Cross-correlation via cross spectrum
+	for (i=0; i<n; i++)
+		re[i] = capture_buf[i];
+	memset(re + n, 0, (size - n) * sizeof(float));
+	memset(im, 0, size * sizeof(float));
+	the_fft->Forward(re, im);
+	for (i=0; i<size; i++) {
+		float r = re[i] * chirp_re[i] + im[i] * chirp_im[i];
+		float j = im[i] * chirp_re[i] - re[i] * chirp_im[i];
+		re[i] = r;
+		im[i] = j;
+	}
+	the_fft->Inverse(re, im);
+
+	// Highest peak (either polarity) within the lags where the chirp fits completely
+	int max_lag = n - chirp_frames;
+	int peak = 0;
+	for (i=1; i<=max_lag; i++)
+		if (fabs(re[i]) > fabs(re[peak]))
+			peak = i;
+
+	// Normalized correlation tells whether the chirp came back at all
+	double chirp_energy = 0, capture_energy = 0;
+	for (i=0; i<chirp_frames; i++) {
+		chirp_energy += chirp[i] * chirp[i];
+		capture_energy += float(capture_buf[peak + i]) * float(capture_buf[peak + i]);
+	}
+	float correlation = capture_energy > 0 ? fabs(re[peak]) / sqrt(chirp_energy * capture_energy) : 0;
+
+	BMessage reply(MSG_LATENCY_RESULT);
+	reply.AddFloat("correlation", correlation);
+	reply.AddInt64("when", system_time() - start_time);
+	if (correlation >= MIN_CORRELATION && peak > 0 && peak < max_lag) {
+
+		// Sub-sample lag: band-limited interpolation of the correlation on a
+		// fine grid around the peak, then parabolic interpolation on that grid
+		float sign = re[peak] < 0 ? -1 : 1;
+		int best = 0;
+		float y[INTERP_STEPS * 2 + 1];
+		for (i=0; i<=INTERP_STEPS*2; i++) {
+			y[i] = sign * interpolate(peak + float(i - INTERP_STEPS) / INTERP_STEPS, max_lag);
+			if (y[i] > y[best])
+				best = i;
+		}
+		double lag = peak + double(best - INTERP_STEPS) / INTERP_STEPS;
+		if (best > 0 && best < INTERP_STEPS*2) {
+			float denom = y[best-1] - 2 * y[best] + y[best+1];
+			if (denom != 0)
+				lag += 0.5 * (y[best-1] - y[best+1]) / denom / INTERP_STEPS;
+		}
+
+		reply.AddDouble("latency", capture_offset + lag * 1E6 / rate);
+		reply.AddBool("inverted", sign < 0);
+	}
+	the_target->PostMessage(&reply);
+}
+
+
+/*
+ *  Correlation (in re[]) at fractional lag t, by windowed sinc interpolation
+ */
+
+float LatencyLooper::interpolate(float t, int max_lag)
+{
+	int center = int(floor(t));
+	double sum = 0;
+	for (int k=center-INTERP_TAPS+1; k<=center+INTERP_TAPS; k++) {
+		if (k < 0 || k > max_lag)
+			continue;
+		double x = t - k;
+		double s = x == 0 ? 1.0 : sin(M_PI * x) / (M_PI * x);
+		double w = 0.5 + 0.5 * cos(M_PI * x / INTERP_TAPS);
+		sum += re[k] * s * w;
+	}
+	return sum;
+}
@@ -0,0 +1,75 @@
+/*
+ *  Latency.h - Loopback latency measurement
+ *
+ *  Written in 2026 for QScope (original program by Christian Bauer)
+ */
+
+#ifndef __LATENCY_H__
+#define __LATENCY_H__
+
+#include <AppKit.h>
+
+class FFT;
+
+
+// Messages
+const uint32 MSG_LATENCY_CAPTURED = 'lcap';	// Capture buffer full (to LatencyLooper)
+const uint32 MSG_LATENCY_RESULT = 'lres';	// Measurement result (to target)
+
+
+/*
+ *  Plays a short chirp on the DAC every few seconds, records the ADC from
+ *  the time the chirp starts and finds the delay by cross-correlation.
+ *  Times are taken from the stream buffer headers, so the result is the
+ *  delay between the time a sample is stamped as played and the time it
+ *  is stamped as recorded.
+ */
+
+class LatencyLooper : public BLooper {
+public:
+	LatencyLooper(BLooper *target, float sample_rate);
+	virtual ~LatencyLooper();
+	virtual void MessageReceived(BMessage *msg);
+
+	void Start(void);
+	void Stop(void);
+	bool Running(void) {return atomic_get(&state) != LATENCY_OFF;}
+
+	// Called by audio threads
+	void Play(int16 *buf, int count, bigtime_t time);
+	void Record(const int16 *buf, int count, bigtime_t time);
+
+private:
+	enum {	// Measurement states
+		LATENCY_OFF,
+		LATENCY_ARMED,		// Waiting for next_time
+		LATENCY_RUNNING,	// Chirp played, capturing
+		LATENCY_ANALYSING	// Capture complete
+	};
+
+	void analyse(void);
+	float interpolate(float t, int max_lag);
+
+	BLooper *the_target;
+	float rate;
+
+	int32 state;				// Measurement state (LATENCY_...), shared with audio threads
+	bigtime_t next_time;		// Time of next measurement
+	bigtime_t start_time;		// Time of Start()
+
+	float *chirp;				// Stimulus
+	int chirp_frames;
+	int play_pos;				// Next chirp frame to play (DAC thread)
+	bigtime_t chirp_time;		// Time first chirp frame is played
+
+	int16 *capture_buf;			// Captured left channel (ADC thread)
+	int capture_frames;			// Number of frames to capture
+	int capture_counter;		// Number of frames captured so far
+	double capture_offset;		// Time first captured frame was recorded, relative to chirp_time
+
+	FFT *the_fft;				// For cross-correlation
+	float *chirp_re, *chirp_im;	// Spectrum of chirp
+	float *re, *im;
+};
+
+#endif
@@ -12,6 +12,18 @@
 #include "OldBufferStream.h"
 
 
+/* ================
+   Header passed to the stream functions of audio stream subscribers
+   ================ */
+
+typedef struct audio_buffer_header {
+	int32		buffer_number;		/* sequence number of this buffer */
+	int32		subscriber_count;	/* # of subscribers in the stream */
+	bigtime_t	time;				/* time first sample is played/recorded */
+	int32		_reserved_[4];
+} audio_buffer_header;
+
+
 /* ================
    Class definition for BADCStream and BDACStream
    ================ */
@@ -7,28 +7,70 @@
 #include <AppKit.h>
 #include <InterfaceKit.h>
 #include <MediaKit.h>
+#include <StorageKit.h>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
 
 #include "OldAudioStream.h"
 #include "OldSubscriber.h"
 #include "TSliderView.h"
+#include "AutoSetup.h"
+#include "TraceRing.h"
+#include "Biquad.h"
+#include "Replay.h"
+#include "AlignRing.h"
+#include "Latency.h"
+#include "Bode.h"
+#include "Distortion.h"
+#include "StreamSource.h"
+#include "SynthSource.h"
+#include "TraceServer.h"
+#include "SweepAccumulator.h"
+#include "Histogram.h"
+#include "BeamRaster.h"
+#include "ScopeEngine.h"
 
 
 // Constants
 const char APP_SIGNATURE[] = "application/x-vnd.cebix-QScope";
 
-const uint32 MSG_NEW_BUFFER = 'nbuf';
+const uint32 MSG_REFRESH = 'rfsh';
+const uint32 MSG_BLIT = 'blit';
 const uint32 MSG_DAC_STREAM = 'dacs';
 const uint32 MSG_ADC_STREAM = 'adcs';
+const uint32 MSG_DUAL_STREAM = 'duas';
+const uint32 MSG_FILE_STREAM = 'file';
+const uint32 MSG_SYNTH_STREAM = 'synt';
+const uint32 MSG_GEN_WAVE = 'wave';
+const uint32 MSG_GEN_FREQ = 'sfrq';
+const uint32 MSG_GEN_LEVEL = 'glvl';
+const uint32 MSG_GEN_OUTPUT = 'gout';
+const uint32 MSG_REPLAY_FILE = 'rply';
+const uint32 MSG_TRACE_SERVER = 'srvr';
+const uint32 MSG_NEW_VIEW = 'nvew';
 const uint32 MSG_LEFT_CHANNEL = 'left';
 const uint32 MSG_RIGHT_CHANNEL = 'rght';
 const uint32 MSG_STEREO_CHANNELS = 'dual';
-const uint32 MSG_TIME_DIV_100us = '100u';
-const uint32 MSG_TIME_DIV_200us = '200u';
-const uint32 MSG_TIME_DIV_500us = '500u';
-const uint32 MSG_TIME_DIV_1ms = '1ms ';
-const uint32 MSG_TIME_DIV_2ms = '2ms ';
-const uint32 MSG_TIME_DIV_5ms = '5ms ';
-const uint32 MSG_TIME_DIV_10ms = '10ms';
+const uint32 MSG_MATH_CHANNEL = 'math';
+const uint32 MSG_ALL_CHANNELS = 'all ';
+const uint32 MSG_OVERLAY_CHANNELS = 'ovly';
+const uint32 MSG_LATENCY = 'ltcy';
+const uint32 MSG_DISPLAY_LATENCY = 'dltc';
+const uint32 MSG_BODE = 'bode';
+const uint32 MSG_BODE_CLEAR = 'bclr';
+const uint32 MSG_DISTORTION = 'dist';
+const uint32 MSG_DIST_CHANNEL = 'dsch';
+const uint32 MSG_DIST_SIZE = 'dssz';
+const uint32 MSG_DIST_BANDWIDTH = 'dsbw';
+const uint32 MSG_DIST_WEIGHTING = 'dswt';
+const uint32 MSG_MATH_OP = 'mop ';
+const uint32 MSG_MATH_FILTER = 'mflt';
+const uint32 MSG_MATH_CUTOFF = 'mcut';
+const uint32 MSG_ACQUIRE_MODE = 'acqm';
+const uint32 MSG_SWEEP_MODE = 'swmd';
+const uint32 MSG_SWEEP_COUNT = 'swct';
+const uint32 MSG_TIME_DIV = 'tdiv';
 const uint32 MSG_TRIGGER_OFF = 'trof';
 const uint32 MSG_TRIGGER_LEVEL = 'trlv';
 const uint32 MSG_TRIGGER_PEAK= 'trpk';
@@ -37,107 +79,213 @@ const uint32 MSG_TRIGGER_RIGHT = 'trrt';
 const uint32 MSG_SLOPE_POS = 'slp+';
 const uint32 MSG_SLOPE_NEG = 'slp-';
 const uint32 MSG_ILLUMINATION = 'illu';
+const uint32 MSG_BEAM_WIDTH = 'beam';
+const uint32 MSG_CHANNEL_GAIN = 'cgan';
+const uint32 MSG_CHANNEL_OFFSET = 'cofs';
+const uint32 MSG_COUPLING = 'cplg';
+const uint32 MSG_AUTO_SETUP = 'auto';
+
+const bigtime_t REFRESH_PERIOD = 16667;	// Display refresh assumed if the driver can't wait for the retrace (60Hz)
+
+const float BODE_PLOT_LOW = 20.0;		// Frequency response plot: 20Hz..20kHz, logarithmic
+const float BODE_PLOT_HIGH = 20000.0;
+const float BODE_DB_PER_DIV = 6.0;		// Gain, 0dB two divisions below the top
+const int BODE_DB_ZERO = 2;
+const float BODE_DEG_PER_DIV = 45.0;	// Phase, 0 degrees in the middle
+
+const int NUM_GEN_FREQS = 6;	// Generator frequencies, in order of the menu
+const float gen_freq_table[NUM_GEN_FREQS] = {50, 100, 440, 1000, 5000, 10000};
+const int DEFAULT_GEN_FREQ = 3;
+
+const int NUM_GEN_LEVELS = 4;	// Generator levels, in order of the menu
+const float gen_level_table[NUM_GEN_LEVELS] = {1.0, 0.5, 0.1, 0.01};
+const char *gen_level_labels[NUM_GEN_LEVELS] = {"0dB", "-6dB", "-20dB", "-40dB"};
+const int DEFAULT_GEN_LEVEL = 1;
+
+const int NUM_DIST_SIZES = 5;	// Distortion analyzer FFT sizes, in order of the menu
+const int dist_size_table[NUM_DIST_SIZES] = {4096, 8192, 16384, 32768, 65536};
+const char *dist_size_labels[NUM_DIST_SIZES] = {"4096", "8192", "16384", "32768", "65536"};
+const int DEFAULT_DIST_SIZE = 2;
+const char *dist_bandwidth_labels[NUM_DIST_BANDWIDTHS] = {"20Hz-20kHz", "20Hz-80kHz", "Full"};
+const char *dist_weighting_labels[NUM_DIST_WEIGHTINGS] = {"None", "A"};
+const char *dist_channel_labels[2] = {"Left", "Right"};
+
+const char *math_op_labels[NUM_MATH_OPS] = {
+	"Off", "Left+Right", "Left-Right", "Left×Right", "Left", "Right"
+};
+
+const char *math_filter_labels[NUM_MATH_FILTERS] = {
+	"None", "Low pass", "High pass", "Band pass"
+};
+
+const char *acquire_mode_labels[NUM_ACQUIRE_MODES] = {
+	"Peak Detect", "Sample", "High Resolution"
+};
+
+const char *sweep_mode_labels[NUM_SWEEP_MODES] = {
+	"Normal", "Average", "Exponential Average", "Envelope"
+};
+
+const int NUM_SWEEP_COUNTS = 8;	// Powers of two up to MAX_AVERAGE_SWEEPS
+const char *sweep_count_labels[NUM_SWEEP_COUNTS] = {
+	"2", "4", "8", "16", "32", "64", "128", "256"
+};
+const int DEFAULT_SWEEP_COUNT = 3;
+
+const char *beam_width_labels[NUM_BEAM_WIDTHS] = {
+	"1 Pixel", "1.5 Pixels", "2 Pixels", "3 Pixels", "4 Pixels"
+};
+
+const int NUM_GAINS = 7;	// Vertical gain of a channel, at ×1 full scale fills the trace
+const float gain_table[NUM_GAINS] = {
+	1, 2, 5, 10, 20, 50, 100
+};
+const char *gain_labels[NUM_GAINS] = {
+	"×1", "×2", "×5", "×10", "×20", "×50", "×100"
+};
 
-const int SCOPE_WIDTH = 320;	// Scope grid parameters
-const int SCOPE_HEIGHT = 256;
-const int NUM_X_DIVS = 10;
-const int NUM_Y_DIVS = 8;
-const int TICKS_PER_DIV = 5;
+const int NUM_OFFSETS = 9;	// Vertical position of a channel in divisions
+const float offset_table[NUM_OFFSETS] = {
+	4, 3, 2, 1, 0, -1, -2, -3, -4
+};
+const char *offset_labels[NUM_OFFSETS] = {
+	"+4 Div.", "+3 Div.", "+2 Div.", "+1 Div.", "0", "-1 Div.", "-2 Div.", "-3 Div.", "-4 Div."
+};
+const int DEFAULT_OFFSET = 4;
 
-const float SAMPLE_RATE = 44100.0;
+const char *coupling_labels[2] = {
+	"DC", "AC"
+};
 
-enum {	// Subscriber states
-	STATE_HOLD_OFF,
-	STATE_WAIT_FOR_TRIGGER,
-	STATE_RECORD
+enum {	// Display modes, in order of the channel popup
+	DISPLAY_LEFT,
+	DISPLAY_RIGHT,
+	DISPLAY_STEREO,
+	DISPLAY_MATH,
+	DISPLAY_ALL,
+	DISPLAY_OVERLAY
 };
 
-enum {	// Trigger modes
-	TRIGGER_OFF,
-	TRIGGER_LEVEL,
-	TRIGGER_PEAK
+struct display_layout {
+	int num_traces;
+	struct {
+		int channel;
+		int y_offset;
+		int y_height;
+	} trace[NUM_CHANNELS];
 };
 
+const display_layout display_table[] = {
+	{1, {{0, SCOPE_HEIGHT / 2, SCOPE_HEIGHT}}},
+	{1, {{1, SCOPE_HEIGHT / 2, SCOPE_HEIGHT}}},
+	{2, {{0, SCOPE_HEIGHT / 4, SCOPE_HEIGHT / 2}, {1, SCOPE_HEIGHT * 3/4, SCOPE_HEIGHT / 2}}},
+	{1, {{2, SCOPE_HEIGHT / 2, SCOPE_HEIGHT}}},
+	{3, {{0, SCOPE_HEIGHT / 6, SCOPE_HEIGHT / 3}, {1, SCOPE_HEIGHT / 2, SCOPE_HEIGHT / 3}, {2, SCOPE_HEIGHT * 5/6, SCOPE_HEIGHT / 3}}},
+	{2, {{0, SCOPE_HEIGHT / 2, SCOPE_HEIGHT}, {1, SCOPE_HEIGHT / 2, SCOPE_HEIGHT}}}
+};
+
+enum {	// Display latency: intervals between the stages of a sweep on its way to the screen
+	LAT_AUDIO,		// Buffer with the last frame arrived - sweep complete
+	LAT_SWEEP,		// Trigger - sweep complete
+	LAT_QUEUE,		// Sweep complete - drawing started
+	LAT_RENDER,		// Drawing started - drawing done
+	LAT_BLIT,		// Drawing done - on screen
+	LAT_TOTAL,		// Buffer arrived - on screen
+	NUM_LAT_STAGES
+};
+
+const char *lat_stage_names[NUM_LAT_STAGES] = {"audio", "sweep", "queue", "render", "blit", "total"};
+
 const rgb_color fill_color = {216, 216, 216, 0};
 
 
 // Global variables
 uint8 c_black, c_dark_green;	// Scope colors
 uint8 c_beam[16];
+uint8 c_shade[BEAM_LEVELS][256];	// Every color blended with the beam color
+
 
+// One of the two bitmaps of the view
+struct bitmap_page {
+	BBitmap *bitmap;
+	BLocker lock;			// Held while the page is drawn into or blitted
+	int origin;				// Bitmap column shown at the left edge (for roll mode)
+	trace_stamps stamps;	// Sweep on the page (complete == 0: not timed)
+	bigtime_t render_start, render_end;
+	bool timed;				// Latency of the sweep already counted
+};
 
-// QScope audio stream subscriber
-class QScopeSubscriber : public BSubscriber {
+// Double buffered bitmap view: the drawing looper renders into the back page
+// while the window thread blits the front one
+class BitmapView : public BView {
 public:
-	QScopeSubscriber(BLooper *looper);
-	~QScopeSubscriber();
-	void Enter(BAbstractBufferStream *stream);
-	void SetTimePerDiv(float time);
-	void SetTriggerMode(int mode);
-	void SetHoldOff(float time);
+	BitmapView(BRect frame);
+	virtual ~BitmapView();
+	virtual void Draw(BRect update);
+	void Blit(Histogram *latency);
 
-	bool TriggerRightChannel;
-	bool TriggerSlopeNeg;
-	int TriggerLevel;
+	bitmap_page *LockBack(void);
+	bitmap_page *Front(void) {return page + atomic_get(&front);}
+	void Flip(void) {atomic_set(&front, 1 - front);}	// Only by the drawing looper, with the back page unlocked
 
-private:
-	static bool stream_func(void *arg, char *buf, size_t count, void *header);
-	void scope_func(int16 *buf, size_t count);
-
-	BLooper *the_looper;
-	BAbstractBufferStream *the_stream;
-
-	int16 scope_buf[2][SCOPE_WIDTH*4];	// Two buffers containing min/max values for left/right channels
-	int active_buf;			// For double buffering
-
-	int state;				// Current state (STATE_...)
-
-	int scope_counter;				// Number of samples accumulated in scope_buf
-	int record_counter;				// Current sample frame index in input buffer
-	float time_per_div;				// Time per division
-	float next_frame;				// Next sample frame in input buffer
-	float frame_add;				// Added to next_frame for each scope_buf sample
-	int16 old_input;				// Previous input for trigger slope detection
-	int16 left_min, left_max;		// Current minimum/maximum sample elongation
-	int16 right_min, right_max;		// Current minimum/maximum sample elongation
-	int16 left_peak, right_peak;	// Peak levels found during recording
-
-	float hold_off;				// Hold-off time in multiples of the time/div time
-	int hold_off_frames;		// Number of sample frames to hold off
-	int hold_off_counter;		// Counter for remaining number of sample frames to wait
-
-	int trigger_start_frame;	// First sample frame index for trigger
-	int trigger_total_frames;	// Total number of frames waited for trigger
-	int trigger_mode;			// Trigger mode (TRIGGER_...)
-};
+	int32 BlitPending;		// MSG_BLIT posted to the window but not yet received
 
+private:
+	void draw_page(bitmap_page *p, BRect update);
 
-// Bitmap view
-class BitmapView : public BView {
-	BBitmap *the_bitmap;
-public:
-	BitmapView(BRect frame, BBitmap *bitmap) : BView(frame, "bitmap", B_FOLLOW_ALL_SIDES, B_WILL_DRAW), the_bitmap(bitmap) {}
-	virtual void Draw(BRect update) {DrawBitmap(the_bitmap, update, update);}
+	bitmap_page page[2];
+	int32 front;			// Index of the page shown
 };
 
 
 // Looper for drawing the scope
 class DrawLooper : public BLooper {
 public:
-	DrawLooper(BitmapView *view, BBitmap *bitmap);
+	DrawLooper(BitmapView *view, TraceRing *ring);
+	virtual ~DrawLooper();
 	virtual void MessageReceived(BMessage *msg);
 
-	bool Stereo;		// Stereo display
-	bool RightChannel;	// Right/left channel
+	int Display;		// Displayed channels (DISPLAY_...)
+	int32 BeamWidth;	// In 1/256 pixels
+	float Gain[NUM_CHANNELS];	// Vertical gain of each channel
+	float Offset[NUM_CHANNELS];	// Vertical position of each channel in divisions
+	bool Roll;			// Roll mode display
+	Histogram Latency[NUM_LAT_STAGES];	// Display latency of the sweeps drawn (LAT_...)
 
 private:
-	void draw_data(int16 *buf, int y_offset, int y_height);
+	bool draw_trace(void);
+	void draw_data(int16 *buf, const beam_map &m);
+	void set_maps(beam_map *maps);
+	void draw_roll(void);
+	void set_bode(BMessage *msg);
+	void draw_bode(void);
+	void draw_span(int x, int y1, int y2, uint8 color);
+	bool begin_page(void);
+	void end_page(bool flip);
+	static status_t refresh_entry(void *arg);
+	void refresh_func(void);
+
+	TraceRing *the_ring;
+	BeamRaster beam;
+	bool dirty;						// New sweep or columns since the last refresh
+	int32 refresh_pending;			// MSG_REFRESH posted but not yet received
+	thread_id refresh_thread;		// Posts MSG_REFRESH once per display refresh
+	bool refresh_quit;
+	int16 trace_buf[SCOPE_WIDTH*2*NUM_CHANNELS];	// Sweep copied out of the_ring
+	bool rolling;					// Roll display active
+	int32 roll_pos;					// Ring position of next column to roll in
+	int roll_x;						// Bitmap column for next column to roll in
+	int32 roll_count;				// Total columns rolled in (for grid)
+	int16 roll_last[NUM_CHANNELS*2];	// Previous column (max/min for each channel)
+
+	bool bode;						// Frequency response shown instead of traces
+	float bode_gain[SCOPE_WIDTH];	// Gain (dB) and phase (degrees) at each column
+	float bode_phase[SCOPE_WIDTH];
 
 	BitmapView *the_view;
-	BRect the_bounds;
 	BWindow *the_window;
-	BBitmap *the_bitmap;
-	uint8 *bits;
+	bitmap_page *back;				// Page being drawn
+	uint8 *bits;					// Its bits
 	int xmod;
 };
 
@@ -145,7 +293,7 @@ private:
 // Window object
 class QScopeWindow : public BWindow {
 public:
-	QScopeWindow();
+	QScopeWindow(QScopeSubscriber *acquisition = NULL);
 	virtual bool QuitRequested(void);
 	virtual void MessageReceived(BMessage *msg);
 
@@ -153,14 +301,69 @@ private:
 	static void trigger_level_callback(float value, void *arg);
 	static void hold_off_callback(float value, void *arg);
 
+	void auto_setup_done(BMessage *msg);
+	void latency_done(BMessage *msg);
+	void report_display_latency(void);
+	void bode_done(BMessage *msg);
+	void distortion_done(BMessage *msg);
+	void publish_result(const char *name, const char *fields);
+	void set_time_per_div(bigtime_t time);
+	void replay(const char *path, size_t buffer_size, bool fast);
+	void select_source(int source);
+	void update_generator(void);
+	static bool dac_func(void *arg, char *buf, size_t count, void *header);
+	static bool adc_func(void *arg, char *buf, size_t count, void *header);
+	static bool synth_func(void *arg, char *buf, size_t count, void *header);
+	BMenu *make_radio_menu(const char *name, uint32 what, const char *field, const char **labels, int num, int marked);
+
 	BitmapView *main_view;
-	BBitmap *the_bitmap;
 
+	int32 math_op, math_filter, math_cutoff;	// Math channel settings (MATH_..., MATH_FILTER_..., index)
+	int32 acquire_mode;				// Acquisition mode (ACQUIRE_...)
+	int32 sweep_mode, sweep_count;	// Averaging settings (SWEEP_..., index)
+	int32 beam_width;				// Index
+	int32 channel_gain[NUM_CHANNELS], channel_offset[NUM_CHANNELS];	// Vertical settings (index)
+	int32 coupling[2];				// Input coupling (0 = DC, 1 = AC)
+
+	BPopUpMenu *stream_popup;
+	BPopUpMenu *time_div_popup;
+	BPopUpMenu *trigger_channel_popup;
+	BPopUpMenu *trigger_mode_popup;
+	BPopUpMenu *slope_popup;
+	TSliderView *level_slider;
+
+	TraceRing *the_ring;
 	DrawLooper *the_looper;
+	AutoSetupLooper *auto_looper;
+	LatencyLooper *latency_looper;
+	BMenuItem *latency_item;
+	BodeLooper *bode_looper;
+	BMenuItem *bode_item;
+	bool bode_shown;		// Frequency response plot in place of the traces
+	DistortionLooper *distortion_looper;
+	BMenuItem *distortion_item;
+	int32 dist_channel, dist_size, dist_bandwidth, dist_weighting;	// Analyzer settings (index, index, DIST_BW_..., DIST_WEIGHT_...)
+	BMenuItem *gen_output_item;
+	BMenu *gen_wave_menu[2];
+	TraceServer *trace_server;	// Publishes traces and results (--server), or NULL
 
 	BDACStream *dac_stream;
 	BADCStream *adc_stream;
-	QScopeSubscriber *the_subscriber;
+	QScopeSubscriber *the_subscriber;	// Shared with the view windows
+	ScopeView *the_view;
+	bool main_window;		// Owns streams, sources and measurements; other windows only show views
+	StreamSource *dac_source;	// Attached for the lifetime of the window
+	StreamSource *adc_source;
+	SynthSource *synth_source;
+	SignalGenerator *dac_generator;	// Mixed into the DAC stream while gen_output is set
+	int32 gen_output;
+
+	ReplayFile *replay_file;	// Capture replayed instead of stream
+	BFilePanel *file_panel;
+
+	int32 gen_wave[2];		// Generator settings per channel (WAVE_..., index, index)
+	int32 gen_freq[2];
+	int32 gen_level[2];
 
 	friend class TSliderView;
 
@@ -171,9 +374,18 @@ private:
 // Application object
 class QScope : public BApplication {
 public:
-	QScope() : BApplication(APP_SIGNATURE) {}
-	virtual void ReadyToRun(void) {new QScopeWindow;}
+	QScope();
+	virtual void ArgvReceived(int32 argc, char **argv);
+	virtual void ReadyToRun(void);
 	virtual void AboutRequested(void);
+
+private:
+	const char *replay_path;	// Capture to replay on startup (--replay)
+	size_t buffer_size;			// Bytes per replay buffer (--buffer, in frames)
+	bool replay_fast;			// Replay as fast as possible (--fast)
+	int synth_wave;				// Start with generator (--synth, -1 = no)
+	int synth_period;			// Frames per generator callback (--period)
+	const char *server_address;	// Publish traces on this socket (--server)
 };
 
 
@@ -190,6 +402,82 @@ int main(int argc, char **argv)
 }
 
 
+/*
+ *  Application constructor
+ */
+
+QScope::QScope() : BApplication(APP_SIGNATURE)
+{
+	replay_path = NULL;
+	buffer_size = REPLAY_BUFFER_SIZE;
+	replay_fast = false;
+	synth_wave = -1;
+	synth_period = SYNTH_PERIOD;
+	server_address = NULL;
+}
+
+
+/*
+ *  Parse command line
+ *    --replay file   Replay WAV/raw capture instead of the DAC stream
+ *    --buffer n      Replay in buffers of n frames
+ *    --fast          Replay as fast as possible instead of in real time
+ *    --synth wave    Start with test signal generator (sine, square, triangle, sweep, multitone, noise, burst)
+ *    --period n      Generator delivers buffers of n frames
+ *    --server address   Publish traces and results on a Unix-domain socket ("/path") or TCP port on 127.0.0.1
+ */
+
+void QScope::ArgvReceived(int32 argc, char **argv)
+{
+	for (int i=1; i<argc; i++) {
+		if (strcmp(argv[i], "--replay") == 0 && i+1 < argc)
+			replay_path = argv[++i];
+		else if (strcmp(argv[i], "--buffer") == 0 && i+1 < argc)
+			buffer_size = atoi(argv[++i]) * 4;
+		else if (strcmp(argv[i], "--fast") == 0)
+			replay_fast = true;
+		else if (strcmp(argv[i], "--synth") == 0 && i+1 < argc) {
+			i++;
+			for (int w=0; w<NUM_WAVES; w++)
+				if (strcasecmp(argv[i], SignalGenerator::WaveName(w)) == 0)
+					synth_wave = w;
+		} else if (strcmp(argv[i], "--period") == 0 && i+1 < argc)
+			synth_period = atoi(argv[++i]);
+		else if (strcmp(argv[i], "--server") == 0 && i+1 < argc)
+			server_address = argv[++i];
+		else
+			fprintf(stderr, "Usage: %s [--replay file | --synth wave] [--buffer frames] [--fast] [--period frames] [--server address]\n", argv[0]);
+	}
+}
+
+
+/*
+ *  Open window
+ */
+
+void QScope::ReadyToRun(void)
+{
+	QScopeWindow *win = new QScopeWindow;
+	if (server_address != NULL) {
+		BMessage msg(MSG_TRACE_SERVER);
+		msg.AddString("address", server_address);
+		win->PostMessage(&msg);
+	}
+	if (replay_path != NULL) {
+		BMessage msg(MSG_REPLAY_FILE);
+		msg.AddString("path", replay_path);
+		msg.AddInt32("buffer_size", buffer_size);
+		msg.AddBool("fast", replay_fast);
+		win->PostMessage(&msg);
+	} else if (synth_wave >= 0) {
+		BMessage msg(MSG_SYNTH_STREAM);
+		msg.AddInt32("wave", synth_wave);
+		msg.AddInt32("period", synth_period);
+		win->PostMessage(&msg);
+	}
+}
+
+
 /*
  *  About requested
  */
@@ -209,11 +497,18 @@ void QScope::AboutRequested(void)
  *  Window constructor
  */
 
-QScopeWindow::QScopeWindow() : BWindow(BRect(0, 0, SCOPE_WIDTH+200-1, SCOPE_HEIGHT-1), "QScope", B_TITLED_WINDOW, B_NOT_RESIZABLE)
+QScopeWindow::QScopeWindow(QScopeSubscriber *acquisition) : BWindow(BRect(0, 0, SCOPE_WIDTH+200-1, SCOPE_HEIGHT-1), acquisition == NULL ? "QScope" : "QScope View", B_TITLED_WINDOW, B_NOT_RESIZABLE)
 {
-	// Move window to right position
+	// Move window to right position, view windows cascade from the main window
+	static int num_view_windows = 0;
+	main_window = acquisition == NULL;
 	Lock();
-	MoveTo(80, 60);
+	if (main_window)
+		MoveTo(80, 60);
+	else {
+		num_view_windows = num_view_windows % 8 + 1;
+		MoveTo(80 + num_view_windows * 24, 60 + num_view_windows * 24);
+	}
 	BRect b = Bounds();
 
 	// Look up colors for scope
@@ -224,18 +519,139 @@ QScopeWindow::QScopeWindow() : BWindow(BRect(0, 0, SCOPE_WIDTH+200-1, SCOPE_HEIG
 		c_dark_green = scr.IndexForColor(0, 32, 16);
 		for (int i=0; i<16; i++)
 			c_beam[i] = scr.IndexForColor(0, 255 - i * 8, 128 - i * 4);
+
+		// Beam over each color of the palette at each level
+		for (int c=0; c<256; c++) {
+			rgb_color bg = scr.ColorForIndex(c);
+			for (int l=0; l<BEAM_LEVELS; l++) {
+				int a = l * 256 / (BEAM_LEVELS - 1);
+				c_shade[l][c] = l == 0 ? c : scr.IndexForColor(bg.red + ((0 - bg.red) * a >> 8), bg.green + ((255 - bg.green) * a >> 8), bg.blue + ((128 - bg.blue) * a >> 8));
+			}
+		}
+	}
+
+	// Menu bar, window grows by its height
+	math_op = MATH_OFF;
+	math_filter = MATH_FILTER_NONE;
+	math_cutoff = DEFAULT_MATH_CUTOFF;
+	acquire_mode = ACQUIRE_PEAK;
+	sweep_mode = SWEEP_NORMAL;
+	sweep_count = DEFAULT_SWEEP_COUNT;
+	beam_width = DEFAULT_BEAM_WIDTH;
+	for (int c=0; c<NUM_CHANNELS; c++) {
+		channel_gain[c] = 0;
+		channel_offset[c] = DEFAULT_OFFSET;
+	}
+	coupling[0] = coupling[1] = 0;
+	for (int c=0; c<2; c++) {
+		gen_wave[c] = WAVE_SINE;
+		gen_freq[c] = DEFAULT_GEN_FREQ;
+		gen_level[c] = DEFAULT_GEN_LEVEL;
+	}
+	gen_output = false;
+	dist_channel = 0;
+	dist_size = DEFAULT_DIST_SIZE;
+	dist_bandwidth = DIST_BW_20K;
+	dist_weighting = DIST_WEIGHT_NONE;
+	{
+		BMenuBar *bar = new BMenuBar(BRect(0, 0, b.right, 0), "menu bar");
+		BMenu *menu = new BMenu("Math");
+		menu->AddItem(make_radio_menu("Function", MSG_MATH_OP, "op", math_op_labels, NUM_MATH_OPS, math_op));
+		menu->AddItem(make_radio_menu("Filter", MSG_MATH_FILTER, "filter", math_filter_labels, NUM_MATH_FILTERS, math_filter));
+		const char *cutoff_labels[NUM_MATH_CUTOFFS];
+		char cutoff_text[NUM_MATH_CUTOFFS][16];
+		for (int i=0; i<NUM_MATH_CUTOFFS; i++) {
+			if (math_cutoff_table[i] >= 1000)
+				sprintf(cutoff_text[i], "%gkHz", math_cutoff_table[i] / 1000);
+			else
+				sprintf(cutoff_text[i], "%gHz", math_cutoff_table[i]);
+			cutoff_labels[i] = cutoff_text[i];
+		}
+		menu->AddItem(make_radio_menu("Cutoff", MSG_MATH_CUTOFF, "index", cutoff_labels, NUM_MATH_CUTOFFS, math_cutoff));
+		bar->AddItem(menu);
+		menu = new BMenu("Acquire");
+		menu->AddItem(make_radio_menu("Mode", MSG_ACQUIRE_MODE, "mode", acquire_mode_labels, NUM_ACQUIRE_MODES, acquire_mode));
+		menu->AddItem(make_radio_menu("Sweeps", MSG_SWEEP_MODE, "mode", sweep_mode_labels, NUM_SWEEP_MODES, sweep_mode));
+		menu->AddItem(make_radio_menu("Count", MSG_SWEEP_COUNT, "index", sweep_count_labels, NUM_SWEEP_COUNTS, sweep_count));
+		bar->AddItem(menu);
+		menu = new BMenu("Display");
+		static const char *display_channel_names[NUM_CHANNELS] = {"Left", "Right", "Math"};
+		for (int c=0; c<NUM_CHANNELS; c++) {
+			BMenu *sub = new BMenu(display_channel_names[c]);
+			sub->AddItem(make_radio_menu("Gain", MSG_CHANNEL_GAIN, "index", gain_labels, NUM_GAINS, channel_gain[c]));
+			sub->AddItem(make_radio_menu("Offset", MSG_CHANNEL_OFFSET, "index", offset_labels, NUM_OFFSETS, channel_offset[c]));
+			if (c < 2)
+				sub->AddItem(make_radio_menu("Coupling", MSG_COUPLING, "index", coupling_labels, 2, coupling[c]));
+			for (int m=0; m<sub->CountItems(); m++) {
+				BMenu *radio = sub->SubmenuAt(m);
+				for (int i=0; i<radio->CountItems(); i++)
+					radio->ItemAt(i)->Message()->AddInt32("channel", c);
+			}
+			menu->AddItem(sub);
+		}
+		menu->AddSeparatorItem();
+		menu->AddItem(make_radio_menu("Beam Width", MSG_BEAM_WIDTH, "index", beam_width_labels, NUM_BEAM_WIDTHS, beam_width));
+		bar->AddItem(menu);
+		if (main_window) {
+			menu = new BMenu("Generator");
+			const char *wave_labels[NUM_WAVES];
+			for (int i=0; i<NUM_WAVES; i++)
+				wave_labels[i] = SignalGenerator::WaveName(i);
+			const char *freq_labels[NUM_GEN_FREQS];
+			char freq_text[NUM_GEN_FREQS][16];
+			for (int i=0; i<NUM_GEN_FREQS; i++) {
+				if (gen_freq_table[i] >= 1000)
+					sprintf(freq_text[i], "%gkHz", gen_freq_table[i] / 1000);
+				else
+					sprintf(freq_text[i], "%gHz", gen_freq_table[i]);
+				freq_labels[i] = freq_text[i];
+			}
+			static const char *channel_names[2] = {"Left", "Right"};
+			for (int c=0; c<2; c++) {
+				BMenu *sub = new BMenu(channel_names[c]);
+				sub->AddItem(gen_wave_menu[c] = make_radio_menu("Waveform", MSG_GEN_WAVE, "index", wave_labels, NUM_WAVES, gen_wave[c]));
+				sub->AddItem(make_radio_menu("Frequency", MSG_GEN_FREQ, "index", freq_labels, NUM_GEN_FREQS, gen_freq[c]));
+				sub->AddItem(make_radio_menu("Level", MSG_GEN_LEVEL, "index", gen_level_labels, NUM_GEN_LEVELS, gen_level[c]));
+				for (int m=0; m<sub->CountItems(); m++) {
+					BMenu *radio = sub->SubmenuAt(m);
+					for (int i=0; i<radio->CountItems(); i++)
+						radio->ItemAt(i)->Message()->AddInt32("channel", c);
+				}
+				menu->AddItem(sub);
+			}
+			menu->AddSeparatorItem();
+			menu->AddItem(gen_output_item = new BMenuItem("Output to DAC", new BMessage(MSG_GEN_OUTPUT)));
+			bar->AddItem(menu);
+			menu = new BMenu("Measure");
+			menu->AddItem(latency_item = new BMenuItem("Loopback Latency", new BMessage(MSG_LATENCY)));
+			menu->AddItem(new BMenuItem("Display Latency", new BMessage(MSG_DISPLAY_LATENCY)));
+			menu->AddItem(bode_item = new BMenuItem("Frequency Response", new BMessage(MSG_BODE)));
+			menu->AddItem(distortion_item = new BMenuItem("Distortion", new BMessage(MSG_DISTORTION)));
+			BMenu *sub = new BMenu("Distortion Setup");
+			sub->AddItem(make_radio_menu("Channel", MSG_DIST_CHANNEL, "index", dist_channel_labels, 2, dist_channel));
+			sub->AddItem(make_radio_menu("FFT Size", MSG_DIST_SIZE, "index", dist_size_labels, NUM_DIST_SIZES, dist_size));
+			sub->AddItem(make_radio_menu("Bandwidth", MSG_DIST_BANDWIDTH, "index", dist_bandwidth_labels, NUM_DIST_BANDWIDTHS, dist_bandwidth));
+			sub->AddItem(make_radio_menu("Weighting", MSG_DIST_WEIGHTING, "index", dist_weighting_labels, NUM_DIST_WEIGHTINGS, dist_weighting));
+			menu->AddItem(sub);
+			bar->AddItem(menu);
+			menu = new BMenu("Window");
+			menu->AddItem(new BMenuItem("New View", new BMessage(MSG_NEW_VIEW)));
+			bar->AddItem(menu);
+		}
+		AddChild(bar);
+		float bar_height = bar->Bounds().Height() + 1;
+		ResizeTo(b.right, b.bottom + bar_height);
+		b.top = bar_height;
+		b.bottom += bar_height;
 	}
 
 	// Light gray background
-	BView *top = new BView(BRect(0, 0, b.right, b.bottom), "top", B_FOLLOW_NONE, B_WILL_DRAW);
+	BView *top = new BView(BRect(0, b.top, b.right, b.bottom), "top", B_FOLLOW_NONE, B_WILL_DRAW);
 	AddChild(top);
 	top->SetViewColor(fill_color);
 
-	// Allocate bitmap
-	the_bitmap = new BBitmap(BRect(0, 0, SCOPE_WIDTH-1, SCOPE_HEIGHT-1), B_COLOR_8_BIT);
-
 	// Create bitmap view
-	main_view = new BitmapView(BRect(0, 0, SCOPE_WIDTH-1, SCOPE_HEIGHT-1), the_bitmap);
+	main_view = new BitmapView(BRect(0, 0, SCOPE_WIDTH-1, SCOPE_HEIGHT-1));
 	top->AddChild(main_view);
 
 	// Create interface elements
@@ -244,18 +660,30 @@ QScopeWindow::QScopeWindow() : BWindow(BRect(0, 0, SCOPE_WIDTH+200-1, SCOPE_HEIG
 		top->AddChild(box);
 		box->SetLabel("Input");
 
-		BPopUpMenu *popup = new BPopUpMenu("stream popup", true, true);
-		popup->AddItem(new BMenuItem("DAC", new BMessage(MSG_DAC_STREAM)));
-		popup->AddItem(new BMenuItem("ADC", new BMessage(MSG_ADC_STREAM)));
-		popup->SetTargetForItems(this);
-		popup->ItemAt(0)->SetMarked(true);
-		BMenuField *menu_field = new BMenuField(BRect(4, 14, 188, 34), "stream", "Stream", popup);
-		box->AddChild(menu_field);
+		BPopUpMenu *popup;
+		BMenuField *menu_field;
+		stream_popup = NULL;
+		if (main_window) {	// Input is selected in the main window for all views
+			popup = new BPopUpMenu("stream popup", true, true);
+			popup->AddItem(new BMenuItem("DAC", new BMessage(MSG_DAC_STREAM)));
+			popup->AddItem(new BMenuItem("ADC", new BMessage(MSG_ADC_STREAM)));
+			popup->AddItem(new BMenuItem("DAC+ADC", new BMessage(MSG_DUAL_STREAM)));
+			popup->AddItem(new BMenuItem("File" B_UTF8_ELLIPSIS, new BMessage(MSG_FILE_STREAM)));
+			popup->AddItem(new BMenuItem("Generator", new BMessage(MSG_SYNTH_STREAM)));
+			popup->SetTargetForItems(this);
+			popup->ItemAt(0)->SetMarked(true);
+			stream_popup = popup;
+			menu_field = new BMenuField(BRect(4, 14, 188, 34), "stream", "Stream", popup);
+			box->AddChild(menu_field);
+		}
 
 		popup = new BPopUpMenu("channel popup", true, true);
 		popup->AddItem(new BMenuItem("Left", new BMessage(MSG_LEFT_CHANNEL)));
 		popup->AddItem(new BMenuItem("Right", new BMessage(MSG_RIGHT_CHANNEL)));
 		popup->AddItem(new BMenuItem("Stereo", new BMessage(MSG_STEREO_CHANNELS)));
+		popup->AddItem(new BMenuItem("Math", new BMessage(MSG_MATH_CHANNEL)));
+		popup->AddItem(new BMenuItem("All", new BMessage(MSG_ALL_CHANNELS)));
+		popup->AddItem(new BMenuItem("Overlay", new BMessage(MSG_OVERLAY_CHANNELS)));
 		popup->SetTargetForItems(this);
 		popup->ItemAt(0)->SetMarked(true);
 		menu_field = new BMenuField(BRect(4, 34, 188, 54), "channel", "Channel", popup);
@@ -268,15 +696,14 @@ QScopeWindow::QScopeWindow() : BWindow(BRect(0, 0, SCOPE_WIDTH+200-1, SCOPE_HEIG
 		box->SetLabel("Time");
 
 		BPopUpMenu *popup = new BPopUpMenu("time/div popup", true, true);
-		popup->AddItem(new BMenuItem("0.1ms", new BMessage(MSG_TIME_DIV_100us)));
-		popup->AddItem(new BMenuItem("0.2ms", new BMessage(MSG_TIME_DIV_200us)));
-		popup->AddItem(new BMenuItem("0.5ms", new BMessage(MSG_TIME_DIV_500us)));
-		popup->AddItem(new BMenuItem("1ms", new BMessage(MSG_TIME_DIV_1ms)));
-		popup->AddItem(new BMenuItem("2ms", new BMessage(MSG_TIME_DIV_2ms)));
-		popup->AddItem(new BMenuItem("5ms", new BMessage(MSG_TIME_DIV_5ms)));
-		popup->AddItem(new BMenuItem("10ms", new BMessage(MSG_TIME_DIV_10ms)));
+		for (int i=0; i<NUM_TIME_DIVS; i++) {
+			BMessage *msg = new BMessage(MSG_TIME_DIV);
+			msg->AddInt32("index", i);
+			popup->AddItem(new BMenuItem(time_div_table[i].label, msg));
+		}
 		popup->SetTargetForItems(this);
-		popup->ItemAt(4)->SetMarked(true);
+		popup->ItemAt(DEFAULT_TIME_DIV)->SetMarked(true);
+		time_div_popup = popup;
 		BMenuField *menu_field = new BMenuField(BRect(4, 14, 188, 34), "time/div", "Time/Div.", popup);
 		box->AddChild(menu_field);
 	}
@@ -291,6 +718,7 @@ QScopeWindow::QScopeWindow() : BWindow(BRect(0, 0, SCOPE_WIDTH+200-1, SCOPE_HEIG
 		popup->AddItem(new BMenuItem("Right", new BMessage(MSG_TRIGGER_RIGHT)));
 		popup->SetTargetForItems(this);
 		popup->ItemAt(0)->SetMarked(true);
+		trigger_channel_popup = popup;
 		BMenuField *menu_field = new BMenuField(BRect(4, 14, 188, 34), "trigger_channel", "Channel", popup);
 		box->AddChild(menu_field);
 
@@ -300,6 +728,7 @@ QScopeWindow::QScopeWindow() : BWindow(BRect(0, 0, SCOPE_WIDTH+200-1, SCOPE_HEIG
 		popup->AddItem(new BMenuItem("Peak", new BMessage(MSG_TRIGGER_PEAK)));
 		popup->SetTargetForItems(this);
 		popup->ItemAt(1)->SetMarked(true);
+		trigger_mode_popup = popup;
 		menu_field = new BMenuField(BRect(4, 34, 188, 54), "trigger_mode", "Trigger Mode", popup);
 		box->AddChild(menu_field);
 
@@ -307,12 +736,14 @@ QScopeWindow::QScopeWindow() : BWindow(BRect(0, 0, SCOPE_WIDTH+200-1, SCOPE_HEIG
 		box->AddChild(label);
 		TSliderView *the_slider = new TSliderView(BRect(98, 58, 188, 76), "level", 0.5, trigger_level_callback, this);
 		box->AddChild(the_slider);
+		level_slider = the_slider;
 
 		popup = new BPopUpMenu("slope popup", true, true);
 		popup->AddItem(new BMenuItem("pos", new BMessage(MSG_SLOPE_POS)));
 		popup->AddItem(new BMenuItem("neg", new BMessage(MSG_SLOPE_NEG)));
 		popup->SetTargetForItems(this);
 		popup->ItemAt(0)->SetMarked(true);
+		slope_popup = popup;
 		menu_field = new BMenuField(BRect(4, 76, 188, 96), "slope", "Slope", popup);
 		box->AddChild(menu_field);
 
@@ -322,20 +753,61 @@ QScopeWindow::QScopeWindow() : BWindow(BRect(0, 0, SCOPE_WIDTH+200-1, SCOPE_HEIG
 		box->AddChild(the_slider);
 	}
 
-	BCheckBox *check_box = new BCheckBox(BRect(SCOPE_WIDTH + 10, 234, SCOPE_WIDTH + 190, 254), "illumination", "Illumination", new BMessage(MSG_ILLUMINATION));
+	BCheckBox *check_box = new BCheckBox(BRect(SCOPE_WIDTH + 10, 234, SCOPE_WIDTH + 110, 254), "illumination", "Illumination", new BMessage(MSG_ILLUMINATION));
 	top->AddChild(check_box);
+
+	if (main_window) {	// Auto setup analyses the acquisition and sets up the main view
+		BButton *button = new BButton(BRect(SCOPE_WIDTH + 120, 230, SCOPE_WIDTH + 196, 254), "auto", "Auto", new BMessage(MSG_AUTO_SETUP));
+		top->AddChild(button);
+	}
 	Unlock();
 
-	// Create drawing looper
-	the_looper = new DrawLooper(main_view, the_bitmap);
+	// Create drawing looper and the view feeding it
+	the_ring = new TraceRing(SCOPE_WIDTH, NUM_CHANNELS);
+	the_looper = new DrawLooper(main_view, the_ring);
+	the_view = new ScopeView(the_looper, the_ring);
+
+	// Started by MSG_TRACE_SERVER
+	trace_server = NULL;
+
+	// View windows only add a view to the acquisition of the main window
+	if (!main_window) {
+		the_subscriber = acquisition;
+		the_subscriber->Acquire();
+		if (!the_subscriber->AddView(the_view))
+			SetTitle("QScope View - Too Many Views");
+		Show();
+		return;
+	}
+
+	// Create looper for signal analysis
+	auto_looper = new AutoSetupLooper(this, SAMPLE_RATE);
+	latency_looper = new LatencyLooper(this, SAMPLE_RATE);
+	bode_looper = new BodeLooper(this, SAMPLE_RATE);
+	bode_shown = false;
+	distortion_looper = new DistortionLooper(this, SAMPLE_RATE);
+	distortion_looper->Setup(dist_size_table[dist_size], dist_bandwidth, dist_weighting);
 
 	// Create stream objects
 	dac_stream = new BDACStream();
 	adc_stream = new BADCStream();
 
-	// Create subscriber and attach it to the stream
-	the_subscriber = new QScopeSubscriber(the_looper);
-	the_subscriber->Enter(dac_stream);
+	// Create engine and attach it to both streams once, so switching between them never waits for a stream
+	the_subscriber = new QScopeSubscriber(auto_looper, distortion_looper);
+	the_subscriber->AddView(the_view);
+	dac_source = new StreamSource(dac_stream);
+	dac_source->Start(dac_func, this);
+	adc_source = new StreamSource(adc_stream);
+	adc_source->Start(adc_func, this);
+
+	// Test signal generator, only running while selected, and the same signal for the DAC
+	synth_source = new SynthSource(SAMPLE_RATE, SYNTH_PERIOD);
+	dac_generator = new SignalGenerator(SAMPLE_RATE, 2);
+	update_generator();
+
+	// For captures from disk
+	replay_file = new ReplayFile;
+	file_panel = new BFilePanel(B_OPEN_PANEL, new BMessenger(this), NULL, B_FILE_NODE, false);
 
 	// Show the window
 	Show();
@@ -348,22 +820,49 @@ QScopeWindow::QScopeWindow() : BWindow(BRect(0, 0, SCOPE_WIDTH+200-1, SCOPE_HEIG
 
 bool QScopeWindow::QuitRequested(void)
 {
-	// Delete subscriber
-	delete the_subscriber;
+	if (main_window) {
+
+		// Stop replay
+		delete replay_file;
+		delete file_panel;
+
+		// Delete sources
+		delete dac_source;
+		delete adc_source;
+		delete synth_source;
+		delete dac_generator;
+		delete trace_server;
+
+		// Delete stream objects
+		delete dac_stream;
+		delete adc_stream;
+	}
 
-	// Delete stream objects
-	delete dac_stream;
-	delete adc_stream;
+	// Detach view, the last window deletes the engine
+	the_subscriber->RemoveView(the_view);
+	delete the_view;
+	the_subscriber->Release();
 
-	// Delete looper
+	// Delete loopers
 	the_looper->Lock();
 	the_looper->Quit();
+	if (main_window) {
+		auto_looper->Lock();
+		auto_looper->Quit();
+		latency_looper->Lock();
+		latency_looper->Quit();
+		bode_looper->Lock();
+		bode_looper->Quit();
+		distortion_looper->Lock();
+		distortion_looper->Quit();
+	}
 
-	// Delete the bitmap
-	delete the_bitmap;
+	// Delete the ring (the bitmaps go with the view)
+	delete the_ring;
 
-	// Quit program
-	be_app->PostMessage(B_QUIT_REQUESTED);
+	// Closing the main window quits the program
+	if (main_window)
+		be_app->PostMessage(B_QUIT_REQUESTED);
 	return TRUE;
 }
 
@@ -375,39 +874,164 @@ bool QScopeWindow::QuitRequested(void)
 void QScopeWindow::MessageReceived(BMessage *msg)
 {
 	switch (msg->what) {
-		case MSG_DAC_STREAM: the_subscriber->Enter(dac_stream); break;
-		case MSG_ADC_STREAM: the_subscriber->Enter(adc_stream); break;
+		case MSG_DAC_STREAM: select_source(SOURCE_DAC); break;
+		case MSG_ADC_STREAM: select_source(SOURCE_ADC); break;
+		case MSG_DUAL_STREAM: select_source(SOURCE_DUAL); break;
+
+		case MSG_SYNTH_STREAM: {	// From popup or command line
+			int32 i;
+			if (msg->FindInt32("wave", &i) == B_NO_ERROR) {
+				for (int c=0; c<2; c++) {
+					gen_wave[c] = i;
+					gen_wave_menu[c]->ItemAt(i)->SetMarked(true);
+				}
+				update_generator();
+			}
+			if (msg->FindInt32("period", &i) == B_NO_ERROR)
+				synth_source->SetPeriod(i);
+			select_source(SOURCE_SYNTH);
+			synth_source->Start(synth_func, this);
+			stream_popup->ItemAt(SOURCE_SYNTH)->SetMarked(true);
+			break;
+		}
 
-		case MSG_LEFT_CHANNEL:
-			the_looper->RightChannel = false;
-			the_looper->Stereo = false;
+		case MSG_GEN_WAVE:
+		case MSG_GEN_FREQ:
+		case MSG_GEN_LEVEL: {	// Takes effect with the next buffer
+			int32 c, i;
+			if (msg->FindInt32("channel", &c) != B_NO_ERROR || msg->FindInt32("index", &i) != B_NO_ERROR)
+				break;
+			if (msg->what == MSG_GEN_WAVE)
+				gen_wave[c] = i;
+			else if (msg->what == MSG_GEN_FREQ)
+				gen_freq[c] = i;
+			else
+				gen_level[c] = i;
+			update_generator();
 			break;
-		case MSG_RIGHT_CHANNEL:
-			the_looper->RightChannel = true;
-			the_looper->Stereo = false;
+		}
+
+		case MSG_GEN_OUTPUT:
+			atomic_set(&gen_output, !atomic_get(&gen_output));
+			gen_output_item->SetMarked(atomic_get(&gen_output));
 			break;
-		case MSG_STEREO_CHANNELS:
-			the_looper->RightChannel = false;
-			the_looper->Stereo = true;
+
+		case MSG_FILE_STREAM:
+			file_panel->Show();
 			break;
 
-		case MSG_TIME_DIV_100us: the_subscriber->SetTimePerDiv(0.1E-3); break;
-		case MSG_TIME_DIV_200us: the_subscriber->SetTimePerDiv(0.2E-3); break;
-		case MSG_TIME_DIV_500us: the_subscriber->SetTimePerDiv(0.5E-3); break;
-		case MSG_TIME_DIV_1ms: the_subscriber->SetTimePerDiv(1E-3); break;
-		case MSG_TIME_DIV_2ms: the_subscriber->SetTimePerDiv(2E-3); break;
-		case MSG_TIME_DIV_5ms: the_subscriber->SetTimePerDiv(5E-3); break;
-		case MSG_TIME_DIV_10ms: the_subscriber->SetTimePerDiv(10E-3); break;
+		case B_REFS_RECEIVED:
+		case B_SIMPLE_DATA: {	// From file panel or dropped on window
+			entry_ref ref;
+			if (msg->FindRef("refs", &ref) == B_NO_ERROR) {
+				BPath path(&ref);
+				replay(path.Path(), REPLAY_BUFFER_SIZE, false);
+			}
+			break;
+		}
 
-		case MSG_TRIGGER_OFF: the_subscriber->SetTriggerMode(TRIGGER_OFF); break;
-		case MSG_TRIGGER_LEVEL: the_subscriber->SetTriggerMode(TRIGGER_LEVEL); break;
-		case MSG_TRIGGER_PEAK: the_subscriber->SetTriggerMode(TRIGGER_PEAK); break;
+		case MSG_REPLAY_FILE: {	// From command line
+			const char *path;
+			int32 buffer_size;
+			bool fast;
+			if (msg->FindString("path", &path) == B_NO_ERROR && msg->FindInt32("buffer_size", &buffer_size) == B_NO_ERROR && msg->FindBool("fast", &fast) == B_NO_ERROR)
+				replay(path, buffer_size, fast);
+			break;
+		}
 
-		case MSG_TRIGGER_LEFT: the_subscriber->TriggerRightChannel = false; break;
-		case MSG_TRIGGER_RIGHT: the_subscriber->TriggerRightChannel = true; break;
+		case MSG_TRACE_SERVER: {	// From command line
+			const char *address;
+			if (msg->FindString("address", &address) == B_NO_ERROR) {
+				if (trace_server == NULL)
+					trace_server = new TraceServer(the_ring, SCOPE_WIDTH, NUM_CHANNELS);
+				if (trace_server->Start(address) != B_NO_ERROR)
+					fprintf(stderr, "Can't publish traces on %s\n", address);
+			}
+			break;
+		}
+
+		case MSG_NEW_VIEW:
+			new QScopeWindow(the_subscriber);
+			break;
+
+		case MSG_BLIT:	// Drawing looper flipped the pages
+			atomic_set(&main_view->BlitPending, 0);
+			main_view->Blit(the_looper->Latency);
+			break;
+
+		case MSG_LEFT_CHANNEL: the_looper->Display = DISPLAY_LEFT; break;
+		case MSG_RIGHT_CHANNEL: the_looper->Display = DISPLAY_RIGHT; break;
+		case MSG_STEREO_CHANNELS: the_looper->Display = DISPLAY_STEREO; break;
+		case MSG_MATH_CHANNEL: the_looper->Display = DISPLAY_MATH; break;
+		case MSG_ALL_CHANNELS: the_looper->Display = DISPLAY_ALL; break;
+		case MSG_OVERLAY_CHANNELS: the_looper->Display = DISPLAY_OVERLAY; break;
+
+		case MSG_MATH_OP:
+			msg->FindInt32("op", &math_op);
+			the_view->SetMath(math_op, math_filter, math_cutoff_table[math_cutoff]);
+			break;
+		case MSG_MATH_FILTER:
+			msg->FindInt32("filter", &math_filter);
+			the_view->SetMath(math_op, math_filter, math_cutoff_table[math_cutoff]);
+			break;
+		case MSG_MATH_CUTOFF:
+			msg->FindInt32("index", &math_cutoff);
+			the_view->SetMath(math_op, math_filter, math_cutoff_table[math_cutoff]);
+			break;
+
+		case MSG_ACQUIRE_MODE:
+			msg->FindInt32("mode", &acquire_mode);
+			the_view->SetAcquireMode(acquire_mode);
+			break;
+		case MSG_SWEEP_MODE:
+			msg->FindInt32("mode", &sweep_mode);
+			the_view->SetSweepMode(sweep_mode, 2 << sweep_count);
+			break;
+		case MSG_SWEEP_COUNT:
+			msg->FindInt32("index", &sweep_count);
+			the_view->SetSweepMode(sweep_mode, 2 << sweep_count);
+			break;
+
+		case MSG_BEAM_WIDTH:
+			msg->FindInt32("index", &beam_width);
+			the_looper->BeamWidth = beam_width_table[beam_width];
+			break;
+
+		case MSG_CHANNEL_GAIN:
+		case MSG_CHANNEL_OFFSET:
+		case MSG_COUPLING: {
+			int32 c, i;
+			if (msg->FindInt32("channel", &c) != B_NO_ERROR || msg->FindInt32("index", &i) != B_NO_ERROR)
+				break;
+			if (msg->what == MSG_CHANNEL_GAIN) {
+				channel_gain[c] = i;
+				the_looper->Gain[c] = gain_table[i];
+			} else if (msg->what == MSG_CHANNEL_OFFSET) {
+				channel_offset[c] = i;
+				the_looper->Offset[c] = offset_table[i];
+			} else {
+				coupling[c] = i;
+				the_view->SetCoupling(c == 1, i == 1);
+			}
+			break;
+		}
+
+		case MSG_TIME_DIV: {
+			int32 index;
+			if (msg->FindInt32("index", &index) == B_NO_ERROR && index >= 0 && index < NUM_TIME_DIVS)
+				set_time_per_div(time_div_table[index].time);
+			break;
+		}
+
+		case MSG_TRIGGER_OFF: the_view->SetTriggerMode(TRIGGER_OFF); break;
+		case MSG_TRIGGER_LEVEL: the_view->SetTriggerMode(TRIGGER_LEVEL); break;
+		case MSG_TRIGGER_PEAK: the_view->SetTriggerMode(TRIGGER_PEAK); break;
+
+		case MSG_TRIGGER_LEFT: the_view->SetTriggerChannel(false); break;
+		case MSG_TRIGGER_RIGHT: the_view->SetTriggerChannel(true); break;
 
-		case MSG_SLOPE_POS: the_subscriber->TriggerSlopeNeg = false; break;
-		case MSG_SLOPE_NEG: the_subscriber->TriggerSlopeNeg = true; break;
+		case MSG_SLOPE_POS: the_view->SetTriggerSlope(false); break;
+		case MSG_SLOPE_NEG: the_view->SetTriggerSlope(true); break;
 
 		case MSG_ILLUMINATION: {
 			BScreen scr(this);
@@ -422,6 +1046,85 @@ void QScopeWindow::MessageReceived(BMessage *msg)
 			break;
 		}
 
+		case MSG_AUTO_SETUP:
+			auto_looper->Start();
+			break;
+
+		case MSG_AUTO_RESULT:
+			auto_setup_done(msg);
+			break;
+
+		case MSG_LATENCY:
+			if (latency_looper->Running()) {
+				latency_looper->Stop();
+				SetTitle("QScope");
+			} else {
+				latency_looper->Start();
+				SetTitle("QScope - Measuring Latency" B_UTF8_ELLIPSIS);
+			}
+			latency_item->SetMarked(latency_looper->Running());
+			break;
+
+		case MSG_LATENCY_RESULT:
+			latency_done(msg);
+			break;
+
+		case MSG_DISPLAY_LATENCY:
+			report_display_latency();
+			break;
+
+		case MSG_BODE:	// Start measurement, or stop it and return to the traces
+			if (bode_looper->Running() || bode_shown) {
+				bode_looper->Stop();
+				the_looper->PostMessage(MSG_BODE_CLEAR);
+				bode_shown = false;
+				SetTitle("QScope");
+			} else {
+				bode_looper->Start();
+				SetTitle("QScope - Measuring Frequency Response" B_UTF8_ELLIPSIS);
+			}
+			bode_item->SetMarked(bode_looper->Running() || bode_shown);
+			break;
+
+		case MSG_BODE_RESULT:
+			bode_done(msg);
+			break;
+
+		case MSG_DISTORTION:
+			if (distortion_looper->Running()) {
+				distortion_looper->Stop();
+				SetTitle("QScope");
+			} else {
+				distortion_looper->Start();
+				SetTitle("QScope - Analysing Distortion" B_UTF8_ELLIPSIS);
+			}
+			distortion_item->SetMarked(distortion_looper->Running());
+			break;
+
+		case MSG_DIST_CHANNEL:
+			msg->FindInt32("index", &dist_channel);
+			distortion_looper->SetChannel(dist_channel == 1);
+			break;
+		case MSG_DIST_SIZE:
+		case MSG_DIST_BANDWIDTH:
+		case MSG_DIST_WEIGHTING: {
+			int32 i;
+			if (msg->FindInt32("index", &i) != B_NO_ERROR)
+				break;
+			if (msg->what == MSG_DIST_SIZE)
+				dist_size = i;
+			else if (msg->what == MSG_DIST_BANDWIDTH)
+				dist_bandwidth = i;
+			else
+				dist_weighting = i;
+			distortion_looper->Setup(dist_size_table[dist_size], dist_bandwidth, dist_weighting);
+			break;
+		}
+
+		case MSG_DIST_RESULT:
+			distortion_done(msg);
+			break;
+
 		default:
 			BWindow::MessageReceived(msg);
 	}
@@ -429,457 +1132,864 @@ void QScopeWindow::MessageReceived(BMessage *msg)
 
 
 /*
- *  Slider callbacks
+ *  Apply result of auto setup
  */
 
-void QScopeWindow::trigger_level_callback(float value, void *arg)
+void QScopeWindow::auto_setup_done(BMessage *msg)
 {
-	((QScopeWindow *)arg)->the_subscriber->TriggerLevel = (value - 0.5) * 65535;
+	bool right;
+	int32 level;
+	float period;
+
+	if (msg->FindBool("right", &right) != B_NO_ERROR || msg->FindInt32("level", &level) != B_NO_ERROR)
+		return;
+
+	// Trigger on rising edge through the middle of the larger channel (as the view sees it, coupled)
+	the_view->SetTriggerMode(TRIGGER_LEVEL);
+	trigger_mode_popup->ItemAt(1)->SetMarked(true);
+	the_view->SetTriggerSlope(false);
+	slope_popup->ItemAt(0)->SetMarked(true);
+	the_view->SetTriggerChannel(right);
+	trigger_channel_popup->ItemAt(right ? 1 : 0)->SetMarked(true);
+	the_view->SetTriggerLevel(level);
+	level_slider->SetValue(level / 65535.0 + 0.5);
+
+	// Choose time base showing about 2.5 periods (no period found: leave alone)
+	if (msg->FindFloat("period", &period) == B_NO_ERROR) {
+		float div = period * 1E6 * 2.5 / NUM_X_DIVS;
+		int best = 0;
+		for (int i=1; i<NUM_TIME_DIVS; i++)
+			if (fabs(log(time_div_table[i].time / div)) < fabs(log(time_div_table[best].time / div)))
+				best = i;
+		set_time_per_div(time_div_table[best].time);
+		time_div_popup->ItemAt(best)->SetMarked(true);
+	}
 }
 
-void QScopeWindow::hold_off_callback(float value, void *arg)
+
+/*
+ *  Create submenu with radio items, each sending message "what" with its index in "field"
+ */
+
+BMenu *QScopeWindow::make_radio_menu(const char *name, uint32 what, const char *field, const char **labels, int num, int marked)
 {
-	((QScopeWindow *)arg)->the_subscriber->SetHoldOff(value * 10.0);
+	BMenu *menu = new BMenu(name);
+	menu->SetRadioMode(true);
+	for (int i=0; i<num; i++) {
+		BMessage *msg = new BMessage(what);
+		msg->AddInt32(field, i);
+		menu->AddItem(new BMenuItem(labels[i], msg));
+	}
+	menu->ItemAt(marked)->SetMarked(true);
+	menu->SetTargetForItems(this);
+	return menu;
 }
 
 
 /*
- *  Drawing looper constructor
+ *  Show result of latency measurement, and log it to stdout for long-term tracking
  */
 
-DrawLooper::DrawLooper(BitmapView *view, BBitmap *bitmap) : BLooper("QScope Drawing", B_DISPLAY_PRIORITY, 2)
+void QScopeWindow::latency_done(BMessage *msg)
 {
-	the_view = view;
-	the_bounds = view->Bounds();
-	the_window = view->Window();
-	the_bitmap = bitmap;
-	bits = (uint8 *)the_bitmap->Bits();
-	xmod = the_bitmap->BytesPerRow();
-	Stereo = false;
-	RightChannel = false;
-	Run();
+	if (!latency_looper->Running())
+		return;
+
+	double latency;
+	float correlation;
+	int64 when;
+	bool inverted = false;
+	char str[64];
+	msg->FindFloat("correlation", &correlation);
+	msg->FindInt64("when", &when);
+	msg->FindBool("inverted", &inverted);
+	char line[64];
+	if (msg->FindDouble("latency", &latency) == B_NO_ERROR) {
+		sprintf(str, "QScope - Latency %.3fms", latency / 1000);
+		sprintf(line, "%.1f\t%.4f\t%.3f%s", when / 1E6, latency / 1000, correlation, inverted ? "\tinverted" : "");
+	} else {
+		sprintf(str, "QScope - No Loopback");
+		sprintf(line, "%.1f\t-\t%.3f", when / 1E6, correlation);
+	}
+	printf("%s\n", line);
+	fflush(stdout);
+	SetTitle(str);
+	publish_result("latency", line);
 }
 
 
 /*
- *  Redraw oscilloscope
+ *  Write the display latency of the sweeps drawn since the last report to
+ *  stdout and start over: per stage a line with the number of sweeps,
+ *  median, 90%, 99% and maximum in ms, then the non-empty buckets (stage,
+ *  lower end in ms, count), then an empty line. Shows the total in the title
  */
 
-void DrawLooper::MessageReceived(BMessage *msg)
+void QScopeWindow::report_display_latency(void)
 {
-	switch (msg->what) {
-		case MSG_NEW_BUFFER: {	// New data buffer arrived, redraw oscilloscope
-			int i, j;
-			uint8 *p, *q, *r;
-			int16 *buf;
-			uint8 black = c_black;	// Local variables are faster
-			uint8 *bits = this->bits;
-			int xmod = this->xmod;
-
-			// Prevent backlog
-			BMessage *msg2;
-			MessageQueue()->Lock();
-			while ((msg2 = MessageQueue()->FindMessage(0L)) != NULL) {
-				MessageQueue()->RemoveMessage(msg2);
-				delete msg2;
-			}
-			MessageQueue()->Unlock();
+	Histogram hist[NUM_LAT_STAGES];
+	for (int i=0; i<NUM_LAT_STAGES; i++)
+		the_looper->Latency[i].Take(hist + i);
+
+	char table[NUM_LAT_STAGES * 96];
+	char *p = table;
+	for (int i=0; i<NUM_LAT_STAGES; i++) {
+		Histogram *h = hist + i;
+		sprintf(p, "%s\t%ld\t%.3f\t%.3f\t%.3f\t%.3f", lat_stage_names[i], (long)h->Count(),
+			h->Percentile(0.5) / 1000, h->Percentile(0.9) / 1000, h->Percentile(0.99) / 1000, h->Max() / 1000.0);
+		printf("%s\n", p);
+		p += strlen(p);
+		if (i < NUM_LAT_STAGES - 1)
+			*p++ = '\n';
+	}
+	for (int i=0; i<NUM_LAT_STAGES; i++)
+		for (int b=0; b<NUM_HIST_BUCKETS; b++)
+			if (hist[i].BucketCount(b))
+				printf("%s\t%.4f\t%ld\n", lat_stage_names[i], Histogram::BucketStart(b) / 1000, (long)hist[i].BucketCount(b));
+	printf("\n");
+	fflush(stdout);
+	publish_result("display_latency", table);
+
+	char str[128];
+	Histogram *total = hist + LAT_TOTAL;
+	if (total->Count())
+		sprintf(str, "QScope - Display Latency %.1fms (99%% %.1fms, %ld Sweeps)", total->Percentile(0.5) / 1000, total->Percentile(0.99) / 1000, (long)total->Count());
+	else
+		sprintf(str, "QScope - Display Latency: No Sweeps Drawn");
+	SetTitle(str);
+}
 
-			// Get pointer to data buffer
-			if (msg->FindPointer("buffer", (void**) &buf) != B_NO_ERROR)
-				break;
 
-			// Draw dark green background
-			memset(bits, c_dark_green, xmod * SCOPE_HEIGHT);
+/*
+ *  Show measured frequency response in place of the traces, and write it to stdout
+ */
 
-			// Draw data
-			if (Stereo) {
-				draw_data(buf, SCOPE_HEIGHT / 4, SCOPE_HEIGHT / 2);
-				draw_data(buf + SCOPE_WIDTH * 2, SCOPE_HEIGHT * 3/4, SCOPE_HEIGHT / 2);
-			} else
-				if (RightChannel)
-					draw_data(buf + SCOPE_WIDTH * 2, SCOPE_HEIGHT / 2, SCOPE_HEIGHT);
-				else
-					draw_data(buf, SCOPE_HEIGHT / 2, SCOPE_HEIGHT);
+void QScopeWindow::bode_done(BMessage *msg)
+{
+	if (!bode_item->IsMarked())
+		return;		// Stopped in the meantime
+
+	const float *freq, *gain, *phase;
+	ssize_t size;
+	bool reference = false;
+	msg->FindBool("reference", &reference);
+	if (msg->FindData("freq", B_RAW_TYPE, (const void **)&freq, &size) == B_NO_ERROR
+	 && msg->FindData("gain", B_RAW_TYPE, (const void **)&gain, &size) == B_NO_ERROR
+	 && msg->FindData("phase", B_RAW_TYPE, (const void **)&phase, &size) == B_NO_ERROR) {
+		int num = size / sizeof(float);
+		char *table = new char[32 + num * 48];
+		char *p = table + sprintf(table, "%s", reference ? "left/right" : "left/dac");
+		for (int i=0; i<num; i++) {
+			printf("%.1f\t%.3f\t%.2f\n", freq[i], gain[i], phase[i]);
+			p += sprintf(p, "\n%.1f\t%.3f\t%.2f", freq[i], gain[i], phase[i]);
+		}
+		printf("\n");
+		fflush(stdout);
+		publish_result("response", table);
+		delete[] table;
+	}
 
-			// Draw grid and ticks
-			for (i=0; i<NUM_Y_DIVS; i++) {
-				memset(bits + xmod * (i * SCOPE_HEIGHT / NUM_Y_DIVS), black, SCOPE_WIDTH); 
-				for (j=1; j<TICKS_PER_DIV; j++)
-					memset(bits + SCOPE_WIDTH / 2 - 3 + xmod * (i * SCOPE_HEIGHT / NUM_Y_DIVS + j * SCOPE_HEIGHT / (NUM_Y_DIVS * TICKS_PER_DIV)), black, 7); 
-			}
-			memset(bits + xmod * (SCOPE_HEIGHT-1), black, SCOPE_WIDTH);
-
-			p = bits;
-			for (i=0; i<SCOPE_HEIGHT; i++) {
-				for (j=0; j<NUM_X_DIVS; j++)
-					p[j * SCOPE_WIDTH / NUM_X_DIVS] = black;
-				p[SCOPE_WIDTH-1] = black;
-				p += xmod;
-			}
-			p = bits + xmod * (SCOPE_HEIGHT / 2 - 3);
-			q = bits + xmod * (SCOPE_HEIGHT / 4 - 2);
-			r = bits + xmod * (SCOPE_HEIGHT * 3/4 - 2);
-			for (i=0; i<NUM_X_DIVS; i++)
-				for (j=1; j<TICKS_PER_DIV; j++) {
-					int ofs = i * SCOPE_WIDTH / NUM_X_DIVS + j * SCOPE_WIDTH / (NUM_X_DIVS * TICKS_PER_DIV);
-					p[ofs] = black;
-					p[ofs + xmod] = black;
-					p[ofs + xmod * 2] = black;
-					p[ofs + xmod * 3] = black;
-					p[ofs + xmod * 4] = black;
-					p[ofs + xmod * 5] = black;
-					p[ofs + xmod * 6] = black;
-					q[ofs] = black;
-					q[ofs + xmod] = black;
-					q[ofs + xmod * 2] = black;
-					q[ofs + xmod * 3] = black;
-					q[ofs + xmod * 4] = black;
-					r[ofs] = black;
-					r[ofs + xmod] = black;
-					r[ofs + xmod * 2] = black;
-					r[ofs + xmod * 3] = black;
-					r[ofs + xmod * 4] = black;
-					bits[ofs + xmod * (SCOPE_HEIGHT * 3/16)] = black;
-					bits[ofs + xmod * (SCOPE_HEIGHT * 13/16)] = black;
-				}
+	the_looper->PostMessage(msg);
+	bode_shown = true;
+	SetTitle(reference ? "QScope - Frequency Response (Left/Right)" : "QScope - Frequency Response (Left/DAC)");
+}
 
-			// Blit bitmap to screen
-			if (the_window->LockWithTimeout(100000) == B_OK) {
-				the_view->Draw(the_bounds);
-				the_window->Unlock();
-			}
-			break;
-		}
 
-		default:
-			BLooper::MessageReceived(msg);
+/*
+ *  Show result of distortion analysis
+ */
+
+void QScopeWindow::distortion_done(BMessage *msg)
+{
+	if (!distortion_looper->Running())
+		return;
+
+	bool valid = false;
+	float freq, level, thd, thd_n, sinad, snr, floor;
+	char str[256], line[128];
+	msg->FindBool("valid", &valid);
+	if (valid && msg->FindFloat("freq", &freq) == B_NO_ERROR && msg->FindFloat("level", &level) == B_NO_ERROR
+	 && msg->FindFloat("thd", &thd) == B_NO_ERROR && msg->FindFloat("thd_n", &thd_n) == B_NO_ERROR
+	 && msg->FindFloat("sinad", &sinad) == B_NO_ERROR && msg->FindFloat("snr", &snr) == B_NO_ERROR
+	 && msg->FindFloat("floor", &floor) == B_NO_ERROR) {
+		sprintf(str, "QScope - %.1fHz %.1fdBFS  THD %.4f%%  THD+N %.4f%%  SINAD %.1fdB  SNR %.1fdB  Floor %.0fdBFS", freq, level, thd, thd_n, sinad, snr, floor);
+		sprintf(line, "%.1f\t%.1f\t%.4f\t%.4f\t%.1f\t%.1f\t%.0f", freq, level, thd, thd_n, sinad, snr, floor);
+	} else {
+		sprintf(str, "QScope - Distortion: No Signal");
+		sprintf(line, "-");
 	}
+	SetTitle(str);
+	publish_result("distortion", line);
 }
 
 
 /*
- *  Draw oscilloscope beam
+ *  Send measurement result to the clients of the trace server, as name and tab-separated fields
  */
 
-void DrawLooper::draw_data(int16 *buf, int y_offset, int y_height)
+void QScopeWindow::publish_result(const char *name, const char *fields)
 {
-	// y1 is top (maximum value), y2 is bottom (minimum value)
-	int16 old_y1 = *buf++;
-	int16 old_y2 = *buf++;
-	int16 y1, y2;
+	if (trace_server == NULL)
+		return;
+	char *text = new char[strlen(name) + strlen(fields) + 2];
+	sprintf(text, "%s\t%s", name, fields);
+	trace_server->PublishResult(text);
+	delete[] text;
+}
 
-	// Loop for all samples in buffer
-	for (int i=0; i<SCOPE_WIDTH-1; i++, old_y1 = y1, old_y2 = y2) {
 
-		// Get next sample values
-		y1 = *buf++;
-		y2 = *buf++;
+/*
+ *  Replay capture through the subscriber's stream function, instead of the stream
+ */
 
-		// Make sure that lines are connected
-		if (y1 > old_y1 && y2 > old_y1)
-			y2 = old_y1;
-		if (y1 < old_y2 && y2 < old_y2)
-			y1 = old_y2;
-
-		uint32 y1_scr = y_offset - y1 * y_height / 65533;
-		uint32 y2_scr = y_offset - y2 * y_height / 65533;
-
-		if (y1_scr >= SCOPE_HEIGHT && y2_scr >= SCOPE_HEIGHT)
-			continue;
-		if (y1_scr >= SCOPE_HEIGHT)
-			y1_scr = y1_scr & 0x80000000 ? SCOPE_HEIGHT-1 : 0;
-		if (y2_scr >= SCOPE_HEIGHT)
-			y2_scr = y2_scr & 0x80000000 ? SCOPE_HEIGHT-1 : 0;
-
-		uint32 c_index = (y2_scr - y1_scr) * 16 / SCOPE_HEIGHT;
-		if (c_index > 15)
-			continue;
-		int color = c_beam[c_index];
-		uint8 *p = bits + xmod * y1_scr + i;
-		for (int j=y1_scr; j<=y2_scr ;j++) {
-			*p = color;
-			p += xmod;
-		}
+void QScopeWindow::replay(const char *path, size_t buffer_size, bool fast)
+{
+	replay_file->Stop();
+	status_t err = replay_file->Open(path);
+	if (err != B_NO_ERROR) {
+		char str[B_PATH_NAME_LENGTH + 64];
+		sprintf(str, "Can't replay %s, only 16 bit stereo WAV or raw files are supported.", path);
+		(new BAlert("", str, "OK"))->Go();
+		return;
+	}
+
+	// The engine runs at SAMPLE_RATE, time base and trigger would be wrong for any other rate
+	if (replay_file->SampleRate() != SAMPLE_RATE) {
+		char str[B_PATH_NAME_LENGTH + 64];
+		sprintf(str, "Can't replay %s, it was recorded at %g Hz instead of %g Hz.", path, replay_file->SampleRate(), SAMPLE_RATE);
+		(new BAlert("", str, "OK"))->Go();
+		replay_file->Close();
+		return;
+	}
+
+	select_source(SOURCE_FILE);
+	replay_file->Start(QScopeSubscriber::stream_func, the_subscriber, buffer_size, !fast);
+	stream_popup->ItemAt(SOURCE_FILE)->SetMarked(true);
+}
+
+
+/*
+ *  Switch engine to source and stop the sources that are not needed any more
+ */
+
+void QScopeWindow::select_source(int source)
+{
+	the_subscriber->SetSource(source);
+	if (source != SOURCE_FILE)
+		replay_file->Stop();
+	if (source != SOURCE_SYNTH)
+		synth_source->Stop();
+}
+
+
+/*
+ *  Hand generator settings to the generator source and the DAC generator,
+ *  right channel 90 degrees behind the left one
+ */
+
+void QScopeWindow::update_generator(void)
+{
+	for (int c=0; c<2; c++) {
+		float phase = c == 1 ? 0.25 : 0;
+		synth_source->Generator()->SetChannel(c, gen_wave[c], gen_freq_table[gen_freq[c]], gen_level_table[gen_level[c]], phase);
+		dac_generator->SetChannel(c, gen_wave[c], gen_freq_table[gen_freq[c]], gen_level_table[gen_level[c]], phase);
 	}
 }
 
 
 /*
- *  Subscriber constructor
+ *  Stream functions of the sources (called by their threads)
  */
 
-QScopeSubscriber::QScopeSubscriber(BLooper *looper) : BSubscriber("QScope")
+bool QScopeWindow::dac_func(void *arg, char *buf, size_t count, void *header)
 {
-	TriggerRightChannel = false;
-	TriggerSlopeNeg = false;
-	TriggerLevel = 0;
-	SetTimePerDiv(2E-3);
+	QScopeWindow *win = (QScopeWindow *)arg;
+	bigtime_t time = header != NULL ? ((audio_buffer_header *)header)->time : system_time();
+	if (atomic_get(&win->gen_output))
+		win->dac_generator->Mix((int16 *)buf, count >> 2);
+	win->latency_looper->Play((int16 *)buf, count >> 2, time);
+	win->bode_looper->Play((int16 *)buf, count >> 2, time);
+	win->the_subscriber->Feed(SOURCE_DAC, (int16 *)buf, count, time);
+	return true;
+}
 
-	the_looper = looper;
-	the_stream = NULL;
+bool QScopeWindow::adc_func(void *arg, char *buf, size_t count, void *header)
+{
+	QScopeWindow *win = (QScopeWindow *)arg;
+	bigtime_t time = header != NULL ? ((audio_buffer_header *)header)->time : system_time();
+	win->latency_looper->Record((int16 *)buf, count >> 2, time);
+	win->bode_looper->Record((int16 *)buf, count >> 2, time);
+	win->the_subscriber->Feed(SOURCE_ADC, (int16 *)buf, count, time);
+	return true;
+}
 
-	state = STATE_RECORD;
+bool QScopeWindow::synth_func(void *arg, char *buf, size_t count, void *header)
+{
+	QScopeWindow *win = (QScopeWindow *)arg;
+	win->the_subscriber->Feed(SOURCE_SYNTH, (int16 *)buf, count, ((audio_buffer_header *)header)->time);
+	return true;
+}
 
-	active_buf = 0;
-	scope_counter = 0;
-	record_counter = 0;
-	next_frame = 0.0;
-	old_input = 0;
-	left_min = right_min = 32767;
-	left_max = right_max = left_peak = right_peak = -32768;
 
-	hold_off_counter = 0;
-	SetHoldOff(0);
+/*
+ *  Set time base, switching to roll mode for slow time bases
+ */
+
+void QScopeWindow::set_time_per_div(bigtime_t time)
+{
+	the_view->SetTimePerDiv(time);
+	the_looper->Roll = time >= ROLL_TIME_DIV;
+}
+
+
+/*
+ *  Slider callbacks
+ */
+
+void QScopeWindow::trigger_level_callback(float value, void *arg)
+{
+	((QScopeWindow *)arg)->the_view->SetTriggerLevel((value - 0.5) * 65535);
+}
 
-	trigger_start_frame = 0;
-	trigger_total_frames = 0;
-	SetTriggerMode(TRIGGER_LEVEL);
+void QScopeWindow::hold_off_callback(float value, void *arg)
+{
+	// Logarithmic from 0.01 to 100 divisions
+	((QScopeWindow *)arg)->the_view->SetHoldOff(value > 0 ? pow(10.0, value * 4.0 - 2.0) : 0.0);
 }
 
 
 /*
- *  Subscriber destructor
+ *  Bitmap view constructor
  */
 
-QScopeSubscriber::~QScopeSubscriber()
+BitmapView::BitmapView(BRect frame) : BView(frame, "bitmap", B_FOLLOW_ALL_SIDES, B_WILL_DRAW)
 {
-	if (the_stream != NULL) {
-		ExitStream(true);
-		Unsubscribe();
+	for (int i=0; i<2; i++) {
+		page[i].bitmap = new BBitmap(BRect(0, 0, frame.Width(), frame.Height()), B_COLOR_8_BIT);
+		page[i].origin = 0;
+		memset(&page[i].stamps, 0, sizeof(trace_stamps));
+		page[i].render_start = page[i].render_end = 0;
+		page[i].timed = true;
 	}
+	front = 0;
+	BlitPending = 0;
 }
 
 
 /*
- *  Subscribe to audio stream
+ *  Bitmap view destructor
  */
 
-void QScopeSubscriber::Enter(BAbstractBufferStream *stream)
+BitmapView::~BitmapView()
 {
-	// Leave old stream
-	if (the_stream != NULL) {
-		ExitStream(true);
-		Unsubscribe();
-		the_stream = NULL;
+	delete page[0].bitmap;
+	delete page[1].bitmap;
+}
+
+
+/*
+ *  Blit page, rotated left by its origin (page locked)
+ */
+
+void BitmapView::draw_page(bitmap_page *p, BRect update)
+{
+	int origin = p->origin;
+	if (origin == 0) {
+		DrawBitmap(p->bitmap, update, update);
+		return;
 	}
 
-	// Subscribe to new stream
-	if (Subscribe(stream) == B_NO_ERROR) {
-		EnterStream(NULL, false, this, stream_func, NULL, true);
-		the_stream = stream;
+	BRect b = Bounds();
+	float split = b.right - origin;
+	DrawBitmap(p->bitmap, BRect(origin, b.top, b.right, b.bottom), BRect(0, b.top, split, b.bottom));
+	DrawBitmap(p->bitmap, BRect(0, b.top, origin - 1, b.bottom), BRect(split + 1, b.top, b.right, b.bottom));
+}
+
+
+/*
+ *  Redraw from the front page
+ */
+
+void BitmapView::Draw(BRect update)
+{
+	bitmap_page *p = Front();
+	p->lock.Lock();
+	draw_page(p, update);
+	p->lock.Unlock();
+}
+
+
+/*
+ *  Show new front page (MSG_BLIT), the sweep on it is timed the first time
+ */
+
+void BitmapView::Blit(Histogram *latency)
+{
+	bitmap_page *p = Front();
+	p->lock.Lock();
+	draw_page(p, Bounds());
+	bigtime_t blit_end = system_time();
+	if (!p->timed) {
+		p->timed = true;
+		latency[LAT_AUDIO].Add(p->stamps.complete - p->stamps.arrival);
+		latency[LAT_SWEEP].Add(p->stamps.complete - p->stamps.trigger);
+		latency[LAT_QUEUE].Add(p->render_start - p->stamps.complete);
+		latency[LAT_RENDER].Add(p->render_end - p->render_start);
+		latency[LAT_BLIT].Add(blit_end - p->render_end);
+		latency[LAT_TOTAL].Add(blit_end - p->stamps.arrival);
 	}
+	p->lock.Unlock();
 }
 
 
 /*
- *  Set time per division
+ *  Lock back page for drawing, NULL if the window is still blitting it
  */
 
-void QScopeSubscriber::SetTimePerDiv(float time)
+bitmap_page *BitmapView::LockBack(void)
 {
-	time_per_div = time;
-	frame_add = time * SAMPLE_RATE * float(NUM_X_DIVS) / float(SCOPE_WIDTH);
-	SetHoldOff(hold_off);
+	bitmap_page *p = page + (1 - atomic_get(&front));
+	if (p->lock.LockWithTimeout(0) != B_OK)
+		return NULL;
+	return p;
 }
 
 
 /*
- *  Set hold-off time
+ *  Drawing looper constructor
  */
 
-void QScopeSubscriber::SetHoldOff(float hold)
+DrawLooper::DrawLooper(BitmapView *view, TraceRing *ring) : BLooper("QScope Drawing", B_DISPLAY_PRIORITY, 2)
 {
-	hold_off = hold;
-	hold_off_frames = hold * time_per_div * SAMPLE_RATE;
+	the_ring = ring;
+	the_view = view;
+	the_window = view->Window();
+	back = NULL;
+	bits = NULL;
+	xmod = 0;
+	dirty = false;
+	refresh_pending = 0;
+	refresh_quit = false;
+	Display = DISPLAY_LEFT;
+	BeamWidth = beam_width_table[DEFAULT_BEAM_WIDTH];
+	for (int c=0; c<NUM_CHANNELS; c++) {
+		Gain[c] = 1;
+		Offset[c] = 0;
+	}
+	beam.SetShades(c_shade);
+	Roll = rolling = false;
+	roll_pos = 0;
+	roll_x = 0;
+	roll_count = 0;
+	bode = false;
+	Run();
+
+	refresh_thread = spawn_thread(refresh_entry, "QScope Refresh", B_DISPLAY_PRIORITY, this);
+	resume_thread(refresh_thread);
 }
 
 
 /*
- *  Set trigger mode
+ *  Drawing looper destructor
  */
 
-void QScopeSubscriber::SetTriggerMode(int mode)
+DrawLooper::~DrawLooper()
 {
-	trigger_mode = mode;
+	if (refresh_thread >= 0) {
+		status_t l;
+		refresh_quit = true;
+		wait_for_thread(refresh_thread, &l);
+	}
 }
 
 
 /*
- *  Stream function
+ *  Refresh thread: one MSG_REFRESH per retrace, or per REFRESH_PERIOD if the
+ *  driver can't wait for it; never more than one is queued
  */
 
-bool QScopeSubscriber::stream_func(void *arg, char *buf, size_t count, void *header)
+status_t DrawLooper::refresh_entry(void *arg)
 {
-	((QScopeSubscriber *)arg)->scope_func((int16 *)buf, count);
-	return true;
+	((DrawLooper *)arg)->refresh_func();
+	return 0;
 }
 
-void QScopeSubscriber::scope_func(int16 *buf, size_t count)
+void DrawLooper::refresh_func(void)
 {
-	// Number of sample frames in input buffer
-	count >>= 2;
+	BScreen screen(the_window);
+	while (!refresh_quit) {
+		if (screen.WaitForRetrace(100000) != B_NO_ERROR)
+			snooze(REFRESH_PERIOD - system_time() % REFRESH_PERIOD);
+		if (atomic_get_and_set(&refresh_pending, 1) == 0)
+			PostMessage(MSG_REFRESH);
+	}
+}
 
-	// Act according to current state
-	switch (state) {
-		case STATE_HOLD_OFF:	// Wait before next trigger
-hold_off:
-			if (hold_off_counter >= count) {
 
-				// Still waiting
-				hold_off_counter -= count;
+/*
+ *  Handle messages: sweeps and columns only mark the display dirty, it is
+ *  drawn at the next refresh from the newest data, so several sweeps per
+ *  refresh cost one drawing
+ */
 
-			} else {
+void DrawLooper::MessageReceived(BMessage *msg)
+{
+	switch (msg->what) {
+		case MSG_NEW_BUFFER:	// New sweep or columns in the ring
+			dirty = true;
+			break;
 
-				// Time elapsed, now search for trigger level (or start recording if not triggered)
-				if (trigger_mode != TRIGGER_OFF) {
-					state = STATE_WAIT_FOR_TRIGGER;
-					trigger_start_frame = hold_off_counter;
-					trigger_total_frames = 0;
-					goto wait_for_trigger;
-				} else {
-					state = STATE_RECORD;
-					next_frame = float(hold_off_counter);
-					goto record;
-				}
+		case MSG_REFRESH: {		// Display refresh, draw into the back page and flip
+			atomic_set(&refresh_pending, 0);
+			if (!dirty || !begin_page())	// Skipped while the window blits the page, tried again next refresh
+				break;
+			dirty = false;
+
+			// Subscriber may notify again from now on
+			the_ring->Notified();
+
+			bool drawn = true;
+			if (bode)
+				draw_bode();
+			else if (Roll)
+				draw_roll();
+			else {
+				rolling = false;
+				drawn = draw_trace();
 			}
+			end_page(drawn);
 			break;
+		}
 
-		case STATE_WAIT_FOR_TRIGGER: {	// Search for trigger level
-wait_for_trigger:
-			int i;
-			int16 input;
-			if (trigger_mode == TRIGGER_PEAK) {
-				if (TriggerRightChannel) {
-					int16 compare = right_peak - 256;
-					for (i=trigger_start_frame; i<count; i++) {
-						input = buf[(i << 1) + 1];
-						if (input >= compare)
-							goto trigger_found;
-					}
-				} else {
-					int16 compare = left_peak - 256;
-					for (i=trigger_start_frame; i<count; i++) {
-						input = buf[i << 1];
-						if (input >= compare)
-							goto trigger_found;
-						old_input = input;
-					}
-				}
-			} else {
-				bool trigger_right = TriggerRightChannel;
-				int trigger_level = TriggerLevel;
-				if (TriggerSlopeNeg) {
-					for (i=trigger_start_frame; i<count; i++) {
-						input = buf[(i << 1) + trigger_right];
-						if (input < trigger_level && old_input > trigger_level)
-							goto trigger_found;
-						old_input = input;
-					}
-				} else {
-					for (i=trigger_start_frame; i<count; i++) {
-						input = buf[(i << 1) + trigger_right];
-						if (input > trigger_level && old_input < trigger_level)
-							goto trigger_found;
-						old_input = input;
-					}
-				}
-			}
-			trigger_start_frame = 0;
-
-			// Trigger anyway if we have waited more than 1/30s
-			trigger_total_frames += count;
-			if (trigger_total_frames > SAMPLE_RATE / 30)
-				goto trigger_found;
-			break;
-
-trigger_found:
-			state = STATE_RECORD;
-			record_counter = i;
-			next_frame = float(i) + frame_add;
-			left_min = left_max = buf[i << 1];
-			right_min = right_max = buf[(i << 1) + 1];
-			left_peak = right_peak = -32768;
-			old_input = input;
-			goto record;
+		case MSG_BODE_RESULT:	// Show frequency response until cleared
+			set_bode(msg);
+			dirty = true;
+			break;
+
+		case MSG_BODE_CLEAR:
+			bode = false;
+			rolling = false;
+			dirty = true;
+			break;
+
+		default:
+			BLooper::MessageReceived(msg);
+	}
+}
+
+
+/*
+ *  Lock back page and draw into its bits, false if the window is still blitting it
+ */
+
+bool DrawLooper::begin_page(void)
+{
+	back = the_view->LockBack();
+	if (back == NULL)
+		return false;
+	bits = (uint8 *)back->bitmap->Bits();
+	xmod = back->bitmap->BytesPerRow();
+	beam.SetBitmap(bits, xmod, SCOPE_HEIGHT);
+	beam.SetWidth(BeamWidth);
+	back->origin = 0;
+	back->stamps.complete = 0;
+	back->timed = true;
+	return true;
+}
+
+
+/*
+ *  Release back page, if something was drawn show it next (the window is asked
+ *  to blit it, the looper doesn't wait for that)
+ */
+
+void DrawLooper::end_page(bool flip)
+{
+	back->lock.Unlock();
+	back = NULL;
+	if (!flip)
+		return;
+	the_view->Flip();
+	if (atomic_get_and_set(&the_view->BlitPending, 1) == 0)
+		the_window->PostMessage(MSG_BLIT);
+}
+
+
+/*
+ *  Draw newest sweep, false if there is none
+ */
+
+bool DrawLooper::draw_trace(void)
+{
+	int i, j;
+	uint8 *p, *q, *r;
+	int16 *buf;
+	uint8 black = c_black;	// Local variables are faster
+	uint8 *bits = this->bits;
+	int xmod = this->xmod;
+	bigtime_t render_start = system_time();
+
+	// Get newest sweep
+	trace_stamps stamps;
+	if (!the_ring->GetTrace(trace_buf, &stamps))
+		return false;
+	buf = trace_buf;
+
+	// Draw dark green background
+	memset(bits, c_dark_green, xmod * SCOPE_HEIGHT);
+
+	// Draw data
+	const display_layout *d = display_table + Display;
+	beam_map maps[NUM_CHANNELS];
+	set_maps(maps);
+	for (i=0; i<d->num_traces; i++)
+		draw_data(buf + d->trace[i].channel * SCOPE_WIDTH * 2, maps[i]);
+
+	// Draw grid and ticks
+	for (i=0; i<NUM_Y_DIVS; i++) {
+		memset(bits + xmod * (i * SCOPE_HEIGHT / NUM_Y_DIVS), black, SCOPE_WIDTH); 
+		for (j=1; j<TICKS_PER_DIV; j++)
+			memset(bits + SCOPE_WIDTH / 2 - 3 + xmod * (i * SCOPE_HEIGHT / NUM_Y_DIVS + j * SCOPE_HEIGHT / (NUM_Y_DIVS * TICKS_PER_DIV)), black, 7); 
+	}
+	memset(bits + xmod * (SCOPE_HEIGHT-1), black, SCOPE_WIDTH);
+
+	p = bits;
+	for (i=0; i<SCOPE_HEIGHT; i++) {
+		for (j=0; j<NUM_X_DIVS; j++)
+			p[j * SCOPE_WIDTH / NUM_X_DIVS] = black;
+		p[SCOPE_WIDTH-1] = black;
+		p += xmod;
+	}
+	p = bits + xmod * (SCOPE_HEIGHT / 2 - 3);
+	q = bits + xmod * (SCOPE_HEIGHT / 4 - 2);
+	r = bits + xmod * (SCOPE_HEIGHT * 3/4 - 2);
+	for (i=0; i<NUM_X_DIVS; i++)
+		for (j=1; j<TICKS_PER_DIV; j++) {
+			int ofs = i * SCOPE_WIDTH / NUM_X_DIVS + j * SCOPE_WIDTH / (NUM_X_DIVS * TICKS_PER_DIV);
+			p[ofs] = black;
+			p[ofs + xmod] = black;
+			p[ofs + xmod * 2] = black;
+			p[ofs + xmod * 3] = black;
+			p[ofs + xmod * 4] = black;
+			p[ofs + xmod * 5] = black;
+			p[ofs + xmod * 6] = black;
+			q[ofs] = black;
+			q[ofs + xmod] = black;
+			q[ofs + xmod * 2] = black;
+			q[ofs + xmod * 3] = black;
+			q[ofs + xmod * 4] = black;
+			r[ofs] = black;
+			r[ofs + xmod] = black;
+			r[ofs + xmod * 2] = black;
+			r[ofs + xmod * 3] = black;
+			r[ofs + xmod * 4] = black;
+			bits[ofs + xmod * (SCOPE_HEIGHT * 3/16)] = black;
+			bits[ofs + xmod * (SCOPE_HEIGHT * 13/16)] = black;
 		}
 
-		case STATE_RECORD: {	// Get samples and stuff them into scope_buf
-record:
-			int next = int(next_frame);
-			bool reaches_next_frame = true;
-			if (next > count) {
-				next = count;
-				reaches_next_frame = false;
-			}
+	// Timed when the window blits the page
+	back->stamps = stamps;
+	back->render_start = render_start;
+	back->render_end = system_time();
+	back->timed = stamps.complete == 0;
+	return true;
+}
 
-			// Search minimum and maximum
-			for (int i=record_counter; i<next; i++) {
-				int16 left = buf[i << 1];
-				int16 right = buf[(i << 1) + 1];
-				if (left < left_min)
-					left_min = left;
-				if (left > left_max) {
-					left_max = left;
-					if (left > left_peak)
-						left_peak = left;
-				}
-				if (right < right_min)
-					right_min = right;
-				if (right > right_max) {
-					right_max = right;
-					if (right > right_peak)
-						right_peak = right;
-				}
-			}
 
-			if (reaches_next_frame) {
+/*
+ *  Take over frequency response, interpolated to the columns of the plot
+ */
 
-				// Record one sample
-				scope_buf[active_buf][scope_counter] = left_max;
-				scope_buf[active_buf][scope_counter + SCOPE_WIDTH * 2] = right_max;
-				scope_counter++;
-				scope_buf[active_buf][scope_counter] = left_min;
-				scope_buf[active_buf][scope_counter + SCOPE_WIDTH * 2] = right_min;
-				scope_counter++;
+void DrawLooper::set_bode(BMessage *msg)
+{
+	const float *freq, *gain, *phase;
+	ssize_t size;
+	if (msg->FindData("freq", B_RAW_TYPE, (const void **)&freq, &size) != B_NO_ERROR
+	 || msg->FindData("gain", B_RAW_TYPE, (const void **)&gain, &size) != B_NO_ERROR
+	 || msg->FindData("phase", B_RAW_TYPE, (const void **)&phase, &size) != B_NO_ERROR)
+		return;
+	int n = size / sizeof(float);
+	if (n == 0)
+		return;
+
+	int t = 0;
+	for (int x=0; x<SCOPE_WIDTH; x++) {
+		float f = BODE_PLOT_LOW * pow(BODE_PLOT_HIGH / BODE_PLOT_LOW, float(x) / (SCOPE_WIDTH - 1));
+		while (t < n-1 && freq[t+1] < f)
+			t++;
+		if (t == n-1 || f <= freq[t]) {
+			bode_gain[x] = gain[t];
+			bode_phase[x] = phase[t];
+		} else {
+			float a = log(f / freq[t]) / log(freq[t+1] / freq[t]);
+			bode_gain[x] = gain[t] + a * (gain[t+1] - gain[t]);
+			float d = phase[t+1] - phase[t];	// Interpolate the short way around
+			if (d > 180)
+				d -= 360;
+			else if (d < -180)
+				d += 360;
+			float p = phase[t] + a * d;
+			bode_phase[x] = p > 180 ? p - 360 : (p < -180 ? p + 360 : p);
+		}
+	}
+	bode = true;
+}
 
-				// scope_buf full? Then send message to looper
-				if (scope_counter == SCOPE_WIDTH * 2) {
-					scope_counter = 0;
 
-					BMessage msg(MSG_NEW_BUFFER);
-					msg.AddPointer("buffer", scope_buf[active_buf]);
-					the_looper->PostMessage(&msg);
-					active_buf = !active_buf;
+/*
+ *  Draw frequency response: gain bright, phase dim, grid lines at the decades
+ */
 
-					state = STATE_HOLD_OFF;
-					hold_off_counter = hold_off_frames + int(next_frame);
-					goto hold_off;
-				}
+void DrawLooper::draw_bode(void)
+{
+	int x, y;
+	uint8 black = c_black;
+	memset(bits, c_dark_green, xmod * SCOPE_HEIGHT);
+
+	for (y=0; y<NUM_Y_DIVS; y++)
+		memset(bits + xmod * (y * SCOPE_HEIGHT / NUM_Y_DIVS), black, SCOPE_WIDTH);
+	memset(bits + xmod * (SCOPE_HEIGHT-1), black, SCOPE_WIDTH);
+	float decades = log10(BODE_PLOT_HIGH / BODE_PLOT_LOW);
+	for (float f=BODE_PLOT_LOW; f<=BODE_PLOT_HIGH; f*=10) {
+		for (int m=1; m<10; m++) {
+			x = int(log10(m * f / BODE_PLOT_LOW) / decades * (SCOPE_WIDTH - 1) + 0.5);
+			if (x >= SCOPE_WIDTH)
+				break;
+			uint8 *p = bits + x;
+			if (m == 1 || m == 5)	// Decade and half decade lines, ticks in between
+				for (y=0; y<SCOPE_HEIGHT; y++, p+=xmod)
+					*p = black;
+			else
+				for (y=SCOPE_HEIGHT/2-2, p+=xmod*y; y<=SCOPE_HEIGHT/2+2; y++, p+=xmod)
+					*p = black;
+		}
+	}
 
-				// Advance to next frame
-				record_counter = next;
-				next_frame += frame_add;
-				if (record_counter < count) {
-					left_min = left_max = buf[record_counter << 1];
-					right_min = right_max = buf[(record_counter << 1) + 1];
-					goto record;
-				} else {
-
-					// Input buffer used up
-					left_min = left_max = buf[(count-1) << 1];
-					right_min = right_max = buf[((count-1) << 1) + 1];
-					record_counter = 0;
-					next_frame -= count;
-				}
+	int div = SCOPE_HEIGHT / NUM_Y_DIVS;
+	int old_gain = 0, old_phase = 0;
+	for (x=0; x<SCOPE_WIDTH; x++) {
+		int g = BODE_DB_ZERO * div - int(bode_gain[x] * div / BODE_DB_PER_DIV);
+		int p = SCOPE_HEIGHT / 2 - int(bode_phase[x] * div / BODE_DEG_PER_DIV);
+		bool wrapped = x > 0 && fabs(bode_phase[x] - bode_phase[x-1]) > 180;	// Don't connect across +-180
+		draw_span(x, x > 0 && !wrapped ? old_phase : p, p, c_beam[10]);
+		draw_span(x, x > 0 ? old_gain : g, g, c_beam[0]);
+		old_gain = g;
+		old_phase = p;
+	}
+}
 
-			} else {
 
-				// Input buffer used up
-				record_counter = 0;
-				next_frame -= count;
-			}
-			break;
+/*
+ *  Draw vertical line in one column, clipped to the screen
+ */
+
+void DrawLooper::draw_span(int x, int y1, int y2, uint8 color)
+{
+	if (y1 > y2) {
+		int t = y1; y1 = y2; y2 = t;
+	}
+	if (y2 < 0 || y1 >= SCOPE_HEIGHT)
+		return;
+	if (y1 < 0)
+		y1 = 0;
+	if (y2 >= SCOPE_HEIGHT)
+		y2 = SCOPE_HEIGHT-1;
+	uint8 *p = bits + xmod * y1 + x;
+	for (int y=y1; y<=y2; y++, p+=xmod)
+		*p = color;
+}
+
+
+/*
+ *  Roll in new columns like a chart recorder: each column is drawn once at
+ *  roll_x and the bitmap origin moves, the grid scrolls with the data (the
+ *  back page is brought up to date from the front one first)
+ */
+
+void DrawLooper::draw_roll(void)
+{
+	int16 cols[SCOPE_WIDTH * 2 * NUM_CHANNELS];
+	uint8 black = c_black;
+	uint8 green = c_dark_green;
+
+	// Entering roll mode: start with empty screen
+	if (!rolling) {
+		rolling = true;
+		roll_pos = the_ring->Position();
+		roll_x = 0;
+		roll_count = 0;
+		memset(roll_last, 0, sizeof(roll_last));
+		memset(bits, green, xmod * SCOPE_HEIGHT);
+	} else
+		memcpy(bits, the_view->Front()->bitmap->Bits(), xmod * SCOPE_HEIGHT);
+
+	const display_layout *d = display_table + Display;
+	beam_map maps[NUM_CHANNELS];
+	set_maps(maps);
+
+	int n = the_ring->GetColumns(cols, &roll_pos, SCOPE_WIDTH);
+	for (int i=0; i<n; i++) {
+		int x = roll_x;
+		uint8 *p = bits + x;
+
+		// Background and grid
+		bool div_line = roll_count % (SCOPE_WIDTH / NUM_X_DIVS) == 0;
+		for (int y=0; y<SCOPE_HEIGHT; y++, p+=xmod)
+			*p = div_line || y % (SCOPE_HEIGHT / NUM_Y_DIVS) == 0 || y == SCOPE_HEIGHT-1 ? black : green;
+
+		// Beam
+		for (int t=0; t<d->num_traces; t++) {
+			int c = d->trace[t].channel;
+			int16 *col = cols + (c * SCOPE_WIDTH + i) * 2;
+			draw_beam(&beam, x, roll_last[c * 2], roll_last[c * 2 + 1], col[0], col[1], maps[t]);
 		}
+		for (int c=0; c<NUM_CHANNELS; c++) {
+			roll_last[c * 2] = cols[(c * SCOPE_WIDTH + i) * 2];
+			roll_last[c * 2 + 1] = cols[(c * SCOPE_WIDTH + i) * 2 + 1];
+		}
+
+		roll_x = (x + 1) % SCOPE_WIDTH;
+		roll_count++;
+	}
+	beam.Flush();
+
+	// Oldest column is at the left edge
+	back->origin = roll_x;
+}
+
+
+/*
+ *  Screen mapping of each trace of the display, with gain and offset of its channel
+ */
+
+void DrawLooper::set_maps(beam_map *maps)
+{
+	const display_layout *d = display_table + Display;
+	for (int t=0; t<d->num_traces; t++) {
+		int c = d->trace[t].channel;
+		set_beam_map(maps + t, d->trace[t].y_offset, d->trace[t].y_height, Gain[c], Offset[c]);
+	}
+}
+
+
+/*
+ *  Draw oscilloscope beam
+ */
+
+void DrawLooper::draw_data(int16 *buf, const beam_map &m)
+{
+	// y1 is top (maximum value), y2 is bottom (minimum value)
+	int16 old_y1 = *buf++;
+	int16 old_y2 = *buf++;
+	int16 y1, y2;
+
+	// Loop for all samples in buffer
+	for (int i=0; i<SCOPE_WIDTH-1; i++, old_y1 = y1, old_y2 = y2) {
+
+		// Get next sample values
+		y1 = *buf++;
+		y2 = *buf++;
+		draw_beam(&beam, i, old_y1, old_y2, y1, y2, m);
 	}
+	beam.Flush();
 }
@@ -0,0 +1,221 @@
+/*
+ *  Replay.cpp - Feed WAV/raw captures into a stream function
+ *
+ *  Written in 2026 for QScope (original program by Christian Bauer)
+ */
+
+#include <OS.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "Replay.h"
+
+
+// Read little-endian values from WAV header
+static inline uint32 get_le32(const uint8 *p) {return p[0] | (p[1] << 8) | (p[2] << 16) | (p[3] << 24);}
+static inline uint16 get_le16(const uint8 *p) {return p[0] | (p[1] << 8);}
+
+
+/*
+ *  Constructor
+ */
+
+ReplayFile::ReplayFile()
+{
+	fd = -1;
+	map = data = NULL;
+	map_size = data_size = 0;
+	rate = 44100.0;
+	the_thread = -1;
+	quit = false;
+}
+
+
+/*
+ *  Destructor
+ */
+
+ReplayFile::~ReplayFile()
+{
+	Close();
+}
+
+
+/*
+ *  Map file and find 16 bit stereo sample data
+ *  (WAV files are recognized by their header, everything else is raw)
+ */
+
+status_t ReplayFile::Open(const char *path)
+{
+	Close();
+
+	struct stat st;
+	fd = open(path, O_RDONLY);
+	if (fd < 0 || fstat(fd, &st) < 0 || st.st_size < 4) {
+		Close();
+		return B_ERROR;
+	}
+	map_size = st.st_size;
+	map = (char *)mmap(NULL, map_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	if (map == MAP_FAILED) {
+		map = NULL;
+		Close();
+		return B_NO_MEMORY;
+	}
+
+	data = map;
+	data_size = map_size;
+	rate = 44100.0;
+
+	const uint8 *p = (const uint8 *)map;
+	if (map_size >= 12 && memcmp(p, "RIFF", 4) == 0 && memcmp(p + 8, "WAVE", 4) == 0) {
+		bool format_ok = false;
+		data = NULL;
+		size_t ofs = 12;
+		while (ofs + 8 <= map_size) {
+			uint32 len = get_le32(p + ofs + 4);
+			const uint8 *chunk = p + ofs + 8;
+			if (memcmp(p + ofs, "fmt ", 4) == 0 && len >= 16) {
+				uint16 format = get_le16(chunk);
+				uint16 channels = get_le16(chunk + 2);
+				uint16 bits = get_le16(chunk + 14);
+				rate = get_le32(chunk + 4);
+				format_ok = (format == 1 || format == 0xfffe) && channels == 2 && bits == 16;
+			} else if (memcmp(p + ofs, "data", 4) == 0) {
+				data = (char *)chunk;
+				data_size = len;
+				if (ofs + 8 + data_size > map_size)
+					data_size = map_size - ofs - 8;
+				break;
+			}
+			ofs += 8 + ((len + 1) & ~1);
+		}
+		if (!format_ok || data == NULL) {
+			Close();
+			return B_BAD_VALUE;
+		}
+	}
+
+	data_size &= ~3;
+	return B_NO_ERROR;
+}
+
+
+/*
+ *  Stop replay and unmap file
+ */
+
+void ReplayFile::Close(void)
+{
+	Stop();
+	if (map != NULL)
+		munmap(map, map_size);
+	if (fd >= 0)
+		close(fd);
+	fd = -1;
+	map = data = NULL;
+	map_size = data_size = 0;
+}
+
+
+/*
+ *  Start replay thread, looping over the file
+ */
+
+status_t ReplayFile::Start(enter_stream_hook func, void *arg, size_t buffer_size, bool real_time)
+{
+	Stop();
+	if (data_size == 0)
+		return B_ERROR;
+
+	hook = func;
+	hook_arg = arg;
+	buf_size = buffer_size & ~3;
+	if (buf_size == 0 || buf_size > data_size)
+		buf_size = data_size;
+	pace = real_time;
+	quit = false;
+
+	// Not real-time priority: the thread reads the mapped file and may take page faults
+	the_thread = spawn_thread(thread_entry, "QScope Replay", real_time ? B_URGENT_DISPLAY_PRIORITY : B_NORMAL_PRIORITY, this);
+	if (the_thread < 0)
+		return the_thread;
+	return resume_thread(the_thread);
+}
+
+
+/*
+ *  Stop replay thread
+ */
+
+void ReplayFile::Stop(void)
+{
+	if (the_thread >= 0) {
+		status_t l;
+		quit = true;
+		wait_for_thread(the_thread, &l);
+		the_thread = -1;
+	}
+}
+
+
+/*
+ *  Feed whole file once, as fast as possible, from the calling thread
+ *  Returns number of bytes processed
+ */
+
+size_t ReplayFile::Run(enter_stream_hook func, void *arg, size_t buffer_size)
+{
+	buffer_size &= ~3;
+	if (buffer_size == 0)
+		buffer_size = 4;
+
+	size_t ofs = 0;
+	while (ofs < data_size) {
+		size_t n = data_size - ofs;
+		if (n > buffer_size)
+			n = buffer_size;
+		func(arg, data + ofs, n, NULL);
+		ofs += n;
+	}
+	return ofs;
+}
+
+
+/*
+ *  Replay thread
+ */
+
+status_t ReplayFile::thread_entry(void *arg)
+{
+	((ReplayFile *)arg)->thread_func();
+	return 0;
+}
+
+void ReplayFile::thread_func(void)
+{
+	size_t ofs = 0;
+	int64 frames = 0;
+	bigtime_t start = system_time();
+
+	while (!quit) {
+		size_t n = data_size - ofs;
+		if (n > buf_size)
+			n = buf_size;
+
+		// Buffer is due when its last frame would have been recorded
+		frames += n >> 2;
+		if (pace)
+			snooze_until(start + bigtime_t(frames * 1E6 / rate), B_SYSTEM_TIMEBASE);
+
+		hook(hook_arg, data + ofs, n, NULL);
+
+		ofs += n;
+		if (ofs >= data_size)
+			ofs = 0;
+	}
+}
@@ -0,0 +1,49 @@
+/*
+ *  Replay.h - Feed WAV/raw captures into a stream function
+ *
+ *  Written in 2026 for QScope (original program by Christian Bauer)
+ */
+
+#ifndef __REPLAY_H__
+#define __REPLAY_H__
+
+#include <OS.h>
+
+#include "OldSubscriber.h"
+
+
+// Memory-mapped 16 bit stereo capture that is handed out in stream-sized buffers
+class ReplayFile {
+public:
+	ReplayFile();
+	~ReplayFile();
+
+	status_t Open(const char *path);
+	void Close(void);
+	size_t Size(void) {return data_size;}
+	float SampleRate(void) {return rate;}
+
+	status_t Start(enter_stream_hook func, void *arg, size_t buffer_size, bool real_time);
+	void Stop(void);
+	size_t Run(enter_stream_hook func, void *arg, size_t buffer_size);
+
+private:
+	static status_t thread_entry(void *arg);
+	void thread_func(void);
+
+	int fd;
+	char *map;				// Mapped file
+	size_t map_size;
+	char *data;				// Sample data in map
+	size_t data_size;		// Size of sample data in bytes (multiple of 4)
+	float rate;				// Sample rate from WAV header (44100 for raw files)
+
+	thread_id the_thread;	// Replay thread
+	volatile bool quit;		// Tell replay thread to quit
+	enter_stream_hook hook;	// Stream function and its argument
+	void *hook_arg;
+	size_t buf_size;		// Bytes handed out per call
+	bool pace;				// Replay in real time (or as fast as possible)
+};
+
+#endif
@@ -0,0 +1,1034 @@
+/*
+ *  ScopeEngine.cpp - Acquisition engine: views and subscriber
+ *
+ *  Split from QScope.cpp in 2026 (original program by Christian Bauer)
+ */
+
+#include <AppKit.h>
+#include <string.h>
+
+#include "ScopeEngine.h"
+
+
+/*
+ *  Subscriber constructor, the caller holds the first reference
+ */
+
+QScopeSubscriber::QScopeSubscriber(AutoSetupLooper *auto_setup, DistortionLooper *analyzer)
+{
+	ref_count = 1;
+	the_auto_setup = auto_setup;
+	the_analyzer = analyzer;
+
+	for (int i=0; i<MAX_VIEWS; i++)
+		views[i] = NULL;
+	view_mask = 0;
+
+	active_source = SOURCE_DAC;
+	reset_pending = 0;
+	busy = 0;
+	align_ring = new AlignRing(ALIGN_RING_FRAMES, SAMPLE_RATE);
+}
+
+
+/*
+ *  Subscriber destructor
+ */
+
+QScopeSubscriber::~QScopeSubscriber()
+{
+	delete align_ring;
+}
+
+
+/*
+ *  Drop reference, delete subscriber with the last one (sources must be stopped by then)
+ */
+
+void QScopeSubscriber::Release(void)
+{
+	if (atomic_add(&ref_count, -1) == 1)
+		delete this;
+}
+
+
+/*
+ *  Attach view, it starts with the next buffer. Returns false if there are too many views
+ */
+
+bool QScopeSubscriber::AddView(ScopeView *view)
+{
+	view_lock.Lock();
+	int i;
+	for (i=0; i<MAX_VIEWS; i++)
+		if (views[i] == NULL)
+			break;
+	if (i < MAX_VIEWS) {
+		views[i] = view;
+		atomic_set(&view->reset_pending, 1);
+		atomic_or(&view_mask, 1 << i);
+	}
+	view_lock.Unlock();
+	return i < MAX_VIEWS;
+}
+
+
+/*
+ *  Detach view, returns when the audio thread no longer uses it
+ */
+
+void QScopeSubscriber::RemoveView(ScopeView *view)
+{
+	view_lock.Lock();
+	for (int i=0; i<MAX_VIEWS; i++)
+		if (views[i] == view) {
+			atomic_and(&view_mask, ~(1 << i));
+			while (atomic_get(&busy))	// A buffer may still be running through it
+				snooze(1000);
+			views[i] = NULL;
+		}
+	view_lock.Unlock();
+}
+
+
+/*
+ *  Select source, takes effect with its next buffer
+ */
+
+void QScopeSubscriber::SetSource(int source)
+{
+	if (source == SOURCE_DUAL)
+		align_ring->Reset();
+	atomic_set(&active_source, source);
+	atomic_set(&reset_pending, 1);
+}
+
+
+/*
+ *  View constructor
+ */
+
+ScopeView::ScopeView(BLooper *looper, TraceRing *ring)
+{
+	write_slot = 0;
+	ready_slot = 1;
+	read_slot = 2;
+	new_settings.trigger_right = false;
+	new_settings.trigger_slope_neg = false;
+	new_settings.trigger_level = 0;
+	new_settings.hold_off = 0;
+	new_settings.trigger_mode = TRIGGER_LEVEL;
+	new_settings.generic_trigger = false;
+	new_settings.sweep_mode = SWEEP_NORMAL;
+	new_settings.sweep_count = 1;
+	new_settings.acquire_mode = ACQUIRE_PEAK;
+	new_settings.ac_left = new_settings.ac_right = false;
+	SetMath(MATH_OFF, MATH_FILTER_NONE, 0);
+	SetTimePerDiv(time_div_table[DEFAULT_TIME_DIV].time);
+
+	the_looper = looper;
+	the_ring = ring;
+	reset_pending = 1;
+	arrival_time = trigger_time = 0;
+
+	state = STATE_RECORD;
+
+	scope_counter = 0;
+	record_counter = 0;
+	sweep_start = -1;
+	column_pending = false;
+	next_frame = 0;
+	next_frac = 0;
+	old_input = 0;
+	left_min = right_min = 32767;
+	left_max = right_max = left_peak = right_peak = -32768;
+	math_min = 32767;
+	math_max = -32768;
+	math_last = 0;
+	math_pos = 0;
+	math_filter.z1 = math_filter.z2 = 0;
+	left_sum = right_sum = math_sum = 0;
+	column_frames = 0;
+	ac_left = ac_right = false;
+	couple_kernel = NULL;
+	dc_reset = true;
+	dc_left = dc_right = 0;
+
+	hold_off_counter = 0;
+	trigger_start_frame = 0;
+	trigger_total_frames = 0;
+
+	roll_mode = false;
+	accumulator = new SweepAccumulator(SCOPE_WIDTH * NUM_CHANNELS * 2);
+	apply_settings();
+}
+
+
+/*
+ *  View destructor (the view must be removed from the acquisition)
+ */
+
+ScopeView::~ScopeView()
+{
+	delete accumulator;
+}
+
+
+/*
+ *  Start over (new view or source), buf is the first buffer
+ */
+
+void ScopeView::reset(int16 *buf)
+{
+	state = STATE_HOLD_OFF;
+	hold_off_counter = 0;
+	scope_counter = 0;
+	record_counter = 0;
+	sweep_start = -1;
+	column_pending = false;
+	old_input = (trigger_right ? ac_right : ac_left) ? 0 : buf[trigger_right];	// A coupled channel starts at 0
+	dc_reset = true;
+	left_min = right_min = 32767;
+	left_max = right_max = left_peak = right_peak = -32768;
+	math_min = 32767;
+	math_max = -32768;
+	math_last = 0;
+	math_pos = 0;
+	math_filter.z1 = math_filter.z2 = 0;
+	trigger_start_frame = 0;
+	trigger_total_frames = 0;
+	accumulator->Reset();
+}
+
+
+/*
+ *  Set time per division
+ */
+
+static int64 gcd(int64 a, int64 b)
+{
+	while (b) {
+		int64 t = a % b;
+		a = b;
+		b = t;
+	}
+	return a;
+}
+
+void ScopeView::SetTimePerDiv(bigtime_t time)
+{
+	settings &s = new_settings;
+	s.time_per_div = time;
+
+	// Frames per scope_buf sample as exact ratio, so long sweeps don't drift
+	int64 num = time * int64(SAMPLE_RATE) * NUM_X_DIVS;
+	int64 den = 1000000LL * SCOPE_WIDTH;
+	int64 g = gcd(num, den);
+	num /= g;
+	den /= g;
+	s.frame_step = num / den;
+	s.frame_frac = num % den;
+	s.frame_den = den;
+	s.roll_mode = time >= ROLL_TIME_DIV;
+	SetHoldOff(s.hold_off);
+}
+
+
+/*
+ *  Set hold-off time
+ */
+
+void ScopeView::SetHoldOff(float hold)
+{
+	new_settings.hold_off = hold;
+	new_settings.hold_off_frames = int64(hold * new_settings.time_per_div * (SAMPLE_RATE / 1E6));
+	publish_settings();
+}
+
+
+/*
+ *  Set trigger parameters
+ */
+
+void ScopeView::SetTriggerMode(int mode)
+{
+	new_settings.trigger_mode = mode;
+	select_kernels();
+	publish_settings();
+}
+
+void ScopeView::SetTriggerChannel(bool right)
+{
+	new_settings.trigger_right = right;
+	select_kernels();
+	publish_settings();
+}
+
+void ScopeView::SetTriggerSlope(bool negative)
+{
+	new_settings.trigger_slope_neg = negative;
+	select_kernels();
+	publish_settings();
+}
+
+void ScopeView::SetTriggerLevel(int level)
+{
+	new_settings.trigger_level = level;
+	publish_settings();
+}
+
+
+/*
+ *  Use the trigger search that tests mode, channel and slope per sample
+ *  instead of the specialized ones (to compare with them)
+ */
+
+void ScopeView::SetGenericTrigger(bool generic)
+{
+	new_settings.generic_trigger = generic;
+	select_kernels();
+	publish_settings();
+}
+
+
+/*
+ *  Set math channel function and filter
+ */
+
+void ScopeView::SetMath(int op, int filter, float cutoff)
+{
+	settings &s = new_settings;
+	switch (filter) {
+		case MATH_FILTER_LOWPASS: BiquadDesign(&s.math_coeffs, BIQUAD_LOWPASS, cutoff, SAMPLE_RATE, M_SQRT1_2); break;
+		case MATH_FILTER_HIGHPASS: BiquadDesign(&s.math_coeffs, BIQUAD_HIGHPASS, cutoff, SAMPLE_RATE, M_SQRT1_2); break;
+		case MATH_FILTER_BANDPASS: BiquadDesign(&s.math_coeffs, BIQUAD_BANDPASS, cutoff, SAMPLE_RATE, M_SQRT1_2); break;
+	}
+
+	s.math_op = op;
+	s.math_filtered = op != MATH_OFF && filter != MATH_FILTER_NONE;
+	select_kernels();
+	publish_settings();
+}
+
+
+/*
+ *  Set AC or DC coupling of an input channel
+ */
+
+void ScopeView::SetCoupling(bool right, bool ac)
+{
+	if (right)
+		new_settings.ac_right = ac;
+	else
+		new_settings.ac_left = ac;
+	select_kernels();
+	publish_settings();
+}
+
+
+/*
+ *  Set acquisition mode
+ */
+
+void ScopeView::SetAcquireMode(int mode)
+{
+	new_settings.acquire_mode = mode;
+	select_kernels();
+	publish_settings();
+}
+
+
+/*
+ *  Select kernels once here instead of deciding per sample
+ */
+
+void ScopeView::select_kernels(void)
+{
+	settings &s = new_settings;
+	s.fold_kernel = fold_table[s.acquire_mode][s.math_op][s.math_filtered];
+	s.advance_kernel = s.math_filtered ? advance_table[s.math_op] : NULL;
+	s.couple_kernel = s.ac_left || s.ac_right ? couple_table[s.ac_left][s.ac_right] : NULL;
+	if (s.trigger_mode == TRIGGER_OFF)
+		s.trigger_kernel = NULL;
+	else if (s.generic_trigger)
+		s.trigger_kernel = find_trigger_generic;
+	else
+		s.trigger_kernel = trigger_table[s.trigger_mode == TRIGGER_PEAK][s.trigger_right][s.trigger_slope_neg];
+}
+
+
+/*
+ *  Set averaging or envelope mode, restarts it
+ */
+
+void ScopeView::SetSweepMode(int mode, int count)
+{
+	new_settings.sweep_mode = mode;
+	new_settings.sweep_count = count;
+	publish_settings();
+}
+
+
+/*
+ *  Hand copy of settings to the audio thread (window side)
+ */
+
+const int32 SETTINGS_NEW = 4;
+
+void ScopeView::publish_settings(void)
+{
+	settings_slot[write_slot] = new_settings;
+	write_slot = atomic_get_and_set(&ready_slot, write_slot | SETTINGS_NEW) & 3;
+}
+
+
+/*
+ *  Take over newest settings (audio thread side, only between sweeps)
+ */
+
+void ScopeView::apply_settings(void)
+{
+	if (!(atomic_get(&ready_slot) & SETTINGS_NEW))
+		return;
+	read_slot = atomic_get_and_set(&ready_slot, read_slot) & 3;
+	const settings &s = settings_slot[read_slot];
+
+	frame_step = s.frame_step;
+	frame_frac = s.frame_frac;
+	frame_den = s.frame_den;
+	hold_off_frames = s.hold_off_frames;
+	trigger_mode = s.trigger_mode;
+	trigger_right = s.trigger_right;
+	trigger_slope_neg = s.trigger_slope_neg;
+	trigger_level = s.trigger_level;
+	trigger_kernel = s.trigger_kernel;
+	acquire_mode = s.acquire_mode;
+	fold_kernel = s.fold_kernel;
+	advance_kernel = s.advance_kernel;
+	if (s.couple_kernel != couple_kernel)
+		dc_reset = true;
+	couple_kernel = s.couple_kernel;
+	ac_left = s.ac_left;
+	ac_right = s.ac_right;
+	math_filter.b0 = s.math_coeffs.b0;
+	math_filter.b1 = s.math_coeffs.b1;
+	math_filter.b2 = s.math_coeffs.b2;
+	math_filter.a1 = s.math_coeffs.a1;
+	math_filter.a2 = s.math_coeffs.a2;
+
+	// Leaving roll mode: start over with a triggered sweep
+	if (roll_mode && !s.roll_mode) {
+		state = STATE_HOLD_OFF;
+		hold_off_counter = 0;
+		scope_counter = 0;
+	}
+	roll_mode = s.roll_mode;
+
+	// Any change starts averaging over, roll mode shows every column as it comes
+	accumulator->SetMode(s.sweep_mode, s.sweep_count);
+	accumulate = s.sweep_mode != SWEEP_NORMAL && !roll_mode;
+}
+
+
+/*
+ *  Math channel kernels, one specialization per function/filter combination
+ */
+
+template <int OP> static inline int32 math_op(int16 left, int16 right)
+{
+	switch (OP) {	// Resolved at compile time
+		case MATH_ADD: return left + right;
+		case MATH_SUB: return left - right;
+		case MATH_MUL: return (left * right) >> 15;
+		case MATH_RIGHT: return right;
+		default: return left;
+	}
+}
+
+static inline int16 clip16(int32 x)
+{
+	return x > 32767 ? 32767 : (x < -32768 ? -32768 : x);
+}
+
+static inline int16 round_div(int32 sum, int n)
+{
+	return (sum + (sum < 0 ? -(n >> 1) : n >> 1)) / n;
+}
+
+// Search minimum and maximum of n frames of all channels (kept in locals so long folds run from registers)
+template <int OP, bool FILTER>
+void ScopeView::fold_peak(ScopeView *sub, int16 *p, int n)
+{
+	int16 l_min = sub->left_min, l_max = sub->left_max;
+	int16 r_min = sub->right_min, r_max = sub->right_max;
+	int16 m_min = sub->math_min, m_max = sub->math_max, m = sub->math_last;
+	biquad f = sub->math_filter;
+
+	for (; n>0; n--, p+=2) {
+		int16 left = p[0];
+		int16 right = p[1];
+		l_min = left < l_min ? left : l_min;
+		l_max = left > l_max ? left : l_max;
+		r_min = right < r_min ? right : r_min;
+		r_max = right > r_max ? right : r_max;
+		if (OP != MATH_OFF) {
+			if (FILTER)
+				m = clip16(int32(BiquadStep(f, math_op<OP>(left, right))));
+			else
+				m = clip16(math_op<OP>(left, right));
+			m_min = m < m_min ? m : m_min;
+			m_max = m > m_max ? m : m_max;
+		}
+	}
+
+	sub->left_min = l_min; sub->left_max = l_max;
+	sub->right_min = r_min; sub->right_max = r_max;
+	if (OP != MATH_OFF) {
+		sub->math_min = m_min; sub->math_max = m_max;
+		sub->math_last = m;
+	}
+	if (FILTER) {
+		sub->math_filter.z1 = f.z1;
+		sub->math_filter.z2 = f.z2;
+	}
+}
+
+// Sample mode keeps the frame the column starts with (set by start_column()), only the math channel takes its first frame here
+template <int OP, bool FILTER>
+void ScopeView::fold_sample(ScopeView *sub, int16 *p, int n)
+{
+	if (OP == MATH_OFF || n == 0)
+		return;
+	biquad f = sub->math_filter;
+	int16 m;
+	if (FILTER)
+		m = clip16(int32(BiquadStep(f, math_op<OP>(p[0], p[1]))));
+	else
+		m = clip16(math_op<OP>(p[0], p[1]));
+	if (sub->math_min > sub->math_max)
+		sub->math_min = sub->math_max = m;
+
+	// The filter still sees every frame
+	if (FILTER) {
+		for (n--, p+=2; n>0; n--, p+=2)
+			m = clip16(int32(BiquadStep(f, math_op<OP>(p[0], p[1]))));
+		sub->math_filter.z1 = f.z1;
+		sub->math_filter.z2 = f.z2;
+	}
+	sub->math_last = m;
+}
+
+// Sum n frames of all channels for the mean of the column
+template <int OP, bool FILTER>
+void ScopeView::fold_hires(ScopeView *sub, int16 *p, int n)
+{
+	int32 l_sum = sub->left_sum, r_sum = sub->right_sum, m_sum = sub->math_sum;
+	int16 m = sub->math_last;
+	biquad f = sub->math_filter;
+	sub->column_frames += n;
+
+	for (; n>0; n--, p+=2) {
+		int16 left = p[0];
+		int16 right = p[1];
+		l_sum += left;
+		r_sum += right;
+		if (OP != MATH_OFF) {
+			if (FILTER)
+				m = clip16(int32(BiquadStep(f, math_op<OP>(left, right))));
+			else
+				m = clip16(math_op<OP>(left, right));
+			m_sum += m;
+		}
+	}
+
+	sub->left_sum = l_sum;
+	sub->right_sum = r_sum;
+	if (OP != MATH_OFF) {
+		sub->math_sum = m_sum;
+		sub->math_last = m;
+	}
+	if (FILTER) {
+		sub->math_filter.z1 = f.z1;
+		sub->math_filter.z2 = f.z2;
+	}
+}
+
+// Run math filter over n frames that are not recorded, so it stays continuous
+template <int OP>
+void ScopeView::advance(ScopeView *sub, int16 *p, int n)
+{
+	biquad f = sub->math_filter;
+	float y = 0;
+	for (; n>0; n--, p+=2)
+		y = BiquadStep(f, math_op<OP>(p[0], p[1]));
+	sub->math_filter.z1 = f.z1;
+	sub->math_filter.z2 = f.z2;
+	sub->math_last = clip16(int32(y));
+}
+
+const ScopeView::fold_func ScopeView::fold_table[NUM_ACQUIRE_MODES][NUM_MATH_OPS][2] = {
+	{
+		{fold_peak<MATH_OFF, false>, fold_peak<MATH_OFF, false>},
+		{fold_peak<MATH_ADD, false>, fold_peak<MATH_ADD, true>},
+		{fold_peak<MATH_SUB, false>, fold_peak<MATH_SUB, true>},
+		{fold_peak<MATH_MUL, false>, fold_peak<MATH_MUL, true>},
+		{fold_peak<MATH_LEFT, false>, fold_peak<MATH_LEFT, true>},
+		{fold_peak<MATH_RIGHT, false>, fold_peak<MATH_RIGHT, true>}
+	}, {
+		{fold_sample<MATH_OFF, false>, fold_sample<MATH_OFF, false>},
+		{fold_sample<MATH_ADD, false>, fold_sample<MATH_ADD, true>},
+		{fold_sample<MATH_SUB, false>, fold_sample<MATH_SUB, true>},
+		{fold_sample<MATH_MUL, false>, fold_sample<MATH_MUL, true>},
+		{fold_sample<MATH_LEFT, false>, fold_sample<MATH_LEFT, true>},
+		{fold_sample<MATH_RIGHT, false>, fold_sample<MATH_RIGHT, true>}
+	}, {
+		{fold_hires<MATH_OFF, false>, fold_hires<MATH_OFF, false>},
+		{fold_hires<MATH_ADD, false>, fold_hires<MATH_ADD, true>},
+		{fold_hires<MATH_SUB, false>, fold_hires<MATH_SUB, true>},
+		{fold_hires<MATH_MUL, false>, fold_hires<MATH_MUL, true>},
+		{fold_hires<MATH_LEFT, false>, fold_hires<MATH_LEFT, true>},
+		{fold_hires<MATH_RIGHT, false>, fold_hires<MATH_RIGHT, true>}
+	}
+};
+
+const ScopeView::fold_func ScopeView::advance_table[NUM_MATH_OPS] = {
+	NULL,
+	advance<MATH_ADD>,
+	advance<MATH_SUB>,
+	advance<MATH_MUL>,
+	advance<MATH_LEFT>,
+	advance<MATH_RIGHT>
+};
+
+
+/*
+ *  AC coupling kernels: the DC estimate follows each coupled channel with
+ *  weight 2^-DC_BLOCK_SHIFT per frame and is subtracted from it, the other
+ *  channel is copied
+ */
+
+static inline int16 dc_block(int16 x, int32 &dc)
+{
+	dc += ((int32(x) << DC_BLOCK_FRAC) - dc) >> DC_BLOCK_SHIFT;
+	return clip16(x - ((dc + (1 << (DC_BLOCK_FRAC - 1))) >> DC_BLOCK_FRAC));
+}
+
+template <bool LEFT, bool RIGHT>
+void ScopeView::couple(ScopeView *sub, const int16 *p, int n)
+{
+	if (sub->dc_reset) {	// Start from the first frame, so there is no step
+		sub->dc_left = int32(p[0]) << DC_BLOCK_FRAC;
+		sub->dc_right = int32(p[1]) << DC_BLOCK_FRAC;
+		sub->dc_reset = false;
+	}
+	int32 l = sub->dc_left, r = sub->dc_right;
+	int16 *q = sub->coupled_buf;
+	for (; n>0; n--, p+=2, q+=2) {
+		q[0] = LEFT ? dc_block(p[0], l) : p[0];
+		q[1] = RIGHT ? dc_block(p[1], r) : p[1];
+	}
+	sub->dc_left = l;
+	sub->dc_right = r;
+}
+
+const ScopeView::couple_func ScopeView::couple_table[2][2] = {	// [left][right]
+	{NULL, couple<false, true>},
+	{couple<true, false>, couple<true, true>}
+};
+
+
+/*
+ *  Trigger search over frames i..count-1, returns the frame of the trigger
+ *  or count if there is none. old_input follows the frames before the trigger
+ */
+
+// Level crossed between two frames
+template <bool NEG> static inline bool crosses(int16 old, int16 input, int level)
+{
+	return NEG ? (input < level && old > level) : (input > level && old < level);
+}
+
+// One specialization per mode, channel and slope. Frames are tested in blocks
+// of 8 without early exit and against their predecessor in the buffer instead
+// of a value carried from frame to frame, so the compiler can vectorize the test
+template <int MODE, bool RIGHT, bool NEG>
+int ScopeView::find_trigger(ScopeView *sub, int16 *buf, int i, int count)
+{
+	const int16 *p = buf + RIGHT;
+	int start = i;
+	if (MODE == TRIGGER_PEAK) {
+		int16 compare = (RIGHT ? sub->right_peak : sub->left_peak) - 256;
+		for (; i+8<=count; i+=8) {
+			int hit = 0;
+			for (int k=0; k<8; k++)
+				hit |= p[(i + k) << 1] >= compare;
+			if (hit)
+				break;
+		}
+		for (; i<count; i++)
+			if (p[i << 1] >= compare)
+				break;
+	} else {
+		int level = sub->trigger_level;
+		if (i < count && !crosses<NEG>(sub->old_input, p[i << 1], level)) {
+			for (i++; i+8<=count; i+=8) {
+				int hit = 0;
+				for (int k=0; k<8; k++)
+					hit |= crosses<NEG>(p[(i + k - 1) << 1], p[(i + k) << 1], level);
+				if (hit)
+					break;
+			}
+			for (; i<count; i++)
+				if (crosses<NEG>(p[(i - 1) << 1], p[i << 1], level))
+					break;
+		}
+	}
+	if (i > start)
+		sub->old_input = p[(i - 1) << 1];
+	return i;
+}
+
+const ScopeView::trigger_func ScopeView::trigger_table[2][2][2] = {	// [peak][right][negative slope]
+	{{find_trigger<TRIGGER_LEVEL, false, false>, find_trigger<TRIGGER_LEVEL, false, true>},
+	 {find_trigger<TRIGGER_LEVEL, true, false>, find_trigger<TRIGGER_LEVEL, true, true>}},
+	{{find_trigger<TRIGGER_PEAK, false, false>, find_trigger<TRIGGER_PEAK, false, false>},
+	 {find_trigger<TRIGGER_PEAK, true, false>, find_trigger<TRIGGER_PEAK, true, false>}}
+};
+
+// Deciding on mode, channel and slope at run time (reference for the benchmark)
+int ScopeView::find_trigger_generic(ScopeView *sub, int16 *buf, int i, int count)
+{
+	for (; i<count; i++) {
+		int16 input = buf[(i << 1) + sub->trigger_right];
+		if (sub->trigger_mode == TRIGGER_PEAK) {
+			if (input >= int16((sub->trigger_right ? sub->right_peak : sub->left_peak) - 256))
+				break;
+		} else if (sub->trigger_slope_neg) {
+			if (input < sub->trigger_level && sub->old_input > sub->trigger_level)
+				break;
+		} else {
+			if (input > sub->trigger_level && sub->old_input < sub->trigger_level)
+				break;
+		}
+		sub->old_input = input;
+	}
+	return i;
+}
+
+
+/*
+ *  Process buffer of given source (count in bytes, time of the first frame);
+ *  buffers of other sources are ignored. During a switch the old and new
+ *  source may overlap for a moment, a buffer arriving while another one is
+ *  being processed is dropped instead of waited for. In dual mode, DAC and
+ *  ADC buffers go to the align ring and whichever stream completes frames
+ *  processes them in place.
+ */
+
+void QScopeSubscriber::Feed(int source, int16 *buf, size_t count, bigtime_t time)
+{
+	bigtime_t arrival = system_time();
+	int active = atomic_get(&active_source);
+	if (active == SOURCE_DUAL && (source == SOURCE_DAC || source == SOURCE_ADC))
+		align_ring->Put(source == SOURCE_ADC, buf, count >> 2, time);
+	else if (active != source || count < 4)
+		return;
+
+	if (atomic_or(&busy, 1))
+		return;
+	if (active == SOURCE_DUAL) {
+		int16 *p;
+		int n;
+		while ((n = align_ring->Get(&p)) > 0) {
+			process(p, n, arrival);
+			align_ring->Consume(n);
+		}
+	} else if (atomic_get(&active_source) == source)
+		process(buf, count >> 2, arrival);
+	atomic_set(&busy, 0);
+}
+
+
+/*
+ *  Run frames through the analysis loopers and all views (arrival: system_time() of the buffer's arrival)
+ */
+
+void QScopeSubscriber::process(int16 *buf, int frames, bigtime_t arrival)
+{
+	bool source_changed = atomic_get_and_set(&reset_pending, 0);
+	if (the_analyzer != NULL)
+		the_analyzer->Capture(buf, frames);
+
+	// Auto setup analyses the input as the first view (the main window's) sees it, coupled
+	int32 mask = atomic_get(&view_mask);
+	if (!(mask & 1))
+		the_auto_setup->Capture(buf, frames);
+	for (int i=0; i<MAX_VIEWS; i++)
+		if (mask & (1 << i)) {
+			ScopeView *view = views[i];
+			if (atomic_get_and_set(&view->reset_pending, 0) || source_changed) {
+				view->apply_settings();
+				view->reset(buf);
+			}
+			view->arrival_time = arrival;
+			view->acquire(buf, frames, i == 0 ? the_auto_setup : NULL);
+		}
+}
+
+
+/*
+ *  Stream function for file replay
+ */
+
+bool QScopeSubscriber::stream_func(void *arg, char *buf, size_t count, void *header)
+{
+	((QScopeSubscriber *)arg)->Feed(SOURCE_FILE, (int16 *)buf, count, 0);
+	return true;
+}
+
+
+/*
+ *  Run one buffer through the view; with AC coupling it goes through the DC
+ *  blocker into coupled_buf first, piece by piece (the view gives the same
+ *  sweeps for any division into buffers). The coupling is that of the start
+ *  of the buffer, settings applied by scope_func() change it from the next
+ *  buffer on. The frames as the view sees them also go to auto setup, if given
+ */
+
+void ScopeView::acquire(int16 *buf, int frames, AutoSetupLooper *auto_setup)
+{
+	couple_func kernel = couple_kernel;
+	if (kernel == NULL) {
+		if (auto_setup != NULL)
+			auto_setup->Capture(buf, frames);
+		scope_func(buf, frames << 2);
+		return;
+	}
+
+	while (frames > 0) {
+		int n = frames < COUPLE_FRAMES ? frames : COUPLE_FRAMES;
+		kernel(this, buf, n);
+		if (auto_setup != NULL)
+			auto_setup->Capture(coupled_buf, n);
+		scope_func(coupled_buf, n << 2);
+		buf += n * 2;
+		frames -= n;
+	}
+
+	// The old kernel may have used up the reset meant for the new one
+	if (couple_kernel != kernel)
+		dc_reset = true;
+}
+
+
+/*
+ *  Hold-off, trigger search and recording for one buffer
+ */
+
+void ScopeView::scope_func(int16 *buf, size_t count)
+{
+	// Number of sample frames in input buffer
+	count >>= 2;
+
+	// New settings take effect between sweeps (or between buffers in roll mode), so no trace is mixed
+	if (state != STATE_RECORD || roll_mode)
+		apply_settings();
+
+	// Roll mode records continuously, without trigger or hold-off
+	if (roll_mode && state != STATE_RECORD) {
+		state = STATE_RECORD;
+		scope_counter = 0;
+		record_counter = 0;
+		next_frame = frame_step;
+		next_frac = frame_frac;
+		start_column(buf, 0);
+	}
+
+	// Act according to current state
+	switch (state) {
+		case STATE_HOLD_OFF:	// Wait before next trigger
+hold_off:
+			if (hold_off_counter >= count) {
+
+				// Still waiting
+				hold_off_counter -= count;
+
+			} else {
+
+				// Time elapsed, now search for trigger level (or start recording if not triggered)
+				if (trigger_mode != TRIGGER_OFF) {
+					state = STATE_WAIT_FOR_TRIGGER;
+					trigger_start_frame = int(hold_off_counter);
+					trigger_total_frames = 0;
+					goto wait_for_trigger;
+				} else {
+					state = STATE_RECORD;
+					trigger_time = system_time();
+					record_counter = sweep_start = int(hold_off_counter);
+					next_frame = record_counter + frame_step;
+					next_frac = frame_frac;
+					start_column(buf, record_counter);
+					goto record;
+				}
+			}
+			break;
+
+		case STATE_WAIT_FOR_TRIGGER: {	// Search for trigger level
+wait_for_trigger:
+
+			// Trigger anyway after 1/30s, counted in frames so it doesn't depend on the buffer size
+			int end = count;
+			int left = int(SAMPLE_RATE / 30) - trigger_total_frames;
+			if (end - trigger_start_frame > left)
+				end = trigger_start_frame + left;
+			int i = trigger_kernel(this, buf, trigger_start_frame, end);
+			if (i == count) {
+				trigger_total_frames += count - trigger_start_frame;
+				trigger_start_frame = 0;
+				break;
+			}
+			if (i < end)
+				old_input = buf[(i << 1) + trigger_right];
+
+			state = STATE_RECORD;
+			trigger_time = system_time();
+			record_counter = sweep_start = i;
+			next_frame = i + frame_step;
+			next_frac = frame_frac;
+			start_column(buf, i);
+			left_peak = right_peak = -32768;
+			goto record;
+		}
+
+		case STATE_RECORD: {	// Get samples and stuff them into the trace ring
+record:
+			if (column_pending)
+				start_column(buf, 0);
+			int next = next_frame;
+			bool reaches_next_frame = true;
+			if (next > count) {
+				next = count;
+				reaches_next_frame = false;
+			}
+
+			// Catch up math filter on frames skipped by hold-off and trigger search
+			if (advance_kernel != NULL && math_pos < record_counter)
+				advance_kernel(this, buf + (math_pos << 1), record_counter - math_pos);
+
+			// Fold frames into the column (minimum and maximum, first frame or sum, depending on the mode)
+			fold_kernel(this, buf + (record_counter << 1), next - record_counter);
+			math_pos = next;
+
+			if (reaches_next_frame) {
+
+				// High resolution shows the mean (a column without frames keeps the frame it started with)
+				if (acquire_mode == ACQUIRE_HIRES && column_frames > 0) {
+					left_min = left_max = round_div(left_sum, column_frames);
+					right_min = right_max = round_div(right_sum, column_frames);
+					math_min = math_max = round_div(math_sum, column_frames);
+				}
+
+				// Peak levels for peak trigger
+				if (left_max > left_peak)
+					left_peak = left_max;
+				if (right_max > right_peak)
+					right_peak = right_max;
+
+				// Record one column
+				if (math_min > math_max)	// No new frame in this column
+					math_min = math_max = math_last;
+				int16 column[NUM_CHANNELS * 2] = {left_max, left_min, right_max, right_min, math_max, math_min};
+				if (accumulate)
+					memcpy(sweep_buf + scope_counter * NUM_CHANNELS * 2, column, sizeof(column));
+				else
+					the_ring->PutColumn(column);
+
+				if (roll_mode) {
+
+					// Every column goes to the screen immediately
+					if (the_ring->Notify())
+						the_looper->PostMessage(MSG_NEW_BUFFER);
+
+				} else if (++scope_counter == SCOPE_WIDTH) {
+
+					// Sweep complete? Then notify looper (every sweep is accumulated, whether it is drawn or not)
+					scope_counter = 0;
+					if (accumulate) {
+						const int16 *p = accumulator->Add(sweep_buf);
+						for (int x=0; x<SCOPE_WIDTH; x++, p+=NUM_CHANNELS*2)
+							the_ring->PutColumn(p);
+					}
+					trace_stamps stamps = {arrival_time, trigger_time, system_time()};
+					the_ring->EndTrace(&stamps);
+					if (the_ring->Notify())
+						the_looper->PostMessage(MSG_NEW_BUFFER);
+
+					// New settings take effect here as well, the next sweep may start in this buffer
+					state = STATE_HOLD_OFF;
+					apply_settings();
+					if (roll_mode) {	// Rolling starts with the next buffer
+						record_counter = 0;
+						sweep_start = -1;
+						break;
+					}
+
+					// A sweep shorter than a frame ends on the frame it started with, free run or
+					// peak trigger would start the next one there again, forever
+					hold_off_counter = hold_off_frames + next_frame;
+					if (next_frame == sweep_start)
+						hold_off_counter++;
+					goto hold_off;
+				}
+
+				// Advance to next frame
+				record_counter = next;
+				next_frame += frame_step;
+				next_frac += frame_frac;
+				if (next_frac >= frame_den) {
+					next_frac -= frame_den;
+					next_frame++;
+				}
+				if (record_counter < count) {
+					start_column(buf, record_counter);
+					goto record;
+				} else {
+
+					// Input buffer used up, the column is started with the next one
+					column_pending = true;
+					record_counter = 0;
+					sweep_start = -1;
+					next_frame -= count;
+				}
+
+			} else {
+
+				// Input buffer used up
+				record_counter = 0;
+				sweep_start = -1;
+				next_frame -= count;
+			}
+			break;
+		}
+	}
+
+	// Keep math filter running through the rest of the buffer
+	if (advance_kernel != NULL && math_pos < count)
+		advance_kernel(this, buf + (math_pos << 1), count - math_pos);
+	math_pos = 0;
+}
+
+
+/*
+ *  Start new column with given frame
+ */
+
+void ScopeView::start_column(int16 *buf, int frame)
+{
+	left_min = left_max = buf[frame << 1];
+	right_min = right_max = buf[(frame << 1) + 1];
+	math_min = 32767;
+	math_max = -32768;
+	left_sum = right_sum = math_sum = 0;
+	column_frames = 0;
+	column_pending = false;
+}
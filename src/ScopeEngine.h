@@ -0,0 +1,321 @@
+/*
+ *  ScopeEngine.h - Acquisition engine (views and subscriber) and beam mapping
+ *
+ *  Split from QScope.cpp in 2026 (original program by Christian Bauer),
+ *  shared by QScope and QScopeBench
+ */
+
+#ifndef __SCOPE_ENGINE_H__
+#define __SCOPE_ENGINE_H__
+
+#include <AppKit.h>
+#include <math.h>
+
+#include "AutoSetup.h"
+#include "TraceRing.h"
+#include "Biquad.h"
+#include "AlignRing.h"
+#include "Distortion.h"
+#include "SweepAccumulator.h"
+#include "BeamRaster.h"
+
+
+// Constants
+const uint32 MSG_NEW_BUFFER = 'nbuf';	// Sweep in the ring (to the view's looper)
+
+const int SCOPE_WIDTH = 320;	// Scope grid parameters
+const int SCOPE_HEIGHT = 256;
+const int NUM_X_DIVS = 10;
+const int NUM_Y_DIVS = 8;
+const int TICKS_PER_DIV = 5;
+
+const float SAMPLE_RATE = 44100.0;
+const size_t REPLAY_BUFFER_SIZE = 4096;	// Default bytes per buffer for file replay
+
+const int NUM_CHANNELS = 3;	// Left, right, math
+
+struct time_div_step {	// Time/div. settings, in order of the popup menu
+	bigtime_t time;		// Time per division in microseconds
+	const char *label;
+};
+
+const time_div_step time_div_table[] = {
+	{1, "1µs"}, {2, "2µs"}, {5, "5µs"},
+	{10, "10µs"}, {20, "20µs"}, {50, "50µs"},
+	{100, "0.1ms"}, {200, "0.2ms"}, {500, "0.5ms"},
+	{1000, "1ms"}, {2000, "2ms"}, {5000, "5ms"},
+	{10000, "10ms"}, {20000, "20ms"}, {50000, "50ms"},
+	{100000, "0.1s"}, {200000, "0.2s"}, {500000, "0.5s"},
+	{1000000, "1s"}, {2000000, "2s"}, {5000000, "5s"}
+};
+const int NUM_TIME_DIVS = sizeof(time_div_table) / sizeof(time_div_step);
+const int DEFAULT_TIME_DIV = 10;	// 2ms
+const bigtime_t ROLL_TIME_DIV = 100000;	// Roll mode from 0.1s/div on
+
+enum {	// Subscriber states
+	STATE_HOLD_OFF,
+	STATE_WAIT_FOR_TRIGGER,
+	STATE_RECORD
+};
+
+enum {	// Input sources, in order of the stream popup
+	SOURCE_DAC,
+	SOURCE_ADC,
+	SOURCE_DUAL,	// Left channels of DAC and ADC as left/right
+	SOURCE_FILE,
+	SOURCE_SYNTH
+};
+
+const int SYNTH_PERIOD = 256;	// Default frames per generator callback
+
+const int ALIGN_RING_FRAMES = 16384;	// Allowed offset between DAC and ADC buffers in dual mode
+
+enum {	// Trigger modes
+	TRIGGER_OFF,
+	TRIGGER_LEVEL,
+	TRIGGER_PEAK
+};
+
+enum {	// Math channel functions, in order of the menu
+	MATH_OFF,
+	MATH_ADD,
+	MATH_SUB,
+	MATH_MUL,
+	MATH_LEFT,
+	MATH_RIGHT,
+	NUM_MATH_OPS
+};
+
+enum {	// Math channel filters, in order of the menu
+	MATH_FILTER_NONE,
+	MATH_FILTER_LOWPASS,
+	MATH_FILTER_HIGHPASS,
+	MATH_FILTER_BANDPASS,
+	NUM_MATH_FILTERS
+};
+
+const int NUM_MATH_CUTOFFS = 7;
+const float math_cutoff_table[NUM_MATH_CUTOFFS] = {
+	30, 100, 300, 1000, 3000, 10000, 15000
+};
+const int DEFAULT_MATH_CUTOFF = 3;
+
+enum {	// Acquisition modes (what a column shows of its frames), in order of the menu
+	ACQUIRE_PEAK,		// Minimum and maximum
+	ACQUIRE_SAMPLE,		// First frame
+	ACQUIRE_HIRES,		// Mean
+	NUM_ACQUIRE_MODES
+};
+
+const int DC_BLOCK_SHIFT = 11;	// AC coupling: one-pole high pass, about 3.4Hz at 44.1kHz
+const int DC_BLOCK_FRAC = 14;	// Fraction bits of the DC estimate
+const int COUPLE_FRAMES = 1024;	// AC coupled frames per piece
+
+const int NUM_BEAM_WIDTHS = 5;
+const int32 beam_width_table[NUM_BEAM_WIDTHS] = {	// In 1/256 pixels
+	256, 384, 512, 768, 1024
+};
+const int DEFAULT_BEAM_WIDTH = 1;
+
+// Screen mapping of one trace, set up once per drawing: position in 1/256 pixels = base - (value * scale >> 16)
+struct beam_map {
+	int32 base;
+	int32 scale;
+};
+
+// Full scale (at gain 1) spans y_height, offset moves the trace by divisions of its height
+static inline void set_beam_map(beam_map *m, int y_offset, int y_height, float gain, float offset)
+{
+	m->scale = int32(gain * y_height * BEAM_SUBPIXEL * 65536.0 / 65533 + 0.5);
+	m->base = int32(floor((y_offset - offset * y_height / NUM_Y_DIVS) * BEAM_SUBPIXEL + 0.5));
+}
+
+static inline int32 beam_y(int16 y, const beam_map &m)
+{
+	return m.base - int32((int64(y) * m.scale) >> 16);
+}
+
+// Draw one column of the beam (y1 maximum, y2 minimum), connected to the previous column
+static inline void draw_beam(BeamRaster *beam, int x, int16 old_y1, int16 old_y2, int16 y1, int16 y2, const beam_map &m)
+{
+	if (y1 > old_y1 && y2 > old_y1)
+		y2 = old_y1;
+	if (y1 < old_y2 && y2 < old_y2)
+		y1 = old_y2;
+	beam->Column(x, beam_y(y1, m), beam_y(y2, m));
+}
+
+
+// One view of the acquisition, with its own trigger, time base and math channel; sweeps go to its ring
+class ScopeView {
+public:
+	ScopeView(BLooper *looper, TraceRing *ring);
+	~ScopeView();
+	void SetTimePerDiv(bigtime_t time);
+	void SetTriggerMode(int mode);
+	void SetTriggerChannel(bool right);
+	void SetTriggerSlope(bool negative);
+	void SetTriggerLevel(int level);
+	void SetHoldOff(float time);
+	void SetMath(int op, int filter, float cutoff);
+	void SetCoupling(bool right, bool ac);
+	void SetAcquireMode(int mode);
+	void SetSweepMode(int mode, int count);
+	void SetGenericTrigger(bool generic);
+
+private:
+	friend class QScopeSubscriber;	// Runs the view on the audio thread
+
+	typedef void (*fold_func)(ScopeView *sub, int16 *p, int n);
+	typedef int (*trigger_func)(ScopeView *sub, int16 *buf, int i, int count);
+	typedef void (*couple_func)(ScopeView *sub, const int16 *p, int n);
+
+	// Settings block, written by the window and copied by the audio thread between sweeps
+	struct settings {
+		bigtime_t time_per_div;		// Time per division in microseconds
+		int frame_step, frame_frac, frame_den;	// Sample frames per column as exact ratio
+		bool roll_mode;				// Record continuously and deliver every column
+		float hold_off;				// Hold-off time in multiples of the time/div time
+		int64 hold_off_frames;		// Number of sample frames to hold off
+		int trigger_mode;			// Trigger mode (TRIGGER_...)
+		bool trigger_right;			// Trigger on right channel
+		bool trigger_slope_neg;		// Trigger on negative slope
+		int trigger_level;			// Trigger level
+		bool generic_trigger;		// Trigger search not specialized (benchmark reference)
+		trigger_func trigger_kernel;	// Trigger search for mode, channel and slope
+		int math_op;				// Math channel function (MATH_...)
+		bool math_filtered;			// Math channel filter on
+		int acquire_mode;			// What a column shows (ACQUIRE_...)
+		fold_func fold_kernel;		// Kernels for acquisition mode and math channel
+		fold_func advance_kernel;
+		biquad math_coeffs;			// Math filter coefficients (state unused)
+		bool ac_left, ac_right;		// AC coupling of the inputs
+		couple_func couple_kernel;	// DC blocker for the AC coupled channels (NULL if none)
+		int sweep_mode;				// Averaging or envelope (SWEEP_...)
+		int sweep_count;			// Sweeps averaged
+	};
+
+
+	void select_kernels(void);
+	void publish_settings(void);
+	void apply_settings(void);
+	void reset(int16 *buf);
+
+	void acquire(int16 *buf, int frames, AutoSetupLooper *auto_setup);
+	void scope_func(int16 *buf, size_t count);
+	void start_column(int16 *buf, int frame);
+
+	template <int OP, bool FILTER> static void fold_peak(ScopeView *sub, int16 *p, int n);
+	template <int OP, bool FILTER> static void fold_sample(ScopeView *sub, int16 *p, int n);
+	template <int OP, bool FILTER> static void fold_hires(ScopeView *sub, int16 *p, int n);
+	template <int OP> static void advance(ScopeView *sub, int16 *p, int n);
+	template <bool LEFT, bool RIGHT> static void couple(ScopeView *sub, const int16 *p, int n);
+	template <int MODE, bool RIGHT, bool NEG> static int find_trigger(ScopeView *sub, int16 *buf, int i, int count);
+	static int find_trigger_generic(ScopeView *sub, int16 *buf, int i, int count);
+	static const fold_func fold_table[NUM_ACQUIRE_MODES][NUM_MATH_OPS][2];
+	static const fold_func advance_table[NUM_MATH_OPS];
+	static const trigger_func trigger_table[2][2][2];
+	static const couple_func couple_table[2][2];
+
+	BLooper *the_looper;
+	TraceRing *the_ring;	// Receives min/max columns for left/right/math channels
+	int32 reset_pending;	// New view or source, start over with next buffer
+	bigtime_t arrival_time;	// When the buffer being processed arrived
+	bigtime_t trigger_time;	// When the current sweep was triggered
+
+	// Triple buffer of settings: the window fills write_slot and exchanges it
+	// with ready_slot, the audio thread exchanges read_slot with ready_slot if
+	// SETTINGS_NEW is set. Neither side ever waits for the other.
+	settings new_settings;		// Current settings of the window side
+	settings settings_slot[3];
+	int write_slot;				// Owned by window
+	int32 ready_slot;			// Shared: slot index | SETTINGS_NEW
+	int read_slot;				// Owned by audio thread
+
+	int state;				// Current state (STATE_...)
+	bool roll_mode;			// Record continuously and deliver every column
+
+	int scope_counter;				// Number of columns recorded in current sweep
+	int record_counter;				// Current sample frame index in input buffer
+	int sweep_start;				// Frame the current sweep started with (-1: in an earlier buffer)
+	bool column_pending;			// Next column starts with the first frame of the next buffer
+	int next_frame;					// Next sample frame in input buffer (integer part)
+	int next_frac;					// Fractional part of next_frame, in units of 1/frame_den
+	int frame_step;					// Added to next_frame for each column (integer part)
+	int frame_frac;					// Fractional part of frame_step, in units of 1/frame_den
+	int frame_den;					// Denominator of the fractional parts
+	int16 old_input;				// Previous input for trigger slope detection
+	int16 left_min, left_max;		// Current minimum/maximum sample elongation
+	int16 right_min, right_max;		// Current minimum/maximum sample elongation
+	int16 left_peak, right_peak;	// Peak levels found during recording
+	int acquire_mode;				// What a column shows (ACQUIRE_...)
+	int32 left_sum, right_sum, math_sum;	// Sums over the current column (high resolution)
+	int column_frames;				// Frames summed
+
+	fold_func fold_kernel;		// Folds a range of frames into the column, specialized for acquisition mode and math function
+	fold_func advance_kernel;	// Runs math filter over frames not recorded (NULL if no filter)
+	int math_pos;				// Frames of current input buffer seen by math filter
+	int16 math_min, math_max;	// Current minimum/maximum of math channel (min > max: no frame yet)
+	int16 math_last;			// Last math channel value
+	biquad math_filter;			// Filter applied to math channel
+
+	bool ac_left, ac_right;		// AC coupling of the inputs
+	couple_func couple_kernel;	// Removes DC from AC coupled channels into coupled_buf (NULL if none)
+	bool dc_reset;				// DC estimate starts from the next frame
+	int32 dc_left, dc_right;	// DC estimate of each channel, DC_BLOCK_FRAC fraction bits
+	int16 coupled_buf[COUPLE_FRAMES * 2];	// Input with DC removed (the input buffer itself is shared)
+
+	int64 hold_off_frames;		// Number of sample frames to hold off
+	int64 hold_off_counter;		// Counter for remaining number of sample frames to wait
+
+	int trigger_start_frame;	// First sample frame index for trigger
+	int trigger_total_frames;	// Total number of frames waited for trigger
+	int trigger_mode;			// Trigger mode (TRIGGER_...)
+	bool trigger_right;			// Trigger on right channel
+	bool trigger_slope_neg;		// Trigger on negative slope
+	int trigger_level;			// Trigger level
+	trigger_func trigger_kernel;	// Searches trigger, specialized for mode, channel and slope (NULL if off)
+
+	bool accumulate;			// Columns go to sweep_buf, the accumulated sweep to the ring
+	int16 sweep_buf[SCOPE_WIDTH * NUM_CHANNELS * 2];	// Columns of the current sweep
+	SweepAccumulator *accumulator;
+};
+
+
+// QScope acquisition engine, fed by one of several sources. Every buffer
+// is handed in place to all views (the source's own buffer, or the align
+// ring in dual mode), so a view costs its own decimation and nothing else.
+// Shared by the windows showing its views, the last Release() deletes it.
+const int MAX_VIEWS = 8;	// Views per acquisition
+
+class QScopeSubscriber {
+public:
+	QScopeSubscriber(AutoSetupLooper *auto_setup, DistortionLooper *analyzer);
+	void Acquire(void) {atomic_add(&ref_count, 1);}
+	void Release(void);
+	bool AddView(ScopeView *view);
+	void RemoveView(ScopeView *view);
+	void SetSource(int source);
+
+	void Feed(int source, int16 *buf, size_t count, bigtime_t time);
+	static bool stream_func(void *arg, char *buf, size_t count, void *header);
+
+private:
+	~QScopeSubscriber();
+	void process(int16 *buf, int frames, bigtime_t arrival);
+
+	int32 ref_count;
+	AutoSetupLooper *the_auto_setup;
+	DistortionLooper *the_analyzer;	// May be NULL
+
+	BLocker view_lock;		// Serializes AddView()/RemoveView() of several windows
+	ScopeView *views[MAX_VIEWS];
+	int32 view_mask;		// Bit per entry of views[] in use, read by the audio thread
+
+	int32 active_source;	// Only buffers from this source are processed (SOURCE_...)
+	int32 reset_pending;	// Source changed, start over with next buffer
+	int32 busy;				// A source is inside Feed()
+	AlignRing *align_ring;	// Pairs DAC and ADC frames for SOURCE_DUAL
+};
+
+#endif
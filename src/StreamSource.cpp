@@ -0,0 +1,64 @@
+/*
+ *  StreamSource.cpp - ADC/DAC stream source
+ *
+ *  Written in 2026 for QScope (original program by Christian Bauer)
+ */
+
+#include <SupportDefs.h>
+
+#include "StreamSource.h"
+
+
+/*
+ *  Stream source constructor
+ */
+
+StreamSource::StreamSource(BAbstractBufferStream *stream) : BSubscriber("QScope")
+{
+	the_stream = stream;
+	entered = false;
+}
+
+
+/*
+ *  Stream source destructor
+ */
+
+StreamSource::~StreamSource()
+{
+	Stop();
+}
+
+
+/*
+ *  Subscribe to audio stream
+ */
+
+status_t StreamSource::Start(enter_stream_hook func, void *arg)
+{
+	Stop();
+	status_t err = Subscribe(the_stream);
+	if (err != B_NO_ERROR)
+		return err;
+	err = EnterStream(NULL, false, arg, func, NULL, true);
+	if (err != B_NO_ERROR) {
+		Unsubscribe();
+		return err;
+	}
+	entered = true;
+	return B_NO_ERROR;
+}
+
+
+/*
+ *  Unsubscribe from audio stream
+ */
+
+void StreamSource::Stop(void)
+{
+	if (entered) {
+		ExitStream(true);
+		Unsubscribe();
+		entered = false;
+	}
+}
@@ -0,0 +1,27 @@
+/*
+ *  StreamSource.h - ADC/DAC stream source
+ *
+ *  Written in 2026 for QScope (original program by Christian Bauer)
+ */
+
+#ifndef __STREAM_SOURCE_H__
+#define __STREAM_SOURCE_H__
+
+#include "AudioSource.h"
+
+
+// Subscriber of one of the audio streams
+class StreamSource : public AudioSource, public BSubscriber {
+public:
+	StreamSource(BAbstractBufferStream *stream);
+	virtual ~StreamSource();
+
+	virtual status_t Start(enter_stream_hook func, void *arg);
+	virtual void Stop(void);
+
+private:
+	BAbstractBufferStream *the_stream;
+	bool entered;
+};
+
+#endif
@@ -0,0 +1,166 @@
+/*
+ *  SweepAccumulator.cpp - Averaging and envelope of consecutive sweeps
+ *
+ *  Written in 2026 for QScope (original program by Christian Bauer)
+ */
+
+#include <SupportDefs.h>
+#include <string.h>
+
+#include "SweepAccumulator.h"
+
+
+/*
+ *  Accumulator constructor
+ */
+
+SweepAccumulator::SweepAccumulator(int values)
+{
+	num_values = values;
+	sum = new int32[values];
+	history = new int16[values * MAX_AVERAGE_SWEEPS];
+	result = new int16[values];
+	SetMode(SWEEP_NORMAL, 1);
+}
+
+
+/*
+ *  Accumulator destructor
+ */
+
+SweepAccumulator::~SweepAccumulator()
+{
+	delete[] sum;
+	delete[] history;
+	delete[] result;
+}
+
+
+/*
+ *  Select mode and number of sweeps, start over
+ */
+
+void SweepAccumulator::SetMode(int new_mode, int new_count)
+{
+	mode = new_mode;
+	if (new_count > MAX_AVERAGE_SWEEPS)
+		new_count = MAX_AVERAGE_SWEEPS;
+	shift = 0;
+	while ((2 << shift) <= new_count)
+		shift++;
+	count = 1 << shift;
+	Reset();
+}
+
+
+/*
+ *  Add complete sweep
+ */
+
+const int16 *SweepAccumulator::Add(const int16 *sweep)
+{
+	switch (mode) {
+		case SWEEP_AVERAGE:
+			add_average(sweep);
+			break;
+		case SWEEP_EXP_AVERAGE:
+			add_exp_average(sweep);
+			break;
+		case SWEEP_ENVELOPE:
+			add_envelope(sweep);
+			break;
+		default:
+			return sweep;
+	}
+	return result;
+}
+
+
+/*
+ *  Mean of the last count sweeps: the sum is updated with the new sweep and
+ *  without the oldest one, which is kept in the history
+ */
+
+void SweepAccumulator::add_average(const int16 *sweep)
+{
+	if (num_sweeps == 0) {
+		memset(sum, 0, num_values * sizeof(int32));
+		history_pos = 0;
+	}
+
+	int16 *old = history + history_pos * num_values;
+	if (num_sweeps < count) {
+		num_sweeps++;
+		for (int i=0; i<num_values; i++)
+			sum[i] += sweep[i];
+	} else {
+		for (int i=0; i<num_values; i++)
+			sum[i] += sweep[i] - old[i];
+	}
+	memcpy(old, sweep, num_values * sizeof(int16));
+	history_pos = (history_pos + 1) & (count - 1);
+
+	// Rounded division, a shift once the history is full
+	if (num_sweeps == count) {
+		int32 half = (1 << shift) >> 1;
+		for (int i=0; i<num_values; i++)
+			result[i] = (sum[i] + half) >> shift;
+	} else {
+
+		// Made positive so that truncation rounds (a float is too coarse for 1/255)
+		double scale = 1.0 / num_sweeps;
+		int32 offset = 32768 * num_sweeps;
+		for (int i=0; i<num_values; i++)
+			result[i] = int32((sum[i] + offset) * scale + 0.5) - 32768;
+	}
+}
+
+
+/*
+ *  Exponential average with 15 fraction bits: sum += (sweep - sum) * 2^-k
+ */
+
+void SweepAccumulator::add_exp_average(const int16 *sweep)
+{
+	if (num_sweeps == 0) {
+		num_sweeps++;
+		for (int i=0; i<num_values; i++) {
+			sum[i] = int32(sweep[i]) << 15;
+			result[i] = sweep[i];
+		}
+		return;
+	}
+
+	// Weight 1/2, 1/4... for the next sweeps, so the average doesn't start from zero
+	int k = 0;
+	while ((1 << k) <= num_sweeps && k < shift)
+		k++;
+	if (num_sweeps < count)
+		num_sweeps++;
+
+	for (int i=0; i<num_values; i++) {
+		int32 s = sum[i] + (((int32(sweep[i]) << 15) - sum[i]) >> k);
+		sum[i] = s;
+		result[i] = (s + (1 << 14)) >> 15;
+	}
+}
+
+
+/*
+ *  Highest maximum and lowest minimum of each column
+ */
+
+void SweepAccumulator::add_envelope(const int16 *sweep)
+{
+	if (num_sweeps == 0)
+		memcpy(result, sweep, num_values * sizeof(int16));
+	else {
+		for (int i=0; i<num_values; i+=2) {
+			int16 max = sweep[i], min = sweep[i + 1];
+			result[i] = max > result[i] ? max : result[i];
+			result[i + 1] = min < result[i + 1] ? min : result[i + 1];
+		}
+	}
+	if (num_sweeps < 0x7fffffff)
+		num_sweeps++;
+}
@@ -0,0 +1,62 @@
+/*
+ *  SweepAccumulator.h - Averaging and envelope of consecutive sweeps
+ *
+ *  Written in 2026 for QScope (original program by Christian Bauer)
+ */
+
+#ifndef __SWEEP_ACCUMULATOR_H__
+#define __SWEEP_ACCUMULATOR_H__
+
+#include <SupportDefs.h>
+
+
+enum {	// Sweep modes, in order of the menu
+	SWEEP_NORMAL,		// Every sweep shown as it is
+	SWEEP_AVERAGE,		// Mean of the last n sweeps
+	SWEEP_EXP_AVERAGE,	// Exponential average, weight 1/n for the newest sweep
+	SWEEP_ENVELOPE,		// Highest maximum and lowest minimum of all sweeps
+	NUM_SWEEP_MODES
+};
+
+const int MAX_AVERAGE_SWEEPS = 256;
+
+
+/*
+ *  Combines every complete sweep with the ones before it. A sweep is an
+ *  array of max/min pairs (even index maximum, odd index minimum). Maxima
+ *  and minima are averaged separately, so a column covering several sample
+ *  frames keeps its extent. Works on the audio thread with nothing locked
+ *  or allocated after construction, one pass over the sweep per call.
+ *  Averages start from the first sweep: the fixed average divides by the
+ *  number of sweeps so far until it has n, the exponential one uses the
+ *  weight 1/2, 1/4, ... until it reaches 1/n.
+ */
+
+class SweepAccumulator {
+public:
+	SweepAccumulator(int values);
+	~SweepAccumulator();
+
+	void SetMode(int mode, int count);	// count is rounded down to a power of two; starts over
+	void Reset(void) {num_sweeps = 0;}
+	const int16 *Add(const int16 *sweep);	// Returns the sweep to display
+	int CountSweeps(void) {return num_sweeps;}
+
+private:
+	void add_average(const int16 *sweep);
+	void add_exp_average(const int16 *sweep);
+	void add_envelope(const int16 *sweep);
+
+	int num_values;		// Values per sweep
+	int mode;			// SWEEP_...
+	int count;			// Sweeps averaged
+	int shift;			// log2(count)
+	int num_sweeps;		// Sweeps added since the start
+
+	int32 *sum;			// Fixed average: sum of the sweeps in history; exponential: average << 15
+	int16 *history;		// Last count sweeps, for the fixed average
+	int history_pos;	// Oldest sweep in history
+	int16 *result;		// Sweep to display
+};
+
+#endif
@@ -0,0 +1,83 @@
+/*
+ *  SynthSource.cpp - Deterministic test signal generator
+ *
+ *  Written in 2026 for QScope (original program by Christian Bauer)
+ */
+
+#include <SupportDefs.h>
+
+#include "SynthSource.h"
+#include "OldAudioStream.h"
+
+
+/*
+ *  Generator constructor
+ */
+
+SynthSource::SynthSource(float rate, int period) : CallbackSource(rate, period), generator(rate, 2)
+{
+	// Left sine, right the same shifted by 90 degrees
+	generator.SetChannel(0, WAVE_SINE, 1000.0, 0.5);
+	generator.SetChannel(1, WAVE_SINE, 1000.0, 0.5, 0.25);
+	stream_func = NULL;
+	stream_arg = NULL;
+}
+
+
+/*
+ *  Generator destructor
+ */
+
+SynthSource::~SynthSource()
+{
+	Stop();		// Before we are gone, the thread calls Fill()
+}
+
+
+/*
+ *  Start generating from the beginning
+ */
+
+status_t SynthSource::Start(enter_stream_hook func, void *arg)
+{
+	Stop();
+	generator.Reset();
+	stream_func = func;
+	stream_arg = arg;
+	return CallbackSource::Start(callback, this) == 0 ? B_NO_ERROR : B_ERROR;
+}
+
+
+/*
+ *  Stop generating
+ */
+
+void SynthSource::Stop(void)
+{
+	CallbackSource::Stop();
+}
+
+
+/*
+ *  Generate frames (called by callback thread)
+ */
+
+void SynthSource::Fill(int16_t *buf, int frames)
+{
+	generator.Generate(buf, frames);
+}
+
+
+/*
+ *  Pass buffer on to the stream function (called by callback thread)
+ */
+
+void SynthSource::callback(void *arg, int16_t *buf, int frames, const callback_header *header)
+{
+	SynthSource *s = (SynthSource *)arg;
+	audio_buffer_header h;
+	h.buffer_number = header->buffer_number;
+	h.subscriber_count = 1;
+	h.time = header->time;
+	s->stream_func(s->stream_arg, (char *)buf, frames * 4, &h);
+}
@@ -0,0 +1,43 @@
+/*
+ *  SynthSource.h - Deterministic test signal generator
+ *
+ *  Written in 2026 for QScope (original program by Christian Bauer)
+ */
+
+#ifndef __SYNTH_SOURCE_H__
+#define __SYNTH_SOURCE_H__
+
+#include "AudioSource.h"
+#include "CallbackSource.h"
+#include "Generator.h"
+
+
+/*
+ *  Stereo SignalGenerator driven by the callback thread. Every Start()
+ *  begins with the same phase and noise seed, so runs are reproducible.
+ *  Hands the buffers of the callback thread to the stream function with
+ *  an audio_buffer_header, like the audio streams.
+ */
+
+class SynthSource : public AudioSource, public CallbackSource {
+public:
+	SynthSource(float rate, int period);
+	virtual ~SynthSource();
+
+	virtual status_t Start(enter_stream_hook func, void *arg);
+	virtual void Stop(void);
+
+	SignalGenerator *Generator(void) {return &generator;}
+
+protected:
+	virtual void Fill(int16_t *buf, int frames);
+
+private:
+	static void callback(void *arg, int16_t *buf, int frames, const callback_header *header);
+
+	SignalGenerator generator;
+	enter_stream_hook stream_func;	// Stream function and its argument
+	void *stream_arg;
+};
+
+#endif
@@ -4,6 +4,7 @@
  *  Created by Robert Polic, modified by Christian Bauer
  */
 
+#include <AppKit.h>
 #include <InterfaceKit.h>
 
 #include "TSliderView.h"
@@ -12,6 +13,12 @@
 // Background color
 const rgb_color fill_color = {216, 216, 216, 0};
 
+// Message sent to the slider while dragging
+const uint32 MSG_SLIDER_TICK = 'sltk';
+
+// Maximum rate of callbacks while dragging (one per display frame)
+const bigtime_t CALLBACK_INTERVAL = 16667;
+
 
 // Knob image
 #define KNOB_WIDTH		 (18 - 1)
@@ -59,17 +66,21 @@ TSliderView::TSliderView(BRect rect, char *name, float val, slider_func func, vo
 	fValue = val;
 	callback = func;
 	callback_arg = arg;
+	tracking = false;
+	callback_pending = false;
+	callback_runner = NULL;
 
 	// load in our canned slider knob bitmap
 	r.Set(0, 0, ((KNOB_WIDTH + 7) & 0xfff8) - 1, KNOB_HEIGHT);
 	fKnob = new BBitmap(r, B_COLOR_8_BIT);
 	fKnob->SetBits((char*)knob, fKnob->BitsLength(), 0, B_COLOR_8_BIT);
 
-	// create our offscreen drawing environment
+	// create our offscreen drawing environment and draw the background once
 	r = Bounds();
 	back_width = r.Width();
 	fSlider = new BBitmap(r, B_COLOR_8_BIT, TRUE);
 	fSlider->AddChild(fOffView = new BView(r, "", B_FOLLOW_ALL, B_WILL_DRAW));
+	DrawBackground();
 }
 
 
@@ -79,6 +90,7 @@ TSliderView::TSliderView(BRect rect, char *name, float val, slider_func func, vo
 
 TSliderView::~TSliderView()
 {
+	delete callback_runner;
 	delete fSlider;
 	delete fKnob;
 }
@@ -95,66 +107,115 @@ void TSliderView::Draw(BRect where)
 
 
 /*
- *  Slider was clicked
+ *  Slider was clicked, track mouse until button is released
  */
 
 void TSliderView::MouseDown(BPoint thePoint)
 {
-	uint32	buttons;
-	float	old_value;
 	float	temp;
-	BPoint	where;
-	BRect	r;
-
-	r.left = ((back_width - KNOB_WIDTH - 4.0) * fValue) + 2.0;
-	r.top = 0.0;
-	r.right = r.left + KNOB_WIDTH;
-	r.bottom = KNOB_HEIGHT;
 
-	if (!r.Contains(thePoint)) {
+	if (!KnobRect(fValue).Contains(thePoint)) {
 		temp = (thePoint.x / (back_width - KNOB_WIDTH - 4.0)) -
 							 ((KNOB_WIDTH / 2.0) / back_width);
 		if (temp < 0.00)
 			temp = 0.00;
 		if (temp > 1.00)
 			temp = 1.00;
-		if (temp != fValue)
+		if (temp != fValue) {
 			SetValue(temp);
+			callback_pending = true;
+		}
 	}
-	old_value = fValue;
+	track_start = thePoint;
+	track_value = fValue;
+	tracking = true;
 
-	do {
-		GetMouse(&where, &buttons);
-		temp = old_value + ((where.x - thePoint.x) /
-							(back_width - KNOB_WIDTH - 2.0));
-		if (temp < 0.00)
-			temp = 0.00;
-		if (temp > 1.00)
-			temp = 1.00;
-		if (temp != fValue) {
-			SetValue(temp);
+	// Get MouseMoved()/MouseUp() even outside the view
+	SetMouseEventMask(B_POINTER_EVENTS, B_LOCK_WINDOW_FOCUS);
+
+	BMessage tick(MSG_SLIDER_TICK);
+	delete callback_runner;
+	callback_runner = new BMessageRunner(BMessenger(this), &tick, CALLBACK_INTERVAL);
+}
+
+
+/*
+ *  Mouse moved while dragging
+ */
+
+void TSliderView::MouseMoved(BPoint where, uint32 transit, const BMessage *drag)
+{
+	if (tracking)
+		Track(where);
+}
+
+
+/*
+ *  Mouse button released, deliver final value
+ */
+
+void TSliderView::MouseUp(BPoint where)
+{
+	if (!tracking)
+		return;
+	Track(where);
+	tracking = false;
+
+	delete callback_runner;
+	callback_runner = NULL;
+	if (callback_pending) {
+		callback_pending = false;
+		callback(fValue, callback_arg);
+	}
+}
+
+
+/*
+ *  Timer tick while dragging, deliver value if it changed
+ */
+
+void TSliderView::MessageReceived(BMessage *msg)
+{
+	if (msg->what == MSG_SLIDER_TICK) {
+		if (callback_pending) {
+			callback_pending = false;
+			callback(fValue, callback_arg);
 		}
-		Window()->Unlock();
-		callback(temp, callback_arg);
-		snooze(20000.0);	// be a good citizen
-		Window()->Lock();
-	} while (buttons);
+	} else
+		BView::MessageReceived(msg);
 }
 
 
 /*
- *  Draw slider
+ *  Move knob to follow mouse
  */
 
-void TSliderView::DrawSlider()
+void TSliderView::Track(BPoint where)
+{
+	float temp = track_value + ((where.x - track_start.x) /
+						(back_width - KNOB_WIDTH - 2.0));
+	if (temp < 0.00)
+		temp = 0.00;
+	if (temp > 1.00)
+		temp = 1.00;
+	if (temp != fValue) {
+		SetValue(temp);
+		callback_pending = true;
+	}
+}
+
+
+/*
+ *  Draw slider background into offscreen bitmap
+ */
+
+void TSliderView::DrawBackground()
 {
 	BRect	sr;
-	BRect	dr;
 
 	fSlider->Lock();
 	sr = fOffView->Bounds();
 
-	// slider background
 	fOffView->SetHighColor(fill_color);
 	fOffView->FillRect(sr);
 	fOffView->SetHighColor(176, 176, 176);
@@ -176,32 +237,54 @@ void TSliderView::DrawSlider()
 	sr.Set(2, 8, back_width - 2, 9);
 	fOffView->FillRect(sr);
 
-	// knob
-	sr.Set(0, 0, KNOB_WIDTH, KNOB_HEIGHT);
-	dr.left = ((back_width - KNOB_WIDTH - 4.0) * fValue) + 2.0;
-	dr.top = 0;
-	dr.right = dr.left + KNOB_WIDTH;
-	dr.bottom = dr.top + KNOB_HEIGHT;
-	fOffView->DrawBitmap(fKnob, sr, dr);
-	fOffView->SetHighColor(0, 0, 0);
-
 	fOffView->Sync();	// make sure offscreen drawing completes
+	fSlider->Unlock();
+}
 
-	// copy offscreen to screen
-	DrawBitmap(fSlider, BPoint(0, 0));
 
-	fSlider->Unlock();
+/*
+ *  Knob position for value
+ */
+
+BRect TSliderView::KnobRect(float value)
+{
+	BRect	r;
+
+	r.left = ((back_width - KNOB_WIDTH - 4.0) * value) + 2.0;
+	r.top = 0.0;
+	r.right = r.left + KNOB_WIDTH;
+	r.bottom = KNOB_HEIGHT;
+	return r;
 }
 
 
 /*
- *  Set slider value
+ *  Draw slider
+ */
+
+void TSliderView::DrawSlider()
+{
+	DrawBitmap(fSlider, BPoint(0, 0));
+	DrawBitmap(fKnob, BRect(0, 0, KNOB_WIDTH, KNOB_HEIGHT), KnobRect(fValue));
+}
+
+
+/*
+ *  Set slider value, only the area covered by the old and new knob is redrawn
  */
 
 void TSliderView::SetValue(float value)
 {
+	BRect	old_knob = KnobRect(fValue);
+	BRect	new_knob = KnobRect(value);
+
 	fValue = value;
-	DrawSlider();
+	if (Window() == NULL)
+		return;
+
+	BRect	r = old_knob | new_knob;
+	DrawBitmap(fSlider, r, r);
+	DrawBitmap(fKnob, BRect(0, 0, KNOB_WIDTH, KNOB_HEIGHT), new_knob);
 }
 
 
@@ -11,6 +11,8 @@
 // Callback function
 typedef void (*slider_func)(float, void *);
 
+class BMessageRunner;
+
 
 class TSliderView : public BView {
 public:
@@ -19,18 +21,31 @@ public:
 
 	virtual	void Draw(BRect);
 	virtual void MouseDown(BPoint);
+	virtual void MouseMoved(BPoint, uint32, const BMessage *);
+	virtual void MouseUp(BPoint);
+	virtual void MessageReceived(BMessage *);
 
 	void DrawSlider();
 	void SetValue(float);
 	float Value();
 
 private:
+	void DrawBackground();
+	BRect KnobRect(float value);
+	void Track(BPoint where);
+
 	float fValue, back_width;
-	BBitmap* fSlider;
+	BBitmap* fSlider;		// Background only, the knob is drawn on top
 	BBitmap* fKnob;
 	BView* fOffView;
 	slider_func callback;
 	void *callback_arg;
+
+	bool tracking;			// Mouse button held down
+	BPoint track_start;		// Mouse position and value when dragging started
+	float track_value;
+	bool callback_pending;	// Value changed since last callback
+	BMessageRunner *callback_runner;	// Delivers pending callback once per frame while dragging
 };
 
 #endif
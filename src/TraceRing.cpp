@@ -0,0 +1,176 @@
+/*
+ *  TraceRing.cpp - Lock-free column ring between subscriber and drawing looper
+ *
+ *  Written in 2026 for QScope (original program by Christian Bauer)
+ */
+
+#include <SupportDefs.h>
+#include <string.h>
+
+#include "TraceRing.h"
+
+
+/*
+ *  Ring constructor
+ */
+
+TraceRing::TraceRing(int width, int channels, int min_columns)
+{
+	trace_width = width;
+	num_channels = channels;
+	ring_columns = 1;
+	while (ring_columns < width * 4 || ring_columns < min_columns)
+		ring_columns <<= 1;
+	ring_buf = new int16[ring_columns * 2 * channels];
+	memset(ring_buf, 0, ring_columns * 2 * channels * sizeof(int16));
+	write_pos = trace_end = read_end = 0;
+	trace_count = 0;
+	notify_pending = 0;
+	memset(stamp_ring, 0, sizeof(stamp_ring));
+	stamp_pos = 0;
+}
+
+
+/*
+ *  Ring destructor
+ */
+
+TraceRing::~TraceRing()
+{
+	delete[] ring_buf;
+}
+
+
+/*
+ *  Append one column of max/min pairs for all channels (producer)
+ */
+
+void TraceRing::PutColumn(const int16 *max_min)
+{
+	int16 *p = ring_buf + ((write_pos & (ring_columns - 1)) << 1);
+	for (int c=0; c<num_channels; c++, p+=ring_columns*2) {
+		p[0] = *max_min++;
+		p[1] = *max_min++;
+	}
+	atomic_add(&write_pos, 1);
+}
+
+
+/*
+ *  Mark the last trace_width columns as complete sweep (producer), with its
+ *  time stamps if known
+ */
+
+void TraceRing::EndTrace(const trace_stamps *stamps)
+{
+	int32 end = atomic_get(&write_pos);
+	if (stamps != NULL) {
+		stamp_slot *s = stamp_ring + stamp_pos;
+		stamp_pos = (stamp_pos + 1) & (TRACE_STAMP_SLOTS - 1);
+		atomic_add(&s->seq, 1);
+		s->end = end;
+		s->stamps = *stamps;
+		atomic_add(&s->seq, 1);
+	}
+	atomic_set(&trace_end, end);
+	atomic_add(&trace_count, 1);
+}
+
+
+/*
+ *  Copy newest complete sweep to dest (consumer), in the layout
+ *  [channel 0 max/min * trace_width][channel 1 max/min * trace_width]...
+ *  *last_end is the consumer's read position (trace_end of its last sweep).
+ *  stamps (if not NULL) receives the time stamps of the sweep, all zero if
+ *  there are none. Returns false if there is no new sweep or it was
+ *  overwritten while copying
+ */
+
+bool TraceRing::GetTrace(int16 *dest, int32 *last_end, trace_stamps *stamps)
+{
+	int32 end = atomic_get(&trace_end);
+	if (end == *last_end)
+		return false;
+	*last_end = end;
+	if (stamps != NULL)
+		get_stamps(end, stamps);
+
+	int32 start = end - trace_width;
+	copy_columns(dest, start, trace_width, trace_width);
+
+	// Producer may have lapped us while copying
+	return atomic_get(&write_pos) - start < ring_columns;
+}
+
+
+/*
+ *  Copy up to max columns written since *from to dest (consumer), in the
+ *  layout [channel 0 max/min * max][channel 1 max/min * max]... *from is
+ *  advanced, skipping columns that were already overwritten, before or
+ *  while copying. Returns the number of columns copied
+ */
+
+int TraceRing::GetColumns(int16 *dest, int32 *from, int max)
+{
+	int32 pos = atomic_get(&write_pos);
+	if (pos - *from > ring_columns - trace_width)
+		*from = pos - max;
+	int n = pos - *from;
+	if (n > max) {
+		*from = pos - max;
+		n = max;
+	}
+
+	int32 start = *from;
+	copy_columns(dest, start, n, max);
+	*from = pos;
+
+	// Producer may have lapped us while copying: drop the oldest columns, they may be torn
+	int32 lost = atomic_get(&write_pos) - ring_columns + 1 - start;
+	if (lost > 0) {
+		if (lost > n)
+			lost = n;
+		n -= lost;
+		for (int c=0; c<num_channels; c++)
+			memmove(dest + c * max * 2, dest + (c * max + lost) * 2, n * 2 * sizeof(int16));
+	}
+	return n;
+}
+
+
+/*
+ *  Find stamps of the sweep ending at ring position end (consumer), the
+ *  slot must not change while it is copied
+ */
+
+void TraceRing::get_stamps(int32 end, trace_stamps *stamps)
+{
+	for (int i=0; i<TRACE_STAMP_SLOTS; i++) {
+		stamp_slot *s = stamp_ring + i;
+		int32 seq = atomic_get(&s->seq);
+		if ((seq & 1) || s->end != end)
+			continue;
+		*stamps = s->stamps;
+		if (atomic_get(&s->seq) == seq)
+			return;
+	}
+	memset(stamps, 0, sizeof(trace_stamps));
+}
+
+
+/*
+ *  Copy n columns starting at ring position start, dest has stride columns per channel
+ */
+
+void TraceRing::copy_columns(int16 *dest, int32 start, int n, int stride)
+{
+	for (int c=0; c<num_channels; c++) {
+		int16 *src = ring_buf + c * ring_columns * 2;
+		int16 *d = dest + c * stride * 2;
+		for (int i=0; i<n; i++) {
+			int j = ((start + i) & (ring_columns - 1)) << 1;
+			d[i * 2] = src[j];
+			d[i * 2 + 1] = src[j + 1];
+		}
+	}
+}
@@ -0,0 +1,75 @@
+/*
+ *  TraceRing.h - Lock-free column ring between subscriber and drawing looper
+ *
+ *  Written in 2026 for QScope (original program by Christian Bauer)
+ */
+
+#ifndef __TRACE_RING_H__
+#define __TRACE_RING_H__
+
+#include <SupportDefs.h>
+
+
+// Times (system_time()) of a sweep on its way through the audio thread
+struct trace_stamps {
+	bigtime_t arrival;		// Buffer with the last frame of the sweep arrived
+	bigtime_t trigger;		// Sweep triggered (or started, without trigger)
+	bigtime_t complete;		// Sweep ended
+};
+
+const int TRACE_STAMP_SLOTS = 8;	// Stamps kept of the last sweeps
+
+
+/*
+ *  The subscriber (single producer) appends min/max columns and marks the
+ *  ends of complete sweeps. The drawing looper (single consumer) copies out
+ *  either the newest complete sweep or all columns since its last read.
+ *  Further consumers (the trace server) read sweeps with their own read
+ *  position. Nothing is locked or allocated; a consumer that falls more
+ *  than the ring size behind detects this and skips ahead. The producer
+ *  may hand time stamps of a sweep to EndTrace(), a consumer gets them
+ *  with the sweep as long as they are among the last TRACE_STAMP_SLOTS.
+ */
+
+class TraceRing {
+public:
+	TraceRing(int width, int channels, int min_columns = 0);	// Holds at least four sweeps and min_columns
+	~TraceRing();
+
+	// Producer side (audio thread)
+	void PutColumn(const int16 *max_min);
+	void EndTrace(const trace_stamps *stamps = NULL);
+	bool Notify(void) {return atomic_get_and_set(&notify_pending, 1) == 0;}
+
+	// Consumer side (drawing looper)
+	void Notified(void) {atomic_set(&notify_pending, 0);}
+	int32 Position(void) {return atomic_get(&write_pos);}
+	int32 CountTraces(void) {return atomic_get(&trace_count);}
+	bool GetTrace(int16 *dest, trace_stamps *stamps = NULL) {return GetTrace(dest, &read_end, stamps);}
+	bool GetTrace(int16 *dest, int32 *last_end, trace_stamps *stamps = NULL);
+	int GetColumns(int16 *dest, int32 *from, int max);
+
+private:
+	void copy_columns(int16 *dest, int32 start, int n, int stride);
+	void get_stamps(int32 end, trace_stamps *stamps);
+
+	struct stamp_slot {
+		int32 seq;			// Odd while the producer writes the slot
+		int32 end;			// trace_end of the sweep
+		trace_stamps stamps;
+	};
+
+	int trace_width;	// Columns per sweep
+	int num_channels;	// Channels per column
+	int ring_columns;	// Columns in ring (power of two)
+	int16 *ring_buf;	// Max/min pairs, one block of ring_columns pairs per channel
+	int32 write_pos;	// Total number of columns written (modulo 2^32)
+	int32 trace_end;	// write_pos after the newest complete sweep
+	int32 read_end;		// trace_end of the last sweep returned to the drawing looper
+	int32 trace_count;	// Number of complete sweeps (modulo 2^32)
+	int32 notify_pending;	// Consumer has been notified but not yet looked
+	stamp_slot stamp_ring[TRACE_STAMP_SLOTS];	// Stamps of the last sweeps
+	int stamp_pos;			// Slot for the next stamps (producer)
+};
+
+#endif
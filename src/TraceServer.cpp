@@ -0,0 +1,586 @@
+/*
+ *  TraceServer.cpp - Publishes traces and measurement results on a local socket
+ *
+ *  Written in 2026 for QScope (original program by Christian Bauer)
+ */
+
+#include <SupportDefs.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <poll.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "TraceServer.h"
+#include "TraceRing.h"
+
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+const int OUT_QUEUE_SIZE = 65536;		// Bytes queued per client
+const int MAX_RESULT_SIZE = 65536;		// Bytes of results waiting for the server thread
+const int POLL_INTERVAL = 10;			// Milliseconds, traces are sent at most this often
+const bigtime_t DROP_TIME = 2000000;	// Clients taking no data for this long are disconnected
+
+
+// Monotonic time in microseconds
+static bigtime_t monotonic_time(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return bigtime_t(ts.tv_sec) * 1000000 + ts.tv_nsec / 1000;
+}
+
+
+/*
+ *  Create socket for address ("/path" = Unix-domain, otherwise TCP port on 127.0.0.1),
+ *  either listening or connected. Returns -1 on error
+ */
+
+static int open_socket(const char *address, bool server)
+{
+	struct sockaddr_un sun;
+	struct sockaddr_in sin;
+	struct sockaddr *sa;
+	socklen_t len;
+	int fd;
+
+	if (address[0] == '/') {
+		if (strlen(address) >= sizeof(sun.sun_path))
+			return -1;
+		memset(&sun, 0, sizeof(sun));
+		sun.sun_family = AF_UNIX;
+		strcpy(sun.sun_path, address);
+		sa = (struct sockaddr *)&sun;
+		len = sizeof(sun);
+		fd = socket(AF_UNIX, SOCK_STREAM, 0);
+		if (server)
+			unlink(address);	// Left over from a previous run
+	} else {
+		int port = atoi(address);
+		if (port <= 0 || port > 65535)
+			return -1;
+		memset(&sin, 0, sizeof(sin));
+		sin.sin_family = AF_INET;
+		sin.sin_port = htons(port);
+		sin.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+		sa = (struct sockaddr *)&sin;
+		len = sizeof(sin);
+		fd = socket(AF_INET, SOCK_STREAM, 0);
+		if (fd >= 0 && server) {
+			int on = 1;
+			setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+		}
+	}
+	if (fd < 0)
+		return -1;
+
+	if (server ? (bind(fd, sa, len) < 0 || listen(fd, MAX_TRACE_CLIENTS) < 0) : connect(fd, sa, len) < 0) {
+		close(fd);
+		return -1;
+	}
+	return fd;
+}
+
+
+/*
+ *  Write record header
+ */
+
+static void put_header(uint8 *p, uint8 type, int size)
+{
+	p[0] = type;
+	p[1] = size;
+	p[2] = size >> 8;
+	p[3] = size >> 16;
+}
+
+
+/*
+ *  Server constructor
+ */
+
+TraceServer::TraceServer(TraceRing *ring, int width, int channels)
+{
+	the_ring = ring;
+	trace_width = width;
+	num_values = width * channels * 2;
+	trace = new int16[num_values];
+	read_end = 0;
+	listen_fd = -1;
+	socket_path[0] = 0;
+	for (int i=0; i<MAX_TRACE_CLIENTS; i++)
+		clients[i].fd = -1;
+	num_clients = 0;
+	pthread_mutex_init(&result_lock, NULL);
+	result_buf = new char[MAX_RESULT_SIZE];
+	result_size = 0;
+	running = false;
+}
+
+
+/*
+ *  Server destructor
+ */
+
+TraceServer::~TraceServer()
+{
+	Stop();
+	pthread_mutex_destroy(&result_lock);
+	delete[] result_buf;
+	delete[] trace;
+}
+
+
+/*
+ *  Open socket and start server thread
+ */
+
+status_t TraceServer::Start(const char *address)
+{
+	Stop();
+	listen_fd = open_socket(address, true);
+	if (listen_fd < 0)
+		return B_ERROR;
+	fcntl(listen_fd, F_SETFL, fcntl(listen_fd, F_GETFL) | O_NONBLOCK);
+	if (address[0] == '/')
+		strcpy(socket_path, address);
+
+	quit = false;
+	if (pthread_create(&the_thread, NULL, thread_entry, this) != 0) {
+		close(listen_fd);
+		listen_fd = -1;
+		return B_ERROR;
+	}
+	running = true;
+	return B_NO_ERROR;
+}
+
+
+/*
+ *  Stop server thread, disconnect all clients and close socket
+ */
+
+void TraceServer::Stop(void)
+{
+	if (running) {
+		quit = true;
+		pthread_join(the_thread, NULL);
+		running = false;
+	}
+	for (int i=0; i<MAX_TRACE_CLIENTS; i++)
+		if (clients[i].fd >= 0)
+			close_client(i);
+	if (listen_fd >= 0) {
+		close(listen_fd);
+		listen_fd = -1;
+	}
+	if (socket_path[0]) {
+		unlink(socket_path);
+		socket_path[0] = 0;
+	}
+}
+
+
+/*
+ *  Queue result text for all clients (dropped if the server thread is too far behind)
+ */
+
+void TraceServer::PublishResult(const char *text)
+{
+	int size = strlen(text);
+	pthread_mutex_lock(&result_lock);
+	if (result_size + TRACE_HEADER_SIZE + size <= MAX_RESULT_SIZE) {
+		put_header((uint8 *)result_buf + result_size, TRACE_RECORD_RESULT, size);
+		memcpy(result_buf + result_size + TRACE_HEADER_SIZE, text, size);
+		result_size += TRACE_HEADER_SIZE + size;
+	}
+	pthread_mutex_unlock(&result_lock);
+}
+
+
+/*
+ *  Server thread
+ */
+
+void *TraceServer::thread_entry(void *arg)
+{
+	((TraceServer *)arg)->thread_func();
+	return NULL;
+}
+
+void TraceServer::thread_func(void)
+{
+	struct pollfd fds[MAX_TRACE_CLIENTS + 1];
+	int index[MAX_TRACE_CLIENTS + 1];	// Client of each pollfd
+	char scrap[256];
+
+	while (!quit) {
+
+		// Wait for connections, client input, room in client sockets, or the next interval
+		int n = 0;
+		fds[n].fd = listen_fd;
+		fds[n++].events = POLLIN;
+		for (int i=0; i<MAX_TRACE_CLIENTS; i++)
+			if (clients[i].fd >= 0) {
+				index[n] = i;
+				fds[n].fd = clients[i].fd;
+				fds[n++].events = POLLIN | (clients[i].out_end > clients[i].out_start ? POLLOUT : 0);
+			}
+		if (poll(fds, n, POLL_INTERVAL) < 0 && errno != EINTR)
+			break;
+		bigtime_t now = monotonic_time();
+
+		if (fds[0].revents & POLLIN)
+			accept_client();
+
+		// Discard client input, close on EOF or error
+		for (int j=1; j<n; j++)
+			if (fds[j].revents & (POLLIN | POLLHUP | POLLERR)) {
+				ssize_t actual = recv(fds[j].fd, scrap, sizeof(scrap), MSG_DONTWAIT);
+				if (actual == 0 || (actual < 0 && errno != EAGAIN && errno != EINTR))
+					close_client(index[j]);
+			}
+
+		// Queue newest sweep and pending results
+		if (atomic_get(&num_clients) > 0 && the_ring->GetTrace(trace, &read_end))
+			for (int i=0; i<MAX_TRACE_CLIENTS; i++)
+				if (clients[i].fd >= 0)
+					queue_trace(clients + i);
+		pthread_mutex_lock(&result_lock);
+		if (result_size) {
+			for (int i=0; i<MAX_TRACE_CLIENTS; i++)
+				if (clients[i].fd >= 0) {
+					uint8 *p = reserve(clients + i, result_size);
+					if (p != NULL) {
+						memcpy(p, result_buf, result_size);
+						clients[i].out_end += result_size;
+					}
+				}
+			result_size = 0;
+		}
+		pthread_mutex_unlock(&result_lock);
+
+		// Send as much as the clients take
+		for (int i=0; i<MAX_TRACE_CLIENTS; i++)
+			if (clients[i].fd >= 0 && !flush(clients + i, now))
+				close_client(i);
+	}
+}
+
+
+/*
+ *  Accept new connection and greet it
+ */
+
+void TraceServer::accept_client(void)
+{
+	int fd = accept(listen_fd, NULL, NULL);
+	if (fd < 0)
+		return;
+
+	int i;
+	for (i=0; i<MAX_TRACE_CLIENTS; i++)
+		if (clients[i].fd < 0)
+			break;
+	if (i == MAX_TRACE_CLIENTS) {
+		close(fd);
+		return;
+	}
+
+	fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+	int on = 1;
+	setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));	// Fails harmlessly on Unix-domain sockets
+
+	client *c = clients + i;
+	c->fd = fd;
+	c->keyed = false;
+	c->last = new int16[num_values];
+	c->out = new uint8[OUT_QUEUE_SIZE];
+	c->out_start = c->out_end = 0;
+	c->stalled = 0;
+	atomic_add(&num_clients, 1);
+
+	uint8 hello[6];
+	int channels = num_values / (trace_width * 2);
+	hello[0] = TRACE_PROTOCOL_VERSION; hello[1] = TRACE_PROTOCOL_VERSION >> 8;
+	hello[2] = trace_width; hello[3] = trace_width >> 8;
+	hello[4] = channels; hello[5] = channels >> 8;
+	queue_record(c, TRACE_RECORD_HELLO, hello, sizeof(hello));
+}
+
+
+/*
+ *  Disconnect client
+ */
+
+void TraceServer::close_client(int i)
+{
+	client *c = clients + i;
+	close(c->fd);
+	c->fd = -1;
+	delete[] c->last;
+	delete[] c->out;
+	atomic_add(&num_clients, -1);
+}
+
+
+/*
+ *  Make room for size bytes at the end of the output queue of a client,
+ *  returns NULL if it's too full
+ */
+
+uint8 *TraceServer::reserve(client *c, int size)
+{
+	if (c->out_end + size > OUT_QUEUE_SIZE && c->out_start > 0) {
+		memmove(c->out, c->out + c->out_start, c->out_end - c->out_start);
+		c->out_end -= c->out_start;
+		c->out_start = 0;
+	}
+	if (c->out_end + size > OUT_QUEUE_SIZE)
+		return NULL;
+	return c->out + c->out_end;
+}
+
+
+/*
+ *  Queue record, or drop it if the queue is full
+ */
+
+void TraceServer::queue_record(client *c, uint8 type, const uint8 *data, int size)
+{
+	uint8 *p = reserve(c, TRACE_HEADER_SIZE + size);
+	if (p == NULL)
+		return;
+	put_header(p, type, size);
+	memcpy(p + TRACE_HEADER_SIZE, data, size);
+	c->out_end += TRACE_HEADER_SIZE + size;
+}
+
+
+/*
+ *  Queue current sweep for client, as delta to the last sweep it got or as
+ *  key trace if that is shorter. The client misses it if the queue is full
+ */
+
+void TraceServer::queue_trace(client *c)
+{
+	int key_size = 4 + num_values * 2;
+	uint8 *p = reserve(c, TRACE_HEADER_SIZE + 4 + num_values * 3);
+	if (p == NULL)
+		return;
+
+	uint8 *q = p + TRACE_HEADER_SIZE;
+	q[0] = read_end; q[1] = read_end >> 8; q[2] = read_end >> 16; q[3] = read_end >> 24;
+	q += 4;
+
+	uint8 type = TRACE_RECORD_DELTA;
+	if (c->keyed) {
+		for (int i=0; i<num_values; ) {
+			uint32 token;
+			if (trace[i] == c->last[i]) {
+				int run = 1;
+				while (i + run < num_values && run < 64 && trace[i + run] == c->last[i + run])
+					run++;
+				token = ((run - 1) << 1) | 1;
+				i += run;
+			} else {
+				int16 d = trace[i] - c->last[i];
+				uint16 z = (uint16(d) << 1) ^ uint16(d >> 15);
+				token = uint32(z) << 1;
+				i++;
+			}
+			while (token >= 0x80) {
+				*q++ = token | 0x80;
+				token >>= 7;
+			}
+			*q++ = token;
+		}
+	}
+	if (!c->keyed || q - p - TRACE_HEADER_SIZE > key_size) {
+		type = TRACE_RECORD_KEY;
+		q = p + TRACE_HEADER_SIZE + 4;
+		for (int i=0; i<num_values; i++) {
+			*q++ = trace[i];
+			*q++ = trace[i] >> 8;
+		}
+		c->keyed = true;
+	}
+
+	int size = q - p - TRACE_HEADER_SIZE;
+	put_header(p, type, size);
+	c->out_end += TRACE_HEADER_SIZE + size;
+	memcpy(c->last, trace, num_values * sizeof(int16));
+}
+
+
+/*
+ *  Send queued data without blocking, returns false if the client is to be dropped
+ */
+
+bool TraceServer::flush(client *c, bigtime_t now)
+{
+	while (c->out_start < c->out_end) {
+		ssize_t actual = send(c->fd, c->out + c->out_start, c->out_end - c->out_start, MSG_NOSIGNAL | MSG_DONTWAIT);
+		if (actual > 0) {
+			c->out_start += actual;
+			c->stalled = 0;
+		} else if (actual < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+			break;
+		else if (actual < 0 && errno == EINTR)
+			continue;
+		else
+			return false;
+	}
+
+	if (c->out_start == c->out_end) {
+		c->out_start = c->out_end = 0;
+		c->stalled = 0;
+	} else if (c->stalled == 0)
+		c->stalled = now;
+	else if (now - c->stalled > DROP_TIME)
+		return false;
+	return true;
+}
+
+
+/*
+ *  Client constructor
+ */
+
+TraceClient::TraceClient()
+{
+	fd = -1;
+	trace_width = num_channels = 0;
+	trace = NULL;
+	position = 0;
+	payload_size = 256;
+	payload = new uint8[payload_size];
+	payload[0] = 0;
+	record_size = 0;
+}
+
+
+/*
+ *  Client destructor
+ */
+
+TraceClient::~TraceClient()
+{
+	if (fd >= 0)
+		close(fd);
+	delete[] trace;
+	delete[] payload;
+}
+
+
+/*
+ *  Connect to server
+ */
+
+status_t TraceClient::Connect(const char *address)
+{
+	if (fd >= 0)
+		close(fd);
+	fd = open_socket(address, false);
+	return fd < 0 ? B_ERROR : B_NO_ERROR;
+}
+
+
+/*
+ *  Read and decode next record
+ */
+
+int TraceClient::Read(void)
+{
+	uint8 header[TRACE_HEADER_SIZE];
+	if (fd < 0 || !read_fully(header, TRACE_HEADER_SIZE))
+		return -1;
+	int size = header[1] | (header[2] << 8) | (header[3] << 16);
+	if (size + 1 > payload_size) {
+		delete[] payload;
+		payload_size = size + 1;
+		payload = new uint8[payload_size];
+	}
+	if (!read_fully(payload, size))
+		return -1;
+	payload[size] = 0;
+	record_size = TRACE_HEADER_SIZE + size;
+
+	const uint8 *p = payload, *end = payload + size;
+	int num_values = trace_width * num_channels * 2;
+	switch (header[0]) {
+		case TRACE_RECORD_HELLO:
+			if (size < 6)
+				return -1;
+			trace_width = p[2] | (p[3] << 8);
+			num_channels = p[4] | (p[5] << 8);
+			delete[] trace;
+			trace = new int16[trace_width * num_channels * 2];
+			memset(trace, 0, trace_width * num_channels * 2 * sizeof(int16));
+			break;
+
+		case TRACE_RECORD_KEY:
+			if (trace == NULL || size != 4 + num_values * 2)
+				return -1;
+			position = p[0] | (p[1] << 8) | (p[2] << 16) | (uint32(p[3]) << 24);
+			p += 4;
+			for (int i=0; i<num_values; i++, p+=2)
+				trace[i] = p[0] | (p[1] << 8);
+			break;
+
+		case TRACE_RECORD_DELTA:
+			if (trace == NULL || size < 4)
+				return -1;
+			position = p[0] | (p[1] << 8) | (p[2] << 16) | (uint32(p[3]) << 24);
+			p += 4;
+			for (int i=0; i<num_values; ) {
+				uint32 token = 0;
+				int shift = 0;
+				do {
+					if (p == end || shift > 21)
+						return -1;
+					token |= (*p & 0x7f) << shift;
+					shift += 7;
+				} while (*p++ & 0x80);
+				if (token & 1)
+					i += (token >> 1) + 1;	// Unchanged values
+				else {
+					uint32 z = token >> 1;
+					trace[i++] += int16((z >> 1) ^ -(z & 1));
+				}
+			}
+			break;
+	}
+	return header[0];
+}
+
+
+/*
+ *  Read exactly size bytes, returns false on EOF or error
+ */
+
+bool TraceClient::read_fully(void *buf, int size)
+{
+	uint8 *p = (uint8 *)buf;
+	while (size > 0) {
+		ssize_t actual = read(fd, p, size);
+		if (actual < 0 && errno == EINTR)
+			continue;
+		if (actual <= 0)
+			return false;
+		p += actual;
+		size -= actual;
+	}
+	return true;
+}
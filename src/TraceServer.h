@@ -0,0 +1,142 @@
+/*
+ *  TraceServer.h - Publishes traces and measurement results on a local socket
+ *
+ *  Written in 2026 for QScope (original program by Christian Bauer)
+ */
+
+#ifndef __TRACE_SERVER_H__
+#define __TRACE_SERVER_H__
+
+#include <SupportDefs.h>
+#include <pthread.h>
+
+class TraceRing;
+
+
+/*
+ *  Protocol, all numbers little-endian. Every record starts with a four
+ *  byte header: the record type (one byte) and the length of the payload
+ *  that follows (three bytes).
+ *    'H' Hello, sent once after connecting: protocol version, trace width
+ *        and number of channels (uint16 each)
+ *    'K' Key trace: position (uint32), then width max/min pairs per
+ *        channel (int16), in the layout of TraceRing::GetTrace()
+ *    'D' Delta trace: position (uint32), then the difference of every
+ *        value to the previous trace sent to this client, as tokens coded
+ *        in groups of 7 bits, low group first, the top bit set on all but
+ *        the last byte. An odd token n stands for n/2+1 unchanged values,
+ *        an even token for one difference d != 0, zigzag coded as
+ *        2*(2*d) for d > 0 and 2*(-2*d-1) for d < 0. Differences of
+ *        -32..31 and up to 64 unchanged values take one byte
+ *    'R' Measurement result: one text line of tab-separated fields, the
+ *        first naming the measurement (more lines for a frequency response)
+ *  The first trace sent to a client is a key trace. The position is the
+ *  number of columns the scope had written at the end of the sweep
+ *  (modulo 2^32), so it advances by the width from one sweep to the next,
+ *  and by more if sweeps were skipped.
+ *  Clients send nothing, the server ignores anything it receives.
+ */
+
+const int TRACE_PROTOCOL_VERSION = 1;
+const int TRACE_HEADER_SIZE = 4;
+
+const uint8 TRACE_RECORD_HELLO = 'H';
+const uint8 TRACE_RECORD_KEY = 'K';
+const uint8 TRACE_RECORD_DELTA = 'D';
+const uint8 TRACE_RECORD_RESULT = 'R';
+
+const int MAX_TRACE_CLIENTS = 16;
+
+
+/*
+ *  Runs its own thread that takes the newest complete sweep from the ring
+ *  (as a second consumer beside the drawing looper, so the audio thread
+ *  never notices it) and sends it to all connected clients with
+ *  non-blocking writes. Every client has a bounded output queue: if it has
+ *  no room for a trace, the client misses that trace (the next one is coded
+ *  against the last trace it did get), and a client that doesn't take any
+ *  data for DROP_TIME is disconnected.
+ */
+
+class TraceServer {
+public:
+	TraceServer(TraceRing *ring, int width, int channels);
+	~TraceServer();
+
+	status_t Start(const char *address);	// "/path" for a Unix-domain socket, "port" for TCP on 127.0.0.1
+	void Stop(void);
+	void PublishResult(const char *text);	// Not from the audio threads
+	int32 CountClients(void) {return atomic_get(&num_clients);}
+
+private:
+	struct client {
+		int fd;
+		bool keyed;			// Key trace sent, deltas follow
+		int16 *last;		// Last trace sent
+		uint8 *out;			// Output queue
+		int out_start, out_end;
+		bigtime_t stalled;	// Time since the client hasn't taken data, 0 = not stalled
+	};
+
+	static void *thread_entry(void *arg);
+	void thread_func(void);
+	void accept_client(void);
+	void close_client(int i);
+	uint8 *reserve(client *c, int size);
+	void queue_record(client *c, uint8 type, const uint8 *data, int size);
+	void queue_trace(client *c);
+	bool flush(client *c, bigtime_t now);
+
+	TraceRing *the_ring;
+	int trace_width;		// Columns per sweep
+	int num_values;			// Max/min values per sweep (all channels)
+	int16 *trace;			// Sweep copied out of the ring
+	int32 read_end;			// Read position in the ring
+
+	int listen_fd;
+	char socket_path[108];	// Unix-domain socket to remove on Stop(), or empty
+	client clients[MAX_TRACE_CLIENTS];
+	int32 num_clients;
+
+	pthread_mutex_t result_lock;	// Protects result_buf
+	char *result_buf;		// Results not yet sent, as 'R' records
+	int result_size;
+
+	pthread_t the_thread;
+	bool running;
+	volatile bool quit;
+};
+
+
+/*
+ *  Receiving end of the protocol, for test programs and QScopeBench --client
+ */
+
+class TraceClient {
+public:
+	TraceClient();
+	~TraceClient();
+
+	status_t Connect(const char *address);
+	int Read(void);		// Waits for the next record, returns its type or -1 if the connection is closed
+
+	int Width(void) {return trace_width;}
+	int Channels(void) {return num_channels;}
+	const int16 *Trace(void) {return trace;}	// Decoded after 'K' and 'D'
+	uint32 Position(void) {return position;}
+	const char *Result(void) {return (const char *)payload;}	// After 'R'
+	int RecordSize(void) {return record_size;}	// Header and payload of the last record
+
+private:
+	bool read_fully(void *buf, int size);
+
+	int fd;
+	int trace_width, num_channels;
+	int16 *trace;
+	uint32 position;
+	uint8 *payload;
+	int payload_size;
+	int record_size;
+};
+
+#endif